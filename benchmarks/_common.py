@@ -0,0 +1,30 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Helpers shared by the benchmark scripts."""
+
+import sys
+from typing import List
+
+import win32_pipes
+
+
+def percentile(ordered: List[float], p: float) -> float:
+    index = int(p / 100 * (len(ordered) - 1) + 0.5)
+    return ordered[min(index, len(ordered) - 1)]
+
+
+def receive(rx: win32_pipes.PipeConnection, count: int) -> None:
+    for _ in range(count):
+        rx.recv_bytes()
+
+
+def raise_fd_limit() -> None:
+    # every connection needs a few descriptors on Linux
+    if sys.platform == "win32":
+        return
+    import resource
+
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
@@ -0,0 +1,315 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+// Native benchmark harness. It drives PipeConnection, PipeListener and
+// PipeClient directly, without the bindings, and writes the results as JSON.
+// benchmarks/bench_suite.py runs the same scenarios through the Python module,
+// so both reports can be compared.
+//
+// Usage: bench_pipes [output.json] [total_bytes]
+
+#include "Pipe.h"
+#include "PipeClient.h"
+#include "PipeConnection.h"
+#include "PipeListener.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Field {
+    template <typename T>
+    Field(const char *key, T value) : key{key},
+                                      value{static_cast<double>(value)}
+    {
+    }
+
+    const char *key;
+    double      value;
+};
+
+struct Result {
+    std::string        benchmark;
+    std::vector<Field> values;
+};
+
+static std::vector<Result> results;
+
+static auto report(std::string benchmark, std::vector<Field> values) -> void
+{
+    std::fprintf(stderr, "%-18s", benchmark.c_str());
+    for (auto &[key, value] : values)
+        std::fprintf(stderr, " %s=%.8g", key, value);
+    std::fprintf(stderr, "\n");
+    results.push_back({std::move(benchmark), std::move(values)});
+}
+
+static auto writeJson(std::FILE *file) -> void
+{
+#ifdef _WIN32
+    const char *platform = "win32";
+#else
+    const char *platform = "linux";
+#endif
+    std::fprintf(file,
+                 "{\n  \"harness\": \"native\",\n"
+                 "  \"platform\": \"%s\",\n  \"results\": [",
+                 platform);
+    for (size_t i = 0; i < results.size(); i++) {
+        std::fprintf(file,
+                     "%s\n    {\"benchmark\": \"%s\"",
+                     i == 0 ? "" : ",",
+                     results[i].benchmark.c_str());
+        for (auto &[key, value] : results[i].values)
+            std::fprintf(file, ", \"%s\": %.17g", key, value);
+        std::fprintf(file, "}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+}
+
+static auto makePayload(size_t size) -> nanobind::bytes
+{
+    std::string data(size, 'x');
+    return nanobind::bytes(static_cast<const void *>(data.data()), size);
+}
+
+static auto makeBuffer(size_t size) -> nanobind::object
+{
+    return nanobind::steal(
+        PyByteArray_FromStringAndSize(nullptr, static_cast<Py_ssize_t>(size)));
+}
+
+// Threads, which call into a PipeConnection, need the GIL like Python
+// threads. The connections release it, while they wait.
+template <typename F> static auto startThread(F &&f) -> std::thread
+{
+    return std::thread([f = std::forward<F>(f)]() mutable {
+        nanobind::gil_scoped_acquire gil;
+        f();
+    });
+}
+
+static auto joinThread(std::thread &thread) -> void
+{
+    nanobind::gil_scoped_release nogil;
+    thread.join();
+}
+
+static auto seconds(Clock::duration duration) -> double
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+static auto messageCount(size_t totalBytes, size_t size, size_t max) -> size_t
+{
+    return std::clamp<size_t>(totalBytes / size, 32, max);
+}
+
+static auto throughput(size_t size, size_t count, bool blocking)
+    -> std::pair<double, double>
+{
+    auto [rx, tx] = createPipe(false);
+    auto payload  = makePayload(size);
+
+    auto t0       = Clock::now();
+    auto receiver = startThread([&, rx = rx] {
+        auto buffer = makeBuffer(size);
+        for (size_t i = 0; i < count; i++)
+            rx->recvBytesInto(buffer);
+    });
+    for (size_t i = 0; i < count; i++) {
+        try {
+            tx->sendBytes(payload, 0, {}, blocking);
+        }
+        catch (const nanobind::python_error &) {
+            // BlockingIOError, the send queue is full
+            tx->sendBytes(payload);
+        }
+    }
+    joinThread(receiver);
+    auto dt = seconds(Clock::now() - t0);
+
+    delete rx;
+    delete tx;
+    return {count / dt, count * size / dt / 1e6};
+}
+
+static auto benchThroughput(size_t totalBytes) -> void
+{
+    for (size_t size :
+         {64, 1024, 16 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024}) {
+        auto count = messageCount(totalBytes, size, 500000);
+        auto [msgs, mbs] = throughput(size, count, false);
+        report("throughput",
+               {{"size", size},
+                {"messages", count},
+                {"msg_per_s", msgs},
+                {"mb_per_s", mbs}});
+    }
+}
+
+static auto benchBlocking(size_t totalBytes) -> void
+{
+    for (size_t size : {1024, 64 * 1024}) {
+        auto count = messageCount(totalBytes, size, 200000);
+        for (bool blocking : {true, false}) {
+            auto [msgs, mbs] = throughput(size, count, blocking);
+            report("send_mode",
+                   {{"size", size},
+                    {"blocking", blocking ? 1 : 0},
+                    {"msg_per_s", msgs},
+                    {"mb_per_s", mbs}});
+        }
+    }
+}
+
+static auto percentile(const std::vector<double> &sorted, double p) -> double
+{
+    auto index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+static auto benchPingPong() -> void
+{
+    for (size_t size : {64, 4096, 64 * 1024}) {
+        size_t count  = size > 4096 ? 5000 : 20000;
+        auto [c1, c2] = createPipe(true);
+        auto payload  = makePayload(size);
+
+        // the echo is blocking, so its buffer is not reused too early
+        auto echo = startThread([&, c2 = c2] {
+            auto buffer = makeBuffer(size);
+            for (size_t i = 0; i < count; i++) {
+                c2->recvBytesInto(buffer);
+                c2->sendBytes(buffer);
+            }
+        });
+
+        auto                buffer = makeBuffer(size);
+        std::vector<double> rtts(count);
+        for (size_t i = 0; i < count; i++) {
+            auto t0 = Clock::now();
+            c1->sendBytes(payload);
+            c1->recvBytesInto(buffer);
+            rtts[i] = seconds(Clock::now() - t0) * 1e6;
+        }
+        joinThread(echo);
+        delete c1;
+        delete c2;
+
+        std::sort(rtts.begin(), rtts.end());
+        report("pingpong",
+               {{"size", size},
+                {"messages", count},
+                {"p50_us", percentile(rtts, 50)},
+                {"p90_us", percentile(rtts, 90)},
+                {"p99_us", percentile(rtts, 99)},
+                {"p999_us", percentile(rtts, 99.9)},
+                {"max_us", rtts.back()}});
+    }
+}
+
+static auto benchFanIn() -> void
+{
+    const size_t size  = 1024;
+    const size_t total = 200000;
+    for (size_t clients : {1, 4, 16}) {
+        auto         address = generatePipeAddress();
+        PipeListener listener(address, clients);
+        auto         perClient = total / clients;
+        auto         payload   = makePayload(size);
+
+        auto                     t0 = Clock::now();
+        std::vector<std::thread> senders;
+        for (size_t i = 0; i < clients; i++)
+            senders.push_back(startThread([&] {
+                std::unique_ptr<PipeConnection> client(pipeClient(address));
+                for (size_t j = 0; j + 1 < perClient; j++)
+                    client->sendBytes(payload, 0, {}, false);
+                // writes complete in order, the last one flushes the others
+                client->sendBytes(payload);
+            }));
+
+        std::vector<std::unique_ptr<PipeConnection>> servers;
+        while (servers.size() < clients)
+            for (auto server : listener.acceptMany(clients - servers.size()))
+                servers.emplace_back(server);
+
+        std::vector<std::thread> receivers;
+        for (auto &server : servers)
+            receivers.push_back(startThread([&, server = server.get()] {
+                auto buffer = makeBuffer(size);
+                for (size_t j = 0; j < perClient; j++)
+                    server->recvBytesInto(buffer);
+            }));
+        for (auto &thread : receivers)
+            joinThread(thread);
+        auto dt = seconds(Clock::now() - t0);
+        for (auto &thread : senders)
+            joinThread(thread);
+
+        report("fan_in",
+               {{"clients", clients},
+                {"size", size},
+                {"messages", perClient * clients},
+                {"msg_per_s", perClient * clients / dt}});
+    }
+}
+
+static auto benchConnect() -> void
+{
+    const size_t count = 1000;
+
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        auto [c1, c2] = createPipe(true);
+        delete c1;
+        delete c2;
+    }
+    report("connect_pipe",
+           {{"us_per_connection", seconds(Clock::now() - t0) * 1e6 / count}});
+
+    auto         address = generatePipeAddress();
+    PipeListener listener(address);
+    t0 = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        std::unique_ptr<PipeConnection> client(pipeClient(address));
+        std::unique_ptr<PipeConnection> server(listener.accept());
+    }
+    report("connect_listener",
+           {{"us_per_connection", seconds(Clock::now() - t0) * 1e6 / count}});
+}
+
+auto main(int argc, char **argv) -> int
+{
+    const char *output     = argc > 1 ? argv[1] : nullptr;
+    size_t      totalBytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10)
+                                      : 256 * 1024 * 1024;
+
+    // the reactor threads outlive main, so the interpreter is not finalized
+    Py_Initialize();
+    benchThroughput(totalBytes);
+    benchBlocking(totalBytes / 4);
+    benchPingPong();
+    benchFanIn();
+    benchConnect();
+
+    auto file = output ? std::fopen(output, "w") : stdout;
+    if (!file) {
+        std::perror(output);
+        return 1;
+    }
+    writeJson(file);
+    if (file != stdout)
+        std::fclose(file);
+    return 0;
+}
@@ -0,0 +1,280 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Benchmark suite of the Python API.
+
+Runs the same scenarios as the native harness (benchmarks/bench_pipes.cpp):
+one-way throughput from 64 B to 16 MiB, blocking vs. non-blocking send,
+ping-pong round trip percentiles, fan-in from several clients into one
+PipeListener and the connection setup cost. The results are written as JSON.
+With --baseline the results are compared with an earlier report, and the
+exit code is 1, if a result regressed by more than --tolerance.
+
+Usage: python benchmarks/bench_suite.py [-o results.json] [--total-bytes N]
+                                        [--baseline old.json] [--tolerance 0.1]
+"""
+
+import argparse
+import json
+import platform
+import sys
+import threading
+import time
+from typing import Any, Callable, Dict, List, Tuple
+
+from _common import percentile
+
+import win32_pipes
+
+THROUGHPUT_SIZES = (64, 1024, 16384, 65536, 1048576, 16777216)
+SEND_MODE_SIZES = (1024, 65536)
+PINGPONG_SIZES = (64, 4096, 65536)
+FAN_IN_CLIENTS = (1, 4, 16)
+FAN_IN_MESSAGES = 100_000
+CONNECTIONS = 500
+
+# fields, which identify a result instead of measuring it
+PARAMETERS = ("benchmark", "size", "blocking", "clients", "messages")
+# values, which are better when smaller
+LOWER_IS_BETTER = ("_us", "us_per_connection")
+
+results: List[Dict[str, Any]] = []
+
+
+def report(benchmark: str, **values: float) -> None:
+    print(
+        f"{benchmark:<18}" + "".join(f" {k}={v:.8g}" for k, v in values.items()),
+        file=sys.stderr,
+    )
+    results.append({"benchmark": benchmark, **values})
+
+
+def message_count(total_bytes: int, size: int, maximum: int) -> int:
+    return min(max(total_bytes // size, 32), maximum)
+
+
+def start_thread(target: Callable[[], None]) -> threading.Thread:
+    thread = threading.Thread(target=target)
+    thread.start()
+    return thread
+
+
+def throughput(size: int, count: int, blocking: bool) -> Tuple[float, float]:
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        message = bytes(size)
+
+        def receive() -> None:
+            buffer = bytearray(size)
+            for _ in range(count):
+                rx.recv_bytes_into(buffer)
+
+        t0 = time.perf_counter()
+        receiver = start_thread(receive)
+        for _ in range(count):
+            try:
+                tx.send_bytes(message, blocking=blocking)
+            except BlockingIOError:  # the send queue is full
+                tx.send_bytes(message)
+        receiver.join()
+        elapsed = time.perf_counter() - t0
+    return count / elapsed, count * size / elapsed / 1e6
+
+
+def bench_throughput(total_bytes: int) -> None:
+    for size in THROUGHPUT_SIZES:
+        count = message_count(total_bytes, size, 500_000)
+        msgs, mbs = throughput(size, count, False)
+        report(
+            "throughput", size=size, messages=count, msg_per_s=msgs, mb_per_s=mbs
+        )
+
+
+def bench_send_mode(total_bytes: int) -> None:
+    for size in SEND_MODE_SIZES:
+        count = message_count(total_bytes, size, 200_000)
+        for blocking in (True, False):
+            msgs, mbs = throughput(size, count, blocking)
+            report(
+                "send_mode",
+                size=size,
+                blocking=int(blocking),
+                msg_per_s=msgs,
+                mb_per_s=mbs,
+            )
+
+
+def bench_pingpong() -> None:
+    for size in PINGPONG_SIZES:
+        count = 5000 if size > 4096 else 20000
+        c1, c2 = win32_pipes.Pipe()
+        with c1, c2:
+
+            def echo() -> None:
+                buffer = bytearray(size)
+                for _ in range(count):
+                    c2.recv_bytes_into(buffer)
+                    c2.send_bytes(buffer)
+
+            echo_thread = start_thread(echo)
+            message = bytes(size)
+            buffer = bytearray(size)
+            rtts = []
+            for _ in range(count):
+                t0 = time.perf_counter()
+                c1.send_bytes(message)
+                c1.recv_bytes_into(buffer)
+                rtts.append((time.perf_counter() - t0) * 1e6)
+            echo_thread.join()
+
+        rtts.sort()
+        report(
+            "pingpong",
+            size=size,
+            messages=count,
+            p50_us=percentile(rtts, 50),
+            p90_us=percentile(rtts, 90),
+            p99_us=percentile(rtts, 99),
+            p999_us=percentile(rtts, 99.9),
+            max_us=rtts[-1],
+        )
+
+
+def bench_fan_in() -> None:
+    size = 1024
+    message = bytes(size)
+    for clients in FAN_IN_CLIENTS:
+        address = win32_pipes.generate_pipe_address()
+        per_client = FAN_IN_MESSAGES // clients
+        with win32_pipes.PipeListener(address, backlog=clients) as listener:
+
+            def send() -> None:
+                with win32_pipes.PipeClient(address) as client:
+                    for _ in range(per_client - 1):
+                        try:
+                            client.send_bytes(message, blocking=False)
+                        except BlockingIOError:  # the send queue is full
+                            client.send_bytes(message)
+                    # writes complete in order, the last one flushes the others
+                    client.send_bytes(message)
+
+            t0 = time.perf_counter()
+            senders = [start_thread(send) for _ in range(clients)]
+            servers: List[win32_pipes.PipeConnection] = []
+            while len(servers) < clients:
+                servers.extend(listener.accept_many(clients - len(servers)))
+
+            def receive(server: win32_pipes.PipeConnection) -> None:
+                buffer = bytearray(size)
+                for _ in range(per_client):
+                    server.recv_bytes_into(buffer)
+
+            receivers = [
+                start_thread(lambda s=server: receive(s)) for server in servers
+            ]
+            for thread in receivers:
+                thread.join()
+            elapsed = time.perf_counter() - t0
+            for thread in senders:
+                thread.join()
+            for server in servers:
+                server.close()
+
+        report(
+            "fan_in",
+            clients=clients,
+            size=size,
+            messages=per_client * clients,
+            msg_per_s=per_client * clients / elapsed,
+        )
+
+
+def bench_connect() -> None:
+    t0 = time.perf_counter()
+    for _ in range(CONNECTIONS):
+        c1, c2 = win32_pipes.Pipe()
+        c1.close()
+        c2.close()
+    elapsed = time.perf_counter() - t0
+    report("connect_pipe", us_per_connection=elapsed * 1e6 / CONNECTIONS)
+
+    address = win32_pipes.generate_pipe_address()
+    with win32_pipes.PipeListener(address) as listener:
+        t0 = time.perf_counter()
+        for _ in range(CONNECTIONS):
+            client = win32_pipes.PipeClient(address)
+            server = listener.accept()
+            client.close()
+            server.close()
+        elapsed = time.perf_counter() - t0
+    report("connect_listener", us_per_connection=elapsed * 1e6 / CONNECTIONS)
+
+
+def result_key(result: Dict[str, Any]) -> tuple:
+    return tuple((k, v) for k, v in result.items() if k in PARAMETERS)
+
+
+def compare(baseline: Dict[str, Any], tolerance: float) -> bool:
+    """Print the change against the baseline and return False on regressions."""
+    old = {result_key(r): r for r in baseline["results"]}
+    ok = True
+    for result in results:
+        previous = old.get(result_key(result))
+        if previous is None:
+            continue
+        for name, value in result.items():
+            if name in PARAMETERS or not previous.get(name):
+                continue
+            # positive changes are improvements
+            if name.endswith(LOWER_IS_BETTER):
+                change = previous[name] / value - 1
+            else:
+                change = value / previous[name] - 1
+            regressed = change < -tolerance
+            ok = ok and not regressed
+            label = " ".join(f"{k}={v}" for k, v in result_key(result))
+            print(
+                f"{label:<52} {name:<18} {change:+7.1%}"
+                + ("  REGRESSION" if regressed else ""),
+                file=sys.stderr,
+            )
+    return ok
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-o", "--output", help="JSON report, default stdout")
+    parser.add_argument("--total-bytes", type=int, default=256 * 1024 * 1024)
+    parser.add_argument("--baseline", help="JSON report to compare with")
+    parser.add_argument("--tolerance", type=float, default=0.1)
+    args = parser.parse_args()
+
+    bench_throughput(args.total_bytes)
+    bench_send_mode(args.total_bytes // 4)
+    bench_pingpong()
+    bench_fan_in()
+    bench_connect()
+
+    report_data = {
+        "harness": "python",
+        "platform": sys.platform,
+        "python": platform.python_version(),
+        "version": win32_pipes.__version__,
+        "results": results,
+    }
+    if args.output:
+        with open(args.output, "w") as file:
+            json.dump(report_data, file, indent=2)
+    else:
+        json.dump(report_data, sys.stdout, indent=2)
+
+    if args.baseline:
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+        if not compare(baseline, args.tolerance):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Sweep the read buffer size against the message size.
+
+Every message size is sent through pipes with fixed buffer sizes and with
+an adaptive buffer. Messages larger than the buffer need a second read, so
+throughput should step up once the buffer holds the whole message.
+
+Usage: python benchmarks/buffer_size_sweep.py [total_bytes]
+"""
+
+import sys
+import threading
+import time
+
+from _common import receive
+
+import win32_pipes
+
+MESSAGE_SIZES = (512, 4096, 32768, 262144, 1048576)
+BUFFER_SIZES = (4096, 8192, 65536, 262144, 1048576)
+
+
+def run(size: int, count: int, buffer_size: int, adaptive: bool) -> float:
+    rx, tx = win32_pipes.Pipe(
+        duplex=False, buffer_size=buffer_size, adaptive_buffer=adaptive
+    )
+    with rx, tx:
+        message = bytes(size)
+        receiver = threading.Thread(target=receive, args=(rx, count))
+        receiver.start()
+
+        t0 = time.perf_counter()
+        for _ in range(count):
+            try:
+                tx.send_bytes(message, blocking=False)
+            except BlockingIOError:  # the send queue is full
+                tx.send_bytes(message)
+        receiver.join()
+        return count * size / (time.perf_counter() - t0)
+
+
+def main() -> None:
+    total_bytes = int(sys.argv[1]) if len(sys.argv) > 1 else 256 * 1024 * 1024
+    configs = [(f"{size // 1024}K", size, False) for size in BUFFER_SIZES]
+    configs.append(("adaptive", 8192, True))
+
+    print("MB/s per read buffer size")
+    print(f"{'message':>8}" + "".join(f"{name:>10}" for name, _, _ in configs))
+    for size in MESSAGE_SIZES:
+        count = min(max(total_bytes // size, 100), 200_000)
+        rates = [
+            run(size, count, buffer_size, adaptive)
+            for _, buffer_size, adaptive in configs
+        ]
+        print(f"{size:>8}" + "".join(f"{rate / 1e6:>10.0f}" for rate in rates))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Compare ping-pong round trips with and without busy polling.
+
+Both ends of the connection spin for up to `busy_poll_us` before they wait
+for the Rx event. The CPU time per round trip shows the cost of spinning.
+
+Usage: python benchmarks/busy_poll_latency.py [round_trips]
+"""
+
+import sys
+import threading
+import time
+from typing import List
+
+from _common import percentile
+
+import win32_pipes
+
+BUSY_POLL_US = (0, 10, 50, 200)
+SIZE = 64
+
+
+def run(busy_poll_us: int, count: int) -> List[float]:
+    c1, c2 = win32_pipes.Pipe()
+    with c1, c2:
+        c1.busy_poll_us = busy_poll_us
+        c2.busy_poll_us = busy_poll_us
+
+        def echo() -> None:
+            for _ in range(count):
+                c2.send_bytes(c2.recv_bytes())
+
+        echo_thread = threading.Thread(target=echo)
+        echo_thread.start()
+        message = bytes(SIZE)
+        rtts = []
+        for _ in range(count):
+            t0 = time.perf_counter()
+            c1.send_bytes(message)
+            c1.recv_bytes()
+            rtts.append((time.perf_counter() - t0) * 1e6)
+        echo_thread.join()
+    rtts.sort()
+    return rtts
+
+
+def main() -> None:
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 20000
+    run(0, 1000)  # warm up the reactor
+    print(
+        f"{'busy_poll_us':>12} {'p50':>9} {'p99':>9} {'p99.9':>9} "
+        f"{'cpu/rtt':>9}"
+    )
+    for busy_poll_us in BUSY_POLL_US:
+        cpu0 = time.process_time()
+        rtts = run(busy_poll_us, count)
+        cpu = (time.process_time() - cpu0) / count * 1e6
+        print(
+            f"{busy_poll_us:>12} {percentile(rtts, 50):>7.1f}us "
+            f"{percentile(rtts, 99):>7.1f}us {percentile(rtts, 99.9):>7.1f}us "
+            f"{cpu:>7.1f}us"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,73 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Measure how fast a burst of reconnecting clients is accepted.
+
+The clients connect from a thread pool at once, like workers after a
+deploy, while the listener accepts them with accept() or accept_many().
+
+Usage: python benchmarks/connection_storm.py [clients] [backlog]
+"""
+
+import sys
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+from _common import raise_fd_limit
+
+import win32_pipes
+
+CONNECTING_THREADS = 32
+BATCH = 64
+
+
+def connect(address: str) -> win32_pipes.PipeConnection:
+    client = win32_pipes.PipeClient(address)
+    client.send_bytes(b"hello")
+    return client
+
+
+def run(clients: int, backlog: int, batched: bool) -> float:
+    address = win32_pipes.generate_pipe_address()
+    with win32_pipes.PipeListener(address, backlog=backlog) as listener:
+        servers = []
+
+        def serve() -> None:
+            while len(servers) < clients:
+                if batched:
+                    servers.extend(listener.accept_many(BATCH))
+                else:
+                    servers.append(listener.accept())
+
+        server_thread = threading.Thread(target=serve)
+        server_thread.start()
+
+        t0 = time.perf_counter()
+        with ThreadPoolExecutor(CONNECTING_THREADS) as executor:
+            connections = list(executor.map(connect, [address] * clients))
+        server_thread.join()
+        for server in servers:
+            server.recv_bytes()
+        elapsed = time.perf_counter() - t0
+
+        for c in connections + servers:
+            c.close()
+        return clients / elapsed
+
+
+def main() -> None:
+    clients = int(sys.argv[1]) if len(sys.argv) > 1 else 500
+    backlog = int(sys.argv[2]) if len(sys.argv) > 2 else 64
+    raise_fd_limit()
+
+    print(f"{clients} clients, backlog {backlog}")
+    print(f"{'method':>12} {'connections/s':>14}")
+    for batched in (False, True):
+        method = "accept_many" if batched else "accept"
+        print(f"{method:>12} {run(clients, backlog, batched):>14.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Compare load balancing in Python with PipeDispatcher.
+
+A manager hands small tasks to worker processes, which return every task as
+its result. "python" sends each task to the worker with the fewest
+outstanding tasks and collects the results with wait(), the other rows use a
+PipeDispatcher with submit_many() and recv_results(). At most WINDOW tasks
+are in flight.
+
+Usage: python benchmarks/dispatcher_throughput.py [workers] [tasks] [size]
+"""
+
+import multiprocessing
+import sys
+import time
+from typing import List, Tuple
+
+import win32_pipes
+
+WINDOW = 8192
+POLICIES = ("round_robin", "least_outstanding", "least_bytes")
+
+
+def work(connection: win32_pipes.PipeConnection) -> None:
+    try:
+        while True:
+            connection.send_bytes_many(connection.recv_bytes_many())
+    except (EOFError, OSError, RuntimeError):
+        pass
+
+
+def start_workers(
+    count: int,
+) -> Tuple[List[win32_pipes.PipeConnection], List[multiprocessing.Process]]:
+    context = multiprocessing.get_context("spawn")
+    connections, processes = [], []
+    for _ in range(count):
+        manager, worker = win32_pipes.Pipe()
+        process = context.Process(target=work, args=(worker,))
+        process.start()
+        worker.close()
+        connections.append(manager)
+        processes.append(process)
+    return connections, processes
+
+
+def run_python(
+    connections: List[win32_pipes.PipeConnection], tasks: int, payload: bytes
+) -> float:
+    index = {connection: i for i, connection in enumerate(connections)}
+    outstanding = [0] * len(connections)
+    submitted = completed = 0
+    t0 = time.perf_counter()
+    while completed < tasks:
+        while submitted < tasks and submitted - completed < WINDOW:
+            i = min(range(len(connections)), key=outstanding.__getitem__)
+            try:
+                connections[i].send_bytes(payload, blocking=False)
+            except BlockingIOError:  # the send queue is full
+                connections[i].send_bytes(payload)
+            outstanding[i] += 1
+            submitted += 1
+        for connection in win32_pipes.wait(connections):
+            results = connection.recv_bytes_many()
+            outstanding[index[connection]] -= len(results)
+            completed += len(results)
+    return tasks / (time.perf_counter() - t0)
+
+
+def run_native(
+    connections: List[win32_pipes.PipeConnection],
+    tasks: int,
+    payload: bytes,
+    policy: str,
+) -> float:
+    submitted = completed = 0
+    with win32_pipes.PipeDispatcher(connections, policy=policy) as dispatcher:
+        t0 = time.perf_counter()
+        while completed < tasks:
+            count = min(tasks - submitted, WINDOW - (submitted - completed))
+            if count > 0:
+                try:
+                    submitted += len(dispatcher.submit_many([payload] * count))
+                except BlockingIOError:  # all workers are busy
+                    pass
+            completed += len(dispatcher.recv_results())
+        return tasks / (time.perf_counter() - t0)
+
+
+def main() -> None:
+    workers = int(sys.argv[1]) if len(sys.argv) > 1 else 32
+    tasks = int(sys.argv[2]) if len(sys.argv) > 2 else 200_000
+    size = int(sys.argv[3]) if len(sys.argv) > 3 else 64
+    payload = bytes(size)
+
+    print(f"{workers} workers, {tasks} tasks of {size} bytes")
+    print(f"{'dispatch':>18} {'tasks/s':>10}")
+    # every run starts new workers, so no run sees the tasks of another
+    for name in ("python",) + POLICIES:
+        connections, processes = start_workers(workers)
+        try:
+            if name == "python":
+                rate = run_python(connections, tasks, payload)
+            else:
+                rate = run_native(connections, tasks, payload, name)
+        finally:
+            for connection in connections:
+                connection.close()
+            for process in processes:
+                process.join()
+        print(f"{name:>18} {rate:>10.0f}")
+
+
+if __name__ == "__main__":
+    main()
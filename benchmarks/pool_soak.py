@@ -0,0 +1,135 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Soak test of the per-connection pools.
+
+A mixed load of message sizes, blocking and non-blocking sends, batches and
+priorities runs over a few connections for the given time. Every interval
+the allocations per message (write states and receive buffers) and the RSS
+of the process are reported; both should stay flat after the warm-up.
+
+Usage: python benchmarks/pool_soak.py [duration_s] [interval_s]
+
+For a 24 hour run: python benchmarks/pool_soak.py 86400 600
+"""
+
+import random
+import sys
+import threading
+import time
+from typing import List
+
+import win32_pipes
+
+CONNECTIONS = 4
+SIZES = (64, 512, 4096, 65536, 1 << 20)
+WEIGHTS = (40, 30, 15, 10, 5)
+BATCH = 32
+
+
+def rss_bytes() -> int:
+    try:
+        import psutil
+
+        return psutil.Process().memory_info().rss
+    except ImportError:
+        pass
+
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("VmRSS:"):
+                return int(line.split()[1]) * 1024
+    return 0
+
+
+def receive(rx: win32_pipes.PipeConnection, stop: threading.Event) -> None:
+    buffer = bytearray(1 << 20)
+    while not stop.is_set() or rx.poll():
+        if not rx.poll(0.1):
+            continue
+        # alternate between both receive paths
+        if random.random() < 0.5:
+            rx.recv_bytes()
+        else:
+            rx.recv_bytes_into(buffer)
+
+
+def send(
+    tx: win32_pipes.PipeConnection,
+    stop: threading.Event,
+    counts: List[int],
+    index: int,
+) -> None:
+    rng = random.Random()
+    payloads = {size: bytes(size) for size in SIZES}
+    while not stop.is_set():
+        size = rng.choices(SIZES, WEIGHTS)[0]
+        mode = rng.random()
+        if mode < 0.1:
+            tx.send_bytes_many([payloads[64]] * BATCH)
+            counts[index] += BATCH
+            continue
+        if mode < 0.2:
+            tx.send_bytes(payloads[size], priority=rng.randint(1, 3))
+        else:
+            tx.send_bytes(payloads[size], blocking=mode < 0.6)
+        counts[index] += 1
+
+
+def allocations(connections: List[win32_pipes.PipeConnection]) -> int:
+    return sum(
+        c.tx_write_allocations + c.rx_buffer_allocations for c in connections
+    )
+
+
+def main() -> None:
+    duration = float(sys.argv[1]) if len(sys.argv) > 1 else 60.0
+    interval = float(sys.argv[2]) if len(sys.argv) > 2 else 10.0
+
+    pairs = [win32_pipes.Pipe(duplex=False) for _ in range(CONNECTIONS)]
+    connections = [c for pair in pairs for c in pair]
+    stop = threading.Event()
+    counts = [0] * CONNECTIONS
+    receivers = [
+        threading.Thread(target=receive, args=(rx, stop)) for rx, _ in pairs
+    ]
+    senders = [
+        threading.Thread(target=send, args=(tx, stop, counts, i))
+        for i, (_, tx) in enumerate(pairs)
+    ]
+    for thread in receivers + senders:
+        thread.start()
+
+    print(
+        f"{'elapsed':>9} {'messages':>12} {'msg/s':>10} {'alloc/msg':>10} "
+        f"{'rss':>10}"
+    )
+    t0 = last_time = time.perf_counter()
+    last_messages = last_allocations = 0
+    try:
+        while time.perf_counter() - t0 < duration:
+            time.sleep(min(interval, duration - (time.perf_counter() - t0)))
+            now = time.perf_counter()
+            messages = sum(counts)
+            allocated = allocations(connections)
+            delta = max(messages - last_messages, 1)
+            print(
+                f"{now - t0:>8.0f}s {messages:>12} "
+                f"{delta / (now - last_time):>10.0f} "
+                f"{(allocated - last_allocations) / delta:>10.4f} "
+                f"{rss_bytes() / 2**20:>6.1f} MiB",
+                flush=True,
+            )
+            last_time, last_messages, last_allocations = now, messages, allocated
+    finally:
+        # the receivers drain the queues, until the senders returned
+        stop.set()
+        for thread in senders + receivers:
+            thread.join()
+        for connection in connections:
+            connection.close()
+
+
+if __name__ == "__main__":
+    main()
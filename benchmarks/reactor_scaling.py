@@ -0,0 +1,84 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Measure threads, memory and throughput with many open connections.
+
+Every connection is started and kept busy with ping-pong messages, which
+are sent round robin over all connections.
+
+Usage: python benchmarks/reactor_scaling.py [reactor_threads]
+"""
+
+import sys
+import time
+
+from _common import raise_fd_limit
+
+import win32_pipes
+
+CONNECTIONS = (10, 100, 1000)
+MESSAGES = 100_000
+PAYLOAD = bytes(64)
+
+
+def process_stats() -> "tuple[int, int]":
+    """Return the number of threads and the resident set size in bytes."""
+    try:
+        import psutil
+
+        process = psutil.Process()
+        return process.num_threads(), process.memory_info().rss
+    except ImportError:
+        pass
+
+    threads = rss = 0
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("Threads:"):
+                threads = int(line.split()[1])
+            elif line.startswith("VmRSS:"):
+                rss = int(line.split()[1]) * 1024
+    return threads, rss
+
+
+def run(count: int) -> "tuple[int, int, float]":
+    pipes = [win32_pipes.Pipe() for _ in range(count)]
+    try:
+        for c1, c2 in pipes:
+            c1.send_bytes(PAYLOAD, blocking=False)
+            c2.recv_bytes()
+        threads, rss = process_stats()
+
+        rounds = max(1, MESSAGES // count)
+        t0 = time.perf_counter()
+        for _ in range(rounds):
+            for c1, _c2 in pipes:
+                c1.send_bytes(PAYLOAD, blocking=False)
+            for _c1, c2 in pipes:
+                c2.recv_bytes()
+        throughput = rounds * count / (time.perf_counter() - t0)
+        return threads, rss, throughput
+    finally:
+        for c1, c2 in pipes:
+            c1.close()
+            c2.close()
+
+
+def main() -> None:
+    if len(sys.argv) > 1:
+        win32_pipes.set_reactor_threads(int(sys.argv[1]))
+    raise_fd_limit()
+
+    print(f"reactor threads: {win32_pipes.get_reactor_threads()}")
+    print(f"{'connections':>12} {'threads':>8} {'rss':>10} {'throughput':>14}")
+    for count in CONNECTIONS:
+        threads, rss, throughput = run(count)
+        print(
+            f"{count:>12} {threads:>8} {rss / 2**20:>7.1f} MiB "
+            f"{throughput:>10.0f} msg/s"
+        )
+
+
+if __name__ == "__main__":
+    main()
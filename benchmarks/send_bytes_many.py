@@ -0,0 +1,62 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Compare send_bytes_many() against a loop of send_bytes().
+
+Usage: python benchmarks/send_bytes_many.py [total_bytes]
+"""
+
+import sys
+import threading
+import time
+
+from _common import receive
+
+import win32_pipes
+
+SIZES = (64, 1024, 65536)
+BATCH = 256
+
+
+def run(size: int, count: int, batched: bool) -> float:
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        messages = [bytes(size)] * BATCH
+        receiver = threading.Thread(target=receive, args=(rx, count))
+        receiver.start()
+
+        t0 = time.perf_counter()
+        for _ in range(count // BATCH):
+            # a full send queue makes the non-blocking sends wait after all
+            if batched:
+                try:
+                    tx.send_bytes_many(messages, blocking=False)
+                except BlockingIOError:
+                    tx.send_bytes_many(messages)
+            else:
+                for message in messages:
+                    try:
+                        tx.send_bytes(message, blocking=False)
+                    except BlockingIOError:
+                        tx.send_bytes(message)
+        receiver.join()
+        return count / (time.perf_counter() - t0)
+
+
+def main() -> None:
+    total_bytes = int(sys.argv[1]) if len(sys.argv) > 1 else 256 * 1024 * 1024
+    print(f"{'size':>8} {'send_bytes':>14} {'send_bytes_many':>16} {'speedup':>8}")
+    for size in SIZES:
+        count = max(BATCH, total_bytes // size // BATCH * BATCH)
+        count = min(count, 1_000_000 // BATCH * BATCH)
+        single = run(size, count, batched=False)
+        many = run(size, count, batched=True)
+        print(
+            f"{size:>8} {single:>10.0f} msg/s {many:>10.0f} msg/s "
+            f"{many / single:>7.2f}x"
+        )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,164 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+// Compares the message hand-over between the monitor thread and a receiver:
+// the former mutex-guarded std::queue, which signals the event for every
+// message, against SpscRing, which only signals on an empty-to-non-empty
+// transition. The event is an eventfd, like Event in src/cpp/posix/util.cpp.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <queue>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "SpscRing.h"
+
+using Message = std::shared_ptr<std::vector<char>>;
+
+class EventFd {
+  public:
+    EventFd() : _fd{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)} {}
+    ~EventFd() { close(_fd); }
+
+    auto set() -> void
+    {
+        uint64_t one{1};
+        (void)!write(_fd, &one, sizeof(one));
+        _signals++;
+    }
+
+    auto reset() -> void
+    {
+        uint64_t value;
+        (void)!read(_fd, &value, sizeof(value));
+    }
+
+    auto wait() -> void
+    {
+        pollfd pfd{_fd, POLLIN, 0};
+        poll(&pfd, 1, 100);
+    }
+
+    auto getSignals() const -> size_t { return _signals; }
+
+  private:
+    int    _fd;
+    size_t _signals{0};
+};
+
+struct MutexQueue {
+    std::mutex          mutex;
+    std::queue<Message> queue;
+    EventFd             event;
+
+    auto push(Message message) -> void
+    {
+        std::scoped_lock lock(mutex);
+        queue.push(std::move(message));
+        event.set();
+    }
+
+    auto pop() -> Message
+    {
+        while (true) {
+            {
+                std::scoped_lock lock(mutex);
+                if (!queue.empty()) {
+                    auto message = std::move(queue.front());
+                    queue.pop();
+                    if (queue.empty())
+                        event.reset();
+                    return message;
+                }
+            }
+            event.wait();
+        }
+    }
+};
+
+struct RingQueue {
+    SpscRing<Message> ring;
+    EventFd           event;
+
+    explicit RingQueue(size_t capacity) : ring{capacity} {}
+
+    auto push(Message message) -> void
+    {
+        bool wasEmpty{false};
+        while (!ring.push(std::move(message), &wasEmpty))
+            std::this_thread::yield();
+        if (wasEmpty)
+            event.set();
+    }
+
+    auto tryPop(Message &message) -> bool
+    {
+        bool isEmpty{false};
+        if (!ring.pop(message, nullptr, &isEmpty))
+            return false;
+        if (isEmpty) {
+            event.reset();
+            if (!ring.empty())
+                event.set();
+        }
+        return true;
+    }
+
+    auto pop() -> Message
+    {
+        Message message;
+        while (true) {
+            if (tryPop(message))
+                return message;
+            event.reset();
+            if (tryPop(message))
+                return message;
+            event.wait();
+        }
+    }
+};
+
+template <typename Queue>
+static auto run(const char *name, Queue &queue, size_t count, size_t size)
+    -> void
+{
+    // a single buffer is handed around, so only the queue is measured
+    auto payload = std::make_shared<std::vector<char>>(size);
+
+    auto        t0 = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        for (size_t i = 0; i < count; i++)
+            queue.push(payload);
+    });
+    for (size_t i = 0; i < count; i++)
+        queue.pop();
+    producer.join();
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+
+    std::printf("%-12s %10.0f msg/s %8.1f ns/msg %10zu signals\n",
+                name,
+                count / dt.count(),
+                dt.count() * 1e9 / count,
+                queue.event.getSignals());
+}
+
+auto main(int argc, char **argv) -> int
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+    MutexQueue mutexQueue;
+    run("mutex+queue", mutexQueue, count, 64);
+
+    RingQueue ringQueue{4096};
+    run("spsc_ring", ringQueue, count, 64);
+    return 0;
+}
@@ -0,0 +1,85 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+// Measures the cost of the ConnectionStats updates on the hot path. Like
+// RxQueue, a producer hands messages to a consumer through an SpscRing; with
+// stats enabled every message is counted and the sampled ones are
+// timestamped for the residency histogram, like PipeConnection does. The
+// difference is the overhead per message, which is to be compared with the
+// cost of a pipe write or read (a system call of a microsecond or more).
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "SpscRing.h"
+#include "Stats.h"
+
+struct Entry {
+    std::shared_ptr<std::vector<char>> buffer;
+    StatsClock::time_point             queuedAt{};
+};
+
+template <bool withStats>
+static auto run(size_t count, size_t size) -> double
+{
+    SpscRing<Entry> ring{4096};
+    ConnectionStats stats;
+    auto            payload = std::make_shared<std::vector<char>>(size);
+
+    auto        t0 = std::chrono::steady_clock::now();
+    std::thread producer([&] {
+        for (size_t i = 0; i < count; i++) {
+            Entry entry{payload};
+            if constexpr (withStats)
+                entry.queuedAt = stats.rxSampler.start();
+            while (!ring.push(std::move(entry)))
+                std::this_thread::yield();
+            if constexpr (withStats) {
+                stats.rxMessages.add();
+                stats.rxBytes.add(size);
+                stats.rxQueuePeak.observe(ring.size());
+            }
+        }
+    });
+    Entry entry;
+    for (size_t i = 0; i < count; i++) {
+        while (!ring.pop(entry))
+            std::this_thread::yield();
+        if constexpr (withStats)
+            stats.rxResidency.recordSince(entry.queuedAt);
+    }
+    producer.join();
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    return dt.count() * 1e9 / count;
+}
+
+auto main(int argc, char **argv) -> int
+{
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+
+    // best of a few runs, the hand-over itself is noisy
+    double plain{1e9};
+    double counted{1e9};
+    for (int round = 0; round < 5; round++) {
+        plain   = std::min(plain, run<false>(count, 64));
+        counted = std::min(counted, run<true>(count, 64));
+    }
+
+    auto t0 = StatsClock::now();
+    for (size_t i = 0; i < count; i++)
+        (void)StatsClock::now();
+    std::chrono::duration<double> clock = StatsClock::now() - t0;
+
+    std::printf("without stats %8.1f ns/msg\n", plain);
+    std::printf("with stats    %8.1f ns/msg\n", counted);
+    std::printf("overhead      %8.1f ns/msg (clock read %.1f ns)\n",
+                counted - plain,
+                clock.count() * 1e9 / count);
+    return 0;
+}
@@ -0,0 +1,81 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Measure, how the throughput scales with the number of Python threads.
+
+With "pairs" every sender thread has its own connection pair and receiver
+thread, with "shared" all threads send to and receive from a single pair.
+On free-threaded Python (3.13t and later) the threads run in parallel, with
+the GIL only the waits overlap.
+
+Usage: python benchmarks/thread_scaling.py [messages_per_thread] [size]
+"""
+
+import sys
+import sysconfig
+import threading
+import time
+from typing import List, Tuple
+
+from _common import receive
+
+import win32_pipes
+
+THREADS = (1, 2, 4, 8)
+
+
+def gil_enabled() -> bool:
+    if sysconfig.get_config_var("Py_GIL_DISABLED"):
+        return sys._is_gil_enabled()
+    return True
+
+
+def send(tx: win32_pipes.PipeConnection, payload: bytes, count: int) -> None:
+    for _ in range(count):
+        try:
+            tx.send_bytes(payload, blocking=False)
+        except BlockingIOError:  # the send queue is full
+            tx.send_bytes(payload)
+
+
+def run(
+    connections: List[Tuple[win32_pipes.PipeConnection, ...]],
+    threads: int,
+    payload: bytes,
+    count: int,
+) -> float:
+    workers = []
+    for i in range(threads):
+        rx, tx = connections[i % len(connections)]
+        workers.append(threading.Thread(target=receive, args=(rx, count)))
+        workers.append(threading.Thread(target=send, args=(tx, payload, count)))
+    t0 = time.perf_counter()
+    for worker in workers:
+        worker.start()
+    for worker in workers:
+        worker.join()
+    return threads * count / (time.perf_counter() - t0)
+
+
+def main() -> None:
+    count = int(sys.argv[1]) if len(sys.argv) > 1 else 50_000
+    size = int(sys.argv[2]) if len(sys.argv) > 2 else 256
+    payload = bytes(size)
+
+    print(f"GIL enabled: {gil_enabled()}, {size} byte messages")
+    print(f"{'threads':>7} {'pairs msg/s':>12} {'shared msg/s':>13}")
+    for threads in THREADS:
+        pairs = [win32_pipes.Pipe(duplex=False) for _ in range(threads)]
+        shared = [win32_pipes.Pipe(duplex=False)]
+        try:
+            rate_pairs = run(pairs, threads, payload, count)
+            rate_shared = run(shared, threads, payload, count)
+        finally:
+            for connection in [c for pair in pairs + shared for c in pair]:
+                connection.close()
+        print(f"{threads:>7} {rate_pairs:>12.0f} {rate_shared:>13.0f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,169 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./Buffer.h"
+#include <algorithm>
+#include <bit>
+#include <nanobind/nanobind.h>
+
+BufferPool::BufferPool(size_t maxCount, size_t maxBytes)
+    : _maxCount{maxCount},
+      _maxBytes{maxBytes}
+{
+}
+
+auto BufferPool::capacityFor(size_t size) -> size_t
+{
+    // larger buffers are not kept, so they are not rounded up
+    if (size > static_cast<size_t>(1) << MAX_SHIFT)
+        return size;
+    return std::max(std::bit_ceil(size), static_cast<size_t>(1) << MIN_SHIFT);
+}
+
+auto BufferPool::take(size_t size) -> std::shared_ptr<MessageBuffer>
+{
+    // the smallest class, whose buffers hold `size` bytes
+    auto shift = static_cast<size_t>(
+        std::bit_width(std::max(size, static_cast<size_t>(1)) - 1));
+    shift      = std::max(shift, MIN_SHIFT);
+    if (shift > MAX_SHIFT)
+        return nullptr;
+
+    std::scoped_lock lock(_mutex);
+    for (auto i = shift - MIN_SHIFT; i < _classes.size(); i++) {
+        if (!_classes[i].empty()) {
+            auto buffer = std::move(_classes[i].back());
+            _classes[i].pop_back();
+            _count--;
+            _bytes -= buffer->capacity();
+            return buffer;
+        }
+    }
+    return nullptr;
+}
+
+auto BufferPool::acquire(size_t size) -> std::shared_ptr<MessageBuffer>
+{
+    auto buffer = take(size);
+    if (!buffer) {
+        _allocations++;
+        buffer = std::make_shared<MessageBuffer>();
+    }
+    resize(*buffer, size);
+    return buffer;
+}
+
+auto BufferPool::release(std::shared_ptr<MessageBuffer> buffer) -> void
+{
+    // buffers, which are still referenced elsewhere, can not be reused
+    if (!buffer || buffer.use_count() != 1)
+        return;
+
+    auto capacity = buffer->capacity();
+    if (capacity < static_cast<size_t>(1) << MIN_SHIFT)
+        return;
+    auto shift = std::min(static_cast<size_t>(std::bit_width(capacity)) - 1,
+                          MAX_SHIFT);
+
+    std::scoped_lock lock(_mutex);
+    if (_count < _maxCount && _bytes + capacity <= _maxBytes) {
+        _count++;
+        _bytes += capacity;
+        _classes[shift - MIN_SHIFT].push_back(std::move(buffer));
+    }
+}
+
+auto BufferPool::resize(MessageBuffer &buffer, size_t size) -> void
+{
+    if (size > buffer.capacity()) {
+        // trade the buffer for a larger one of the pool, if there is one
+        if (auto larger = take(size)) {
+            larger->assign(buffer.begin(), buffer.end());
+            buffer.swap(*larger);
+            release(std::move(larger));
+        }
+        else {
+            _allocations++;
+            buffer.reserve(capacityFor(size));
+        }
+    }
+    buffer.resize(size);
+}
+
+auto BufferPool::getAllocations() const -> size_t { return _allocations; }
+
+auto BufferPool::setLimits(size_t maxCount, size_t maxBytes) -> void
+{
+    std::vector<std::shared_ptr<MessageBuffer>> dropped;
+    std::scoped_lock                            lock(_mutex);
+    _maxCount = maxCount;
+    _maxBytes = maxBytes;
+
+    // the largest buffers go first
+    for (auto it = _classes.rbegin(); it != _classes.rend(); it++) {
+        while (!it->empty() && (_count > _maxCount || _bytes > _maxBytes)) {
+            _count--;
+            _bytes -= it->back()->capacity();
+            dropped.push_back(std::move(it->back()));
+            it->pop_back();
+        }
+    }
+}
+
+auto BufferPool::getLimits() const -> std::tuple<size_t, size_t>
+{
+    std::scoped_lock lock(_mutex);
+    return {_maxCount, _maxBytes};
+}
+
+AdaptiveBufferSize::AdaptiveBufferSize(size_t initialSize)
+    : _size{initialSize}
+{
+}
+
+auto AdaptiveBufferSize::update(size_t messageSize) -> size_t
+{
+    // bucket i counts the messages of up to 1 << (MIN_SHIFT + i) bytes
+    auto shift = static_cast<size_t>(std::bit_width(
+        std::max(messageSize, static_cast<size_t>(1)) - 1));
+    shift      = std::clamp(shift, MIN_SHIFT, MAX_SHIFT);
+    _counts[shift - MIN_SHIFT]++;
+    if (++_pending < WINDOW)
+        return _size;
+    _pending = 0;
+
+    uint64_t total{0};
+    for (auto count : _counts)
+        total += count;
+
+    uint64_t covered{0};
+    for (size_t i = 0; i < _counts.size(); i++) {
+        covered += _counts[i];
+        if (covered * 100 >= total * PERCENTILE) {
+            _size = static_cast<size_t>(1) << (MIN_SHIFT + i);
+            break;
+        }
+    }
+    for (auto &count : _counts)
+        count /= 2;
+    return _size;
+}
+
+BufferView::BufferView(PyObject *obj, int flags)
+{
+    if (PyObject_GetBuffer(obj, &_view, flags) != 0)
+        throw nanobind::python_error();
+}
+
+BufferView::~BufferView() { PyBuffer_Release(&_view); }
+
+auto BufferView::data() const -> char *
+{
+    return static_cast<char *>(_view.buf);
+}
+
+auto BufferView::size() const -> size_t
+{
+    return static_cast<size_t>(_view.len);
+}
@@ -0,0 +1,182 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <Python.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Allocator which default-initializes elements, so resizing a receive buffer
+// does not zero memory that the next read overwrites anyway.
+template <typename T> class DefaultInitAllocator : public std::allocator<T> {
+  public:
+    template <typename U> struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    using std::allocator<T>::allocator;
+
+    template <typename U> void construct(U *p)
+    {
+        ::new (static_cast<void *>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&...args)
+    {
+        ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+using MessageBuffer = std::vector<char, DefaultInitAllocator<char>>;
+
+// Bounded free lists of receive buffers, one per size class. A buffer of
+// class c holds at least 1 << c bytes, from 4 KiB (MIN_SHIFT) to 32 MiB
+// (MAX_SHIFT), so acquire() takes a buffer of the smallest class, which fits,
+// and a large buffer is not spent on a small message. New buffers are rounded
+// up to a power of two, so they fall into a class again, larger ones are not
+// kept. Buffers keep their capacity, so a connection in steady state receives
+// without touching the heap.
+class BufferPool {
+  public:
+    static constexpr size_t MIN_SHIFT{12};
+    static constexpr size_t MAX_SHIFT{25};
+
+    BufferPool(size_t maxCount, size_t maxBytes);
+
+    auto acquire(size_t size) -> std::shared_ptr<MessageBuffer>;
+    auto release(std::shared_ptr<MessageBuffer> buffer) -> void;
+    auto resize(MessageBuffer &buffer, size_t size) -> void;
+    auto getAllocations() const -> size_t;
+
+    // Buffers beyond the new limits are freed
+    auto setLimits(size_t maxCount, size_t maxBytes) -> void;
+    auto getLimits() const -> std::tuple<size_t, size_t>;
+
+  private:
+    using FreeList = std::vector<std::shared_ptr<MessageBuffer>>;
+
+    size_t                                          _maxCount;
+    size_t                                          _maxBytes;
+    size_t                                          _count{0};
+    size_t                                          _bytes{0};
+    std::array<FreeList, MAX_SHIFT - MIN_SHIFT + 1> _classes;
+    mutable std::mutex                              _mutex;
+    std::atomic<size_t>                             _allocations{0};
+
+    static auto capacityFor(size_t size) -> size_t;
+    auto        take(size_t size) -> std::shared_ptr<MessageBuffer>;
+};
+
+// Bounded free list of objects, which are shared with the I/O thread, like
+// the OverlappedData of the writes. The object and the control block of its
+// shared_ptr are a single allocation, which a recycled pointer saves.
+// Objects, which are still referenced elsewhere, are not kept, the caller
+// resets the state of the others.
+template <typename T> class ObjectPool {
+  public:
+    explicit ObjectPool(size_t maxCount)
+        : _maxCount{maxCount}
+    {
+    }
+
+    auto acquire() -> std::shared_ptr<T>
+    {
+        {
+            std::scoped_lock lock(_mutex);
+            if (!_objects.empty()) {
+                auto object = std::move(_objects.back());
+                _objects.pop_back();
+                return object;
+            }
+        }
+        _allocations++;
+        return std::make_shared<T>();
+    }
+
+    auto release(std::shared_ptr<T> object) -> void
+    {
+        if (!object || object.use_count() != 1)
+            return;
+
+        std::scoped_lock lock(_mutex);
+        if (_objects.size() < _maxCount)
+            _objects.push_back(std::move(object));
+    }
+
+    // Objects beyond the new limit are freed
+    auto setLimit(size_t maxCount) -> void
+    {
+        std::vector<std::shared_ptr<T>> dropped;
+        std::scoped_lock                lock(_mutex);
+        _maxCount = maxCount;
+        while (_objects.size() > _maxCount) {
+            dropped.push_back(std::move(_objects.back()));
+            _objects.pop_back();
+        }
+    }
+
+    auto getLimit() const -> size_t
+    {
+        std::scoped_lock lock(_mutex);
+        return _maxCount;
+    }
+
+    auto getAllocations() const -> size_t { return _allocations; }
+
+  private:
+    size_t                          _maxCount;
+    std::vector<std::shared_ptr<T>> _objects;
+    mutable std::mutex              _mutex;
+    std::atomic<size_t>             _allocations{0};
+};
+
+// Size of the posted read buffer, which follows the sizes of the received
+// messages: a running histogram with power of two buckets selects the
+// smallest size, which holds PERCENTILE percent of the messages. The
+// counts are halved after every update, so old messages fade out. Only
+// the I/O thread of the connection calls update().
+class AdaptiveBufferSize {
+  public:
+    static constexpr size_t   MIN_SHIFT{12}; // 4 KiB
+    static constexpr size_t   MAX_SHIFT{24}; // 16 MiB
+    static constexpr uint32_t WINDOW{32};    // messages between two updates
+    static constexpr uint32_t PERCENTILE{90};
+
+    explicit AdaptiveBufferSize(size_t initialSize);
+
+    // Records a received message and returns the size of the next buffer
+    auto update(size_t messageSize) -> size_t;
+
+  private:
+    std::array<uint32_t, MAX_SHIFT - MIN_SHIFT + 1> _counts{};
+    uint32_t                                        _pending{0};
+    size_t                                          _size;
+};
+
+// RAII wrapper for the Python buffer protocol. It must be created and
+// destroyed while holding the GIL.
+class BufferView {
+  public:
+    BufferView(PyObject *obj, int flags);
+    BufferView(const BufferView &)                     = delete;
+    auto operator=(const BufferView &) -> BufferView & = delete;
+    ~BufferView();
+
+    auto data() const -> char *;
+    auto size() const -> size_t;
+
+  private:
+    Py_buffer _view;
+};
+
+#endif
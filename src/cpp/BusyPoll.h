@@ -0,0 +1,82 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef BUSYPOLL_H
+#define BUSYPOLL_H
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+// Upper bound of the busy_poll_us setting
+const uint32_t MAX_BUSY_POLL_US{1000000};
+
+// Hint for the CPU, that the thread is spinning
+inline auto cpuRelax() -> void
+{
+#ifdef _WIN32
+    YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+// Spinning only pays off, if the I/O thread can run on another CPU meanwhile
+inline auto canSpin() -> bool
+{
+    static const bool multiCore = std::thread::hardware_concurrency() > 1;
+    return multiCore;
+}
+
+// Spin time of a receiver before it goes to sleep. It follows the recent
+// waits for a message: an exponential moving average with a weight of 1/8,
+// where every wait counts as at most 4 times the limit, so a single idle
+// period is forgotten after a few messages. The receiver spins for twice the
+// average, within MIN_SPIN and the limit, and not at all while the average
+// exceeds the limit, so a slow peer costs no CPU time. Only the receiving
+// thread uses it.
+class AdaptiveSpin {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::chrono::nanoseconds MIN_SPIN{5000};
+
+    auto budget(std::chrono::microseconds limit) const
+        -> std::chrono::nanoseconds
+    {
+        auto limitNs = std::chrono::nanoseconds(limit).count();
+        if (limitNs <= 0 || _averageNs > limitNs)
+            return std::chrono::nanoseconds(0);
+        return std::chrono::nanoseconds(std::min(
+            limitNs, std::max(2 * _averageNs, MIN_SPIN.count())));
+    }
+
+    // Records how long the receiver waited for a message, since it found
+    // the queue empty
+    auto record(Clock::duration waited, std::chrono::microseconds limit)
+        -> void
+    {
+        auto waitedNs = std::clamp<int64_t>(
+            std::chrono::nanoseconds(waited).count(),
+            0,
+            4 * std::chrono::nanoseconds(limit).count());
+        _averageNs += (waitedNs - _averageNs) / 8;
+    }
+
+    auto getAverage() const -> std::chrono::nanoseconds
+    {
+        return std::chrono::nanoseconds(_averageNs);
+    }
+
+  private:
+    int64_t _averageNs{0};
+};
+
+#endif
@@ -6,12 +6,16 @@
 #define PIPE_H
 
 #include "./PipeConnection.h"
-#include <format>
 #include <mutex>
 #include <string>
 #include <tuple>
 
 auto generatePipeAddress() -> std::string;
-auto pipe(bool duplex = true) -> std::tuple<PipeConnection *, PipeConnection *>;
+auto createPipe(bool   duplex                = true,
+                size_t sharedMemorySize      = 0,
+                size_t sharedMemoryThreshold = SHARED_MEMORY_THRESHOLD,
+                size_t bufferSize            = BUFSIZE,
+                bool   adaptiveBuffer        = false)
+    -> std::tuple<PipeConnection *, PipeConnection *>;
 
 #endif
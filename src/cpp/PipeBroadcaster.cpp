@@ -0,0 +1,150 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./PipeBroadcaster.h"
+#include <algorithm>
+#include <stdexcept>
+
+auto PipeBroadcaster::stateName(State state) -> const char *
+{
+    switch (state) {
+        case State::Lagging:
+            return "lagging";
+        case State::Removed:
+            return "removed";
+        case State::Failed:
+            return "failed";
+        default:
+            return "active";
+    }
+}
+
+PipeBroadcaster::PipeBroadcaster(nanobind::iterable    connections,
+                                 size_t                maxQueued,
+                                 std::optional<size_t> maxQueuedBytes,
+                                 const std::string    &onSlow)
+    : _maxQueued{maxQueued},
+      _maxQueuedBytes{maxQueuedBytes},
+      _removeSlow{onSlow == "remove"}
+{
+    if (onSlow != "drop" && onSlow != "remove")
+        throw nanobind::value_error("on_slow must be 'drop' or 'remove'");
+    if (maxQueued == 0)
+        throw nanobind::value_error("max_queued must be greater than 0");
+    for (auto connection : connections)
+        add(connection);
+}
+
+auto PipeBroadcaster::add(nanobind::handle connection) -> void
+{
+    if (!nanobind::isinstance<PipeConnection>(connection))
+        throw nanobind::type_error("expected a PipeConnection");
+    auto pc = nanobind::cast<PipeConnection *>(connection);
+    if (!pc->getWritable())
+        throw nanobind::value_error("connection is read-only");
+    for (auto &subscriber : _subscribers)
+        if (subscriber.connection == pc)
+            return;
+    _subscribers.push_back({nanobind::borrow(connection), pc});
+}
+
+auto PipeBroadcaster::remove(nanobind::handle connection) -> void
+{
+    if (!nanobind::isinstance<PipeConnection>(connection))
+        throw nanobind::type_error("expected a PipeConnection");
+    auto pc = nanobind::cast<PipeConnection *>(connection);
+    std::erase_if(_subscribers, [pc](const Subscriber &subscriber) {
+        return subscriber.connection == pc;
+    });
+}
+
+auto PipeBroadcaster::isSlow(const PipeConnection &connection) const -> bool
+{
+    return connection.getTxQueued() >= _maxQueued ||
+           (_maxQueuedBytes &&
+            connection.getTxInflightBytes() >= *_maxQueuedBytes);
+}
+
+auto PipeBroadcaster::publish(nanobind::handle            buffer,
+                              const size_t                offset,
+                              const std::optional<size_t> size) -> size_t
+{
+    // bytes are immutable, so the writes can share them, any other buffer
+    // is copied once
+    nanobind::object payload;
+    size_t           payloadOffset = offset;
+    size_t           payloadSize;
+    {
+        auto view   = BufferView(buffer.ptr(), PyBUF_SIMPLE);
+        payloadSize = getMessageSize(view, offset, size);
+        if (PyBytes_CheckExact(buffer.ptr())) {
+            payload = nanobind::borrow(buffer);
+        }
+        else {
+            payload = nanobind::bytes(view.data() + offset, payloadSize);
+            payloadOffset = 0;
+        }
+    }
+
+    size_t queued = 0;
+    for (auto &subscriber : _subscribers) {
+        if (subscriber.state == State::Removed ||
+            subscriber.state == State::Failed)
+            continue;
+
+        auto &connection = *subscriber.connection;
+        if (!isSlow(connection)) {
+            std::optional<uint64_t> ticket;
+            try {
+                ticket = connection.sendBytesNowait(payload,
+                                                    payloadOffset,
+                                                    payloadSize);
+            }
+            catch (const std::exception &) {
+                // closed or broken, the other subscribers are not affected
+                subscriber.state = State::Failed;
+                continue;
+            }
+            if (ticket) {
+                subscriber.sent++;
+                subscriber.state = State::Active;
+                queued++;
+                continue;
+            }
+            // TxQueue is full or the Tx limit was reached
+        }
+        subscriber.dropped++;
+        subscriber.state = _removeSlow ? State::Removed : State::Lagging;
+    }
+    return queued;
+}
+
+auto PipeBroadcaster::getSubscribers() const -> nanobind::list
+{
+    nanobind::list subscribers;
+    for (auto &subscriber : _subscribers)
+        if (subscriber.state == State::Active ||
+            subscriber.state == State::Lagging)
+            subscribers.append(subscriber.object);
+    return subscribers;
+}
+
+auto PipeBroadcaster::getStats() const -> nanobind::list
+{
+    nanobind::list stats;
+    for (auto &subscriber : _subscribers) {
+        auto &connection = *subscriber.connection;
+        auto  closed     = connection.getClosed();
+
+        nanobind::dict entry;
+        entry["connection"]   = subscriber.object;
+        entry["state"]        = stateName(subscriber.state);
+        entry["sent"]         = subscriber.sent;
+        entry["dropped"]      = subscriber.dropped;
+        entry["queued"]       = closed ? 0 : connection.getTxQueued();
+        entry["queued_bytes"] = closed ? 0 : connection.getTxInflightBytes();
+        stats.append(entry);
+    }
+    return stats;
+}
@@ -0,0 +1,67 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef PIPEBROADCASTER_H
+#define PIPEBROADCASTER_H
+
+#include "./PipeConnection.h"
+#include <nanobind/nanobind.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Default number of queued writes, from which a subscriber is slow
+const size_t BROADCAST_MAX_QUEUED{64};
+
+// Sends every published message to all subscribed connections without
+// waiting. The payload is copied at most once, into a bytes object, which
+// all writes pin until they completed. A subscriber, which has
+// `maxQueued` writes or `maxQueuedBytes` bytes in flight, is slow: with the
+// policy "drop" it misses the message, with "remove" it is unsubscribed.
+// A broadcaster is meant for one publishing thread. On free-threaded Python
+// the bindings let concurrent calls take turns, see nanobind::lock_self().
+class PipeBroadcaster {
+  public:
+    PipeBroadcaster(nanobind::iterable    connections,
+                    size_t                maxQueued      = BROADCAST_MAX_QUEUED,
+                    std::optional<size_t> maxQueuedBytes = {},
+                    const std::string    &onSlow         = "drop");
+
+    auto add(nanobind::handle connection) -> void;
+    auto remove(nanobind::handle connection) -> void;
+
+    // Returns the number of subscribers, to which the message was queued
+    auto publish(nanobind::handle            buffer,
+                 const size_t                offset = 0,
+                 const std::optional<size_t> size   = {}) -> size_t;
+
+    // connections, which still receive messages
+    auto getSubscribers() const -> nanobind::list;
+
+    // One dict per subscriber with its state ("active", "lagging", "removed"
+    // or "failed"), the messages it was sent or missed, and its lag: the
+    // writes and bytes, which are still in flight
+    auto getStats() const -> nanobind::list;
+
+  private:
+    enum class State { Active, Lagging, Removed, Failed };
+
+    struct Subscriber {
+        nanobind::object object; // keeps the connection alive
+        PipeConnection  *connection;
+        uint64_t         sent{0};
+        uint64_t         dropped{0};
+        State            state{State::Active};
+    };
+
+    const size_t            _maxQueued;
+    std::optional<size_t>   _maxQueuedBytes;
+    bool                    _removeSlow;
+    std::vector<Subscriber> _subscribers;
+
+    auto isSlow(const PipeConnection &connection) const -> bool;
+    static auto stateName(State state) -> const char *;
+};
+
+#endif
@@ -8,6 +8,8 @@
 #include "./PipeConnection.h"
 #include <string>
 
-auto pipeClient(std::string address) -> PipeConnection *;
+auto pipeClient(std::string address,
+                size_t      bufferSize     = BUFSIZE,
+                bool        adaptiveBuffer = false) -> PipeConnection *;
 
 #endif
@@ -4,308 +4,1154 @@
 
 #include "./PipeConnection.h"
 #include "./util.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <nanobind/nanobind.h>
+#include <stdexcept>
+#include <thread>
 
-PipeConnection::PipeConnection(size_t handle, bool readable, bool writable)
-    : _handle{reinterpret_cast<const HANDLE>(handle)},
-      _readable{readable},
-      _writable{writable}
+PipeConnection::~PipeConnection() { close(); }
+
+auto getMessageSize(const BufferView           &view,
+                    const size_t                offset,
+                    const std::optional<size_t> size) -> size_t
 {
-    if (!readable && !writable)
-        throw nanobind::value_error(
-            "at least one of `readable` and `writable` must be True");
-};
+    auto bufferLength = view.size();
+    if (bufferLength == 0)
+        throw nanobind::value_error("buffer is empty");
+    if (bufferLength <= offset)
+        throw nanobind::value_error("buffer length <= offset");
 
-PipeConnection::~PipeConnection() { close(); }
-auto PipeConnection::close() -> void
+    auto _size = bufferLength - offset;
+    if (size.has_value()) {
+        _size = size.value();
+        if (offset + _size > bufferLength)
+            throw nanobind::value_error("buffer length < offset + size");
+    }
+    return _size;
+}
+
+[[noreturn]] static auto raiseWouldBlock(const char *reason) -> void
+{
+    PyErr_SetString(PyExc_BlockingIOError, reason);
+    throw nanobind::python_error();
+}
+
+static auto getLowWatermark(std::optional<size_t> high,
+                            std::optional<size_t> low) -> size_t
+{
+    if (!high.has_value()) {
+        if (low.has_value())
+            throw nanobind::value_error("low watermark requires a limit");
+        return 0;
+    }
+    if (high.value() == 0)
+        throw nanobind::value_error("limit must be greater than 0");
+    if (low.value_or(0) > high.value())
+        throw nanobind::value_error("low watermark must not exceed the limit");
+    return low.value_or(high.value() / 2);
+}
+
+auto checkBufferSize(size_t bufferSize) -> void
+{
+    if (bufferSize == 0)
+        throw nanobind::value_error("buffer_size must be greater than 0");
+}
+
+auto getDeadline(const std::optional<double> timeout)
+    -> std::chrono::steady_clock::time_point
+{
+    if (!timeout.has_value())
+        return std::chrono::steady_clock::time_point::max();
+    return std::chrono::steady_clock::now() +
+           std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::duration<double>(std::max(*timeout, 0.0)));
+}
+
+auto PipeConnection::getReadable() const -> bool { return _readable; }
+
+auto PipeConnection::getWritable() const -> bool { return _writable; }
+
+auto PipeConnection::getClosed() -> bool { return _closed; }
+
+auto PipeConnection::sendBytes(nanobind::handle            buffer,
+                               const size_t                offset,
+                               const std::optional<size_t> size,
+                               const bool                  blocking,
+                               const size_t                priority) -> void
 {
-    if (!_closed) {
-        _closed = true;
+    if (_closed) [[unlikely]]
+        throw std::runtime_error("handle is closed");
+    if (!_writable) [[unlikely]]
+        throw std::runtime_error("connection is read-only");
+    if (priority >= TX_PRIORITIES) [[unlikely]]
+        throw nanobind::value_error("priority must be 0, 1, 2 or 3");
+    // descriptors of the shared memory ring must stay in allocation order
+    if (priority != 0 && _txRing) [[unlikely]]
+        throw nanobind::value_error(
+            "priorities are not supported with shared memory");
+
+    // a failing start closes the connection, which takes the lock
+    checkIo();
+
+    std::shared_ptr<OverlappedData> pending;
+    {
+        auto lock = lockTx();
+        releaseCompletedWrites();
+        if (!waitForTxCredit(blocking)) [[unlikely]]
+            raiseWouldBlock("max_tx_inflight_bytes reached");
+        if (!blocking && priority == 0 && !hasTxRoom(1)) [[unlikely]]
+            raiseWouldBlock("send queue is full");
+        if (!blocking && priority != 0 && !hasLaneRoom()) [[unlikely]]
+            raiseWouldBlock("priority lanes are full");
 
-        if (_readable) {
-            SetEvent(_RxQueueEvent);
+        // the buffer is not copied, it stays pinned until the write completed
+        auto pOd = acquireWrite(buffer, offset, size);
+        if (priority != 0) {
+            pOd->priority = priority;
+            pushTxLane(pOd);
+            pending = std::move(pOd);
+        }
+        else {
+            pending = writeMessage(std::move(pOd));
         }
+    }
+    // other senders queue their writes meanwhile
+    if (blocking && pending)
+        waitForWrite(std::move(pending));
+}
+
+auto PipeConnection::sendBytesNowait(nanobind::handle            buffer,
+                                     const size_t                offset,
+                                     const std::optional<size_t> size)
+    -> std::optional<uint64_t>
+{
+    if (_closed) [[unlikely]]
+        throw std::runtime_error("handle is closed");
+    if (!_writable) [[unlikely]]
+        throw std::runtime_error("connection is read-only");
+
+    checkIo(); // before the lock, see sendBytes()
+    auto lock = lockTx();
+    releaseCompletedWrites();
 
-        // close handles
-        if (!CloseHandle(_handle))
-            Win32ErrorExit(0);
-        if (_started && !CloseHandle(_completionPort))
-            Win32ErrorExit(0);
-        if (_readable) {
-            CloseHandle(_RxQueueEvent);
+    // validate the buffer, before the caller is told to wait
+    auto pOd = acquireWrite(buffer, offset, size);
+
+    if (!waitForTxCredit(false) || !hasTxRoom(1)) {
+        recycleWrite(std::move(pOd));
+        return {};
+    }
+
+    auto queued = _txQueued;
+    writeMessage(std::move(pOd));
+    return _txQueued == queued ? 0 : _txQueued;
+}
+
+auto PipeConnection::waitForTxCredit(const bool wait) -> bool
+{
+    // called with _txMutex held, like pushTxQueue()
+    auto high = _txHighWatermark.load();
+    if (high == 0 || (!_txThrottled.load() && _txInflightBytes.load() < high))
+        [[likely]]
+        return true;
+
+    // Sending resumes below the low watermark. The I/O thread sets the Tx
+    // event, if it sees the flag, otherwise we see its count after the reset.
+    _txThrottled.store(true);
+    auto low = _txLowWatermark.load();
+    while (_txInflightBytes.load() > low) {
+        _TxSpaceEvent.reset();
+        if (_txInflightBytes.load() <= low)
+            break;
+        if (!wait)
+            return false;
+
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            _TxSpaceEvent.wait(2000);
         }
+        if (_closed) [[unlikely]]
+            throw std::runtime_error("handle is closed");
+        checkIo();
+    }
+    _txThrottled.store(false);
+    return true;
+}
+
+auto PipeConnection::hasTxRoom(const size_t messages) -> bool
+{
+    // Called with _txMutex held, which makes us the only producer, so the
+    // room can only grow. A message takes up to two entries of TxQueue, an
+    // INLINE descriptor and the payload, see writeMessage().
+    auto fits = [&] {
+        return _TxQueue.size() + (_txRing ? 2 : 1) * messages <=
+               TX_QUEUE_CAPACITY;
+    };
+    if (fits())
+        return true;
+
+    // the I/O thread sets the Tx event, when a full queue has room again
+    _TxSpaceEvent.reset();
+    return fits();
+}
+
+auto PipeConnection::hasLaneRoom() -> bool
+{
+    // like hasTxRoom(), the I/O thread sets the Tx event, when the lanes
+    // were full and a write completed
+    if (_txLaneQueued.load() < TX_QUEUE_CAPACITY)
+        return true;
+    _TxSpaceEvent.reset();
+    return _txLaneQueued.load() < TX_QUEUE_CAPACITY;
+}
+
+auto PipeConnection::setTxLimit(std::optional<size_t> high,
+                                std::optional<size_t> low) -> void
+{
+    _txLowWatermark.store(getLowWatermark(high, low));
+    _txHighWatermark.store(high.value_or(0));
+    _txThrottled.store(false); // the next send looks at the new limit
+}
+
+auto PipeConnection::setRxLimit(std::optional<size_t> high,
+                                std::optional<size_t> low) -> void
+{
+    auto _low = getLowWatermark(high, low);
+    _rxLowWatermark.store(_low);
+    _rxHighWatermark.store(high.value_or(0));
+
+    // the I/O thread might be waiting for a drain, which is not needed anymore
+    if (_rxThrottled.load() &&
+        (!high.has_value() || _rxQueuedBytes.load() <= _low) &&
+        _rxThrottled.exchange(false))
+        resumeRx();
+}
 
-        // wait until thread stops
-        if (_thread.joinable())
-            _thread.join();
+auto PipeConnection::getTxLimit() const -> std::optional<size_t>
+{
+    auto high = _txHighWatermark.load();
+    if (high == 0)
+        return {};
+    return high;
+}
+
+auto PipeConnection::getRxLimit() const -> std::optional<size_t>
+{
+    auto high = _rxHighWatermark.load();
+    if (high == 0)
+        return {};
+    return high;
+}
+
+auto PipeConnection::getTxInflightBytes() const -> size_t
+{
+    return _txInflightBytes.load();
+}
+
+auto PipeConnection::getTxQueued() const -> size_t
+{
+    return _TxQueue.size() + _txLaneQueued.load();
+}
+
+auto PipeConnection::getRxQueuedBytes() const -> size_t
+{
+    return _rxQueuedBytes.load();
+}
+
+auto PipeConnection::getRxQueued() const -> size_t { return _RxQueue.size(); }
+
+static auto histogramToList(const LatencyHistogram &histogram)
+    -> nanobind::list
+{
+    nanobind::list counts;
+    for (auto count : histogram.counts())
+        counts.append(count);
+    return counts;
+}
+
+auto PipeConnection::getStats() const -> nanobind::dict
+{
+    nanobind::dict stats;
+    stats["tx_messages"]        = _stats.txMessages.get();
+    stats["tx_bytes"]           = _stats.txBytes.get();
+    stats["tx_queued"]          = _TxQueue.size();
+    stats["tx_queued_peak"]     = _stats.txQueuePeak.get();
+    stats["tx_latency_us"]      = histogramToList(_stats.txLatency);
+    stats["rx_messages"]        = _stats.rxMessages.get();
+    stats["rx_bytes"]           = _stats.rxBytes.get();
+    stats["rx_queued"]          = _RxQueue.size();
+    stats["rx_queued_peak"]     = _stats.rxQueuePeak.get();
+    stats["rx_more_data_reads"] = _stats.rxMoreData.get();
+    stats["rx_residency_us"]    = histogramToList(_stats.rxResidency);
+    return stats;
+}
+
+auto PipeConnection::resetStats() -> void
+{
+    _stats.reset(_TxQueue.size(), _RxQueue.size());
+}
+
+auto PipeConnection::writeDone(const uint64_t ticket) -> bool
+{
+    // Writes are counted after they succeeded. The I/O thread counts them
+    // before it sets _ioErr, so a failed write is never counted.
+    auto errNo = _ioErr.load();
+    if (_txWritten.load() >= ticket)
+        return true;
+    if (_closed) [[unlikely]]
+        throw std::runtime_error("handle is closed");
+    if (errNo != 0) [[unlikely]]
+        cleanupAndThrowExc(errNo);
+
+    // let the I/O thread set the Tx event for every completed write up to
+    // the highest ticket waited for, so it stops after the last waiter.
+    // Either it sees the ticket, or we see its count after the reset.
+    auto watched = _txWatched.load();
+    while (watched < ticket &&
+           !_txWatched.compare_exchange_weak(watched, ticket)) {
     }
+    _TxSpaceEvent.reset();
+    return _txWritten.load() >= ticket;
 }
 
-inline auto PipeConnection::startThread() -> void
+auto PipeConnection::sendBytesMany(nanobind::iterable buffers,
+                                   const bool         blocking) -> void
 {
-    if (!_started) {
-        _completionPort = CreateIoCompletionPort(_handle, nullptr, 0, 0);
-        if (_completionPort == NULL)
-            cleanupAndThrowExc(0);
+    if (_closed) [[unlikely]]
+        throw std::runtime_error("handle is closed");
+    if (!_writable) [[unlikely]]
+        throw std::runtime_error("connection is read-only");
+
+    // pin all buffers first, so an invalid element does not send a partial
+    // batch. Iterating might run Python code, so it is done without the lock.
+    std::vector<std::shared_ptr<OverlappedData>> writes;
+    for (auto buffer : buffers)
+        writes.push_back(acquireWrite(buffer));
+    if (!blocking && writes.size() * (_txRing ? 2 : 1) > TX_QUEUE_CAPACITY)
+        throw nanobind::value_error(
+            "a non-blocking batch must fit into the send queue");
+
+    checkIo(); // before the lock, see sendBytes()
+
+    std::shared_ptr<OverlappedData> pending;
+    {
+        auto lock = lockTx();
+        releaseCompletedWrites();
+        if (!waitForTxCredit(blocking)) [[unlikely]]
+            raiseWouldBlock("max_tx_inflight_bytes reached");
+        if (!blocking && !hasTxRoom(writes.size())) [[unlikely]]
+            raiseWouldBlock("send queue is full");
 
-        if (_readable) {
-            // Create event to signal, that RxQueue contains value
-            _RxQueueEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+        if (writes.empty())
+            return;
 
-            // initialize read buffer
-            _RxBuffer.resize(static_cast<size_t>(BUFSIZE));
+        if (_txRing) [[unlikely]] {
+            // large payloads go through shared memory, one message at a time
+            for (auto &write : writes)
+                pending = writeMessage(std::move(write));
+        }
+        else {
+            pending = writeBytesMany(std::move(writes));
+        }
+    }
+    // writes complete in order, so the last one completes the batch
+    if (blocking && pending)
+        waitForWrite(std::move(pending));
+}
 
-            // start first read operation
-            if (!ReadFile(_handle,
-                          &_RxBuffer.front(),
-                          _RxBuffer.size(),
-                          nullptr,
-                          &_rxOv)) {
-                auto errNo = GetLastError();
-                if (errNo != ERROR_IO_PENDING) {
-                    cleanupAndThrowExc();
+auto PipeConnection::writeMessage(std::shared_ptr<OverlappedData> pOd)
+    -> std::shared_ptr<OverlappedData>
+{
+    if (_txRing) [[unlikely]] {
+        // keep the ring alive, even if another thread closes the connection
+        auto  ring  = _txRing;
+        auto  size  = pOd->size;
+        char *pData = nullptr;
+        if (size >= _ringThreshold) {
+            if (auto descriptor = ring->allocate(size, pData)) {
+                {
+                    auto nogil = nanobind::gil_scoped_release();
+                    std::memcpy(pData, pOd->pData, size);
                 }
+                recycleWrite(std::move(pOd));
+                return writeDescriptor(*descriptor);
             }
+            // the ring is full, send the payload through the pipe
+        }
+        if (size == sizeof(SharedRingDescriptor)) {
+            // pipe messages of this size are descriptors, so announce that
+            // the payload follows as a plain message
+            writeDescriptor({SharedRingDescriptor::MAGIC,
+                             SharedRingDescriptor::INLINE,
+                             0,
+                             0});
         }
-
-        _thread  = std::thread(&PipeConnection::monitorIoCompletion, this);
-        _started = true;
     }
+    return writeBytes(std::move(pOd));
 }
 
-auto PipeConnection::getHandle() const -> size_t
+auto PipeConnection::writeDescriptor(const SharedRingDescriptor &descriptor)
+    -> std::shared_ptr<OverlappedData>
 {
-    return reinterpret_cast<size_t>(_handle);
+    auto bytes = nanobind::bytes(&descriptor, sizeof(descriptor));
+    return writeBytes(acquireWrite(bytes));
 }
 
-auto PipeConnection::getReadable() const -> bool { return _readable; }
+auto PipeConnection::acquireWrite(nanobind::handle            buffer,
+                                  const size_t                offset,
+                                  const std::optional<size_t> size)
+    -> std::shared_ptr<OverlappedData>
+{
+    auto pOd = _TxPool.acquire();
+    pOd->pin(buffer, offset, size);
+    return pOd;
+}
 
-auto PipeConnection::getWritable() const -> bool { return _writable; }
+auto PipeConnection::recycleWrite(std::shared_ptr<OverlappedData> pOd)
+    -> void
+{
+    // must be called with the GIL held. A write, which is still referenced
+    // by a waiting sender, is simply dropped.
+    if (pOd.use_count() == 1) {
+        // use_count() is relaxed, the fence orders the reuse after the last
+        // accesses of the sender, which dropped its reference meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        pOd->unpin();
+        _TxPool.release(std::move(pOd));
+    }
+}
 
-auto PipeConnection::getClosed() -> bool { return _closed; }
+auto PipeConnection::recvBytes(std::optional<int>            maxLength,
+                               const bool                    blocking,
+                               const std::optional<uint32_t> busyPollUs)
+    -> std::optional<nanobind::bytes>
+{
+    auto payload = popRxPayload(
+        blocking, std::chrono::steady_clock::time_point::max(), busyPollUs);
+    if (!payload)
+        return {};
 
-auto PipeConnection::sendBytes(const nanobind::bytes       buffer,
-                               const size_t                offset,
-                               const std::optional<size_t> size,
-                               const bool                  blocking) -> void
+    // create python bytes object from vector and recycle the vector
+    auto bytes = nanobind::bytes(payload->data(), payload->size());
+    releaseRxPayload(*payload);
+    return bytes;
+}
+
+auto PipeConnection::recvBytesMany(const std::optional<size_t> maxCount,
+                                   const std::optional<double> timeout)
+    -> nanobind::list
 {
-    if (_closed) [[unlikely]]
-        throw std::exception("handle is closed");
-    if (!_writable) [[unlikely]]
-        throw std::exception("connection is read-only");
+    if (maxCount.has_value() && maxCount.value() == 0)
+        throw nanobind::value_error("max_count must be greater than 0");
 
-    checkThread();
+    // wait for the first message, then take what is queued already. The
+    // lock keeps other receivers from taking messages in between.
+    auto deadline = getDeadline(timeout);
+    auto lock     = lockRx(true, deadline);
+    if (!lock)
+        return {};
 
-    auto bufferLength = buffer.size();
-    if (bufferLength <= offset)
-        throw nanobind::value_error("buffer length <= offset");
+    nanobind::list messages;
+    size_t         count{0};
+    auto           payload = popRxPayload(true, deadline);
+    while (payload) {
+        messages.append(nanobind::bytes(payload->data(), payload->size()));
+        releaseRxPayload(*payload);
+        if (++count == maxCount.value_or(0) || _RxQueue.empty())
+            break;
+        payload = popRxPayload(false);
+    }
+    return messages;
+}
 
-    auto _size = bufferLength - offset;
-    if (size.has_value()) {
-        _size = size.value();
-        if (offset + _size > bufferLength)
-            throw nanobind::value_error("buffer length < offset + size");
+auto PipeConnection::recvBytesInto(nanobind::handle buffer,
+                                   const size_t     offset,
+                                   const bool       blocking)
+    -> std::optional<size_t>
+{
+    auto view = BufferView(buffer.ptr(), PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS);
+    if (offset > view.size())
+        throw nanobind::value_error("offset too large");
+
+    auto payload = popRxPayload(blocking);
+    if (!payload)
+        return {};
+
+    auto size = payload->size();
+    if (view.size() - offset < size) {
+        // like multiprocessing, hand the complete message to the caller
+        auto bytes = nanobind::bytes(payload->data(), size);
+        releaseRxPayload(*payload);
+        auto exc = nanobind::module_::import_("multiprocessing")
+                       .attr("BufferTooShort");
+        PyErr_SetObject(exc.ptr(), bytes.ptr());
+        throw nanobind::python_error();
     }
 
-    // create OverlappedObject and push it to the queue before starting
-    // WriteFile(), otherwise the monitor thread might try to clean up before it
-    // is inserted
-    auto pOd = std::shared_ptr<OverlappedData>(
-        new OverlappedData(buffer.c_str() + offset, _size));
-    {
-        std::scoped_lock lock(_TxQueueMutex);
-        _TxQueue.push(pOd);
+    std::memcpy(view.data() + offset, payload->data(), size);
+    releaseRxPayload(*payload);
+    return size;
+}
+
+auto PipeConnection::recvBytesView(const bool blocking)
+    -> std::optional<nanobind::object>
+{
+    auto payload = popRxPayload(blocking);
+    if (!payload)
+        return {};
+
+    nanobind::object owner;
+    if (payload->ring) {
+        // the memoryview points into the shared memory ring
+        owner = nanobind::cast(
+            new SharedRingView(std::move(payload->ring), payload->span),
+            nanobind::rv_policy::take_ownership);
     }
-    if (!WriteFile(_handle,
-                   &pOd->vector.front(),
-                   pOd->vector.size(),
-                   NULL,
-                   &pOd->overlapped)) {
-        auto errNo = GetLastError();
-        switch (errNo) {
-            case ERROR_SUCCESS:
-            case ERROR_IO_INCOMPLETE:
-            case ERROR_IO_PENDING:
-                break;
-            default:
-                cleanupAndThrowExc(errNo);
-        }
+    else {
+        owner = nanobind::bytes(payload->data(), payload->size());
+        releaseRxPayload(*payload);
     }
+    auto memoryView = PyMemoryView_FromObject(owner.ptr());
+    if (memoryView == nullptr)
+        throw nanobind::python_error();
+    return nanobind::steal(memoryView);
+}
+
+auto PipeConnection::poll(const std::optional<double> timeout) -> bool
+{
+    auto deadline = getDeadline(timeout);
+    while (true) {
+        if (_closed) [[unlikely]]
+            throw std::runtime_error("handle is closed");
+        if (isReady())
+            return true;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return false;
 
-    if (blocking) {
-        auto  nogil = nanobind::gil_scoped_release();
-        DWORD numberOfBytesTransferred;
-        if (!GetOverlappedResult(_handle,
-                                 &pOd->overlapped,
-                                 &numberOfBytesTransferred,
-                                 TRUE)) {
-            cleanupAndThrowExc();
+        // wake up at least every 2s like popRxMessage()
+        using std::chrono::milliseconds;
+        auto waitMs = std::min(milliseconds(2000),
+                               std::chrono::ceil<milliseconds>(deadline - now));
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            _RxQueueEvent.wait(static_cast<uint32_t>(waitMs.count()));
         }
     }
 }
 
-auto PipeConnection::recvBytes(std::optional<int> maxLength,
-                               const bool         blocking)
-    -> std::optional<nanobind::bytes>
+auto PipeConnection::isReady() -> bool
 {
     if (!_readable) [[unlikely]]
-        throw std::exception("connection is write-only");
+        throw std::runtime_error("connection is write-only");
+    if (_closed)
+        return true;
+
+    startIo();
+    if (_ioErr != 0 || !_RxQueue.empty())
+        return true;
+
+    // A stale event would wake up the waiters over and over. The I/O thread
+    // sets it again after its next push or after storing an error.
+    _RxQueueEvent.reset();
+    return _closed || _ioErr != 0 || !_RxQueue.empty();
+}
+
+auto PipeConnection::popRxPayload(
+    const bool                                  blocking,
+    const std::chrono::steady_clock::time_point deadline,
+    const std::optional<uint32_t>               busyPollUs)
+    -> std::optional<RxPayload>
+{
+    // the lock is held until the payload of an INLINE descriptor was taken
+    auto lock = lockRx(blocking, deadline);
+    if (!lock)
+        return {};
+
+    auto rxMessage = popRxMessage(blocking, deadline, busyPollUs);
+    if (!rxMessage)
+        return {};
+    if (!_rxRing || rxMessage->size() != sizeof(SharedRingDescriptor))
+        [[likely]]
+        return RxPayload{std::move(rxMessage)};
+
+    // the message describes a payload in shared memory
+    SharedRingDescriptor descriptor;
+    std::memcpy(&descriptor, rxMessage->data(), sizeof(descriptor));
+    _RxPool.release(std::move(rxMessage));
+    if (descriptor.magic != SharedRingDescriptor::MAGIC)
+        throw std::runtime_error("invalid shared memory descriptor");
+
+    // the writer sends an inlined payload right after its descriptor
+    if (descriptor.begin == SharedRingDescriptor::INLINE)
+        return RxPayload{popRxMessage(true)};
+
+    return RxPayload{nullptr, _rxRing, _rxRing->resolve(descriptor)};
+}
+
+auto PipeConnection::releaseRxPayload(RxPayload &payload) -> void
+{
+    if (payload.ring)
+        payload.ring->release(payload.span);
+    else
+        _RxPool.release(std::move(payload.buffer));
+    payload = {};
+}
+
+auto RxPayload::data() const -> const char *
+{
+    return ring ? span.data : buffer->data();
+}
+
+auto RxPayload::size() const -> size_t
+{
+    return ring ? span.size : buffer->size();
+}
+
+auto PipeConnection::connectSharedMemory(PipeConnection &reader,
+                                         PipeConnection &writer,
+                                         size_t          size,
+                                         size_t          threshold) -> void
+{
+    if (threshold == 0)
+        throw nanobind::value_error("shared memory threshold must be > 0");
+
+    auto memory           = createSharedRing(size);
+    reader._rxRing        = std::make_shared<SharedRingReader>(memory);
+    reader._ringThreshold = threshold;
+    writer._txRing        = std::make_shared<SharedRingWriter>(memory);
+    writer._ringThreshold = threshold;
+}
+
+auto PipeConnection::attachSharedMemory(std::optional<size_t> rxHandle,
+                                        std::optional<size_t> txHandle,
+                                        size_t threshold) -> void
+{
+    if (_started || _rxRing || _txRing)
+        throw std::runtime_error("shared memory must be attached before the "
+                                 "first send or receive");
+    if (threshold == 0)
+        throw nanobind::value_error("shared memory threshold must be > 0");
+    if (rxHandle.has_value() && !_readable)
+        throw nanobind::value_error("connection is write-only");
+    if (txHandle.has_value() && !_writable)
+        throw nanobind::value_error("connection is read-only");
+
+    if (rxHandle.has_value())
+        _rxRing = std::make_shared<SharedRingReader>(
+            SharedMemory::fromHandle(rxHandle.value()));
+    if (txHandle.has_value())
+        _txRing = std::make_shared<SharedRingWriter>(
+            SharedMemory::fromHandle(txHandle.value()));
+    _ringThreshold = threshold;
+}
+
+auto PipeConnection::getSharedMemory() const -> std::optional<
+    std::tuple<std::optional<size_t>, std::optional<size_t>, size_t>>
+{
+    if (!_rxRing && !_txRing)
+        return {};
+
+    std::optional<size_t> rxHandle;
+    std::optional<size_t> txHandle;
+    if (_rxRing)
+        rxHandle = _rxRing->getMemory()->getHandle();
+    if (_txRing)
+        txHandle = _txRing->getMemory()->getHandle();
+    return std::make_tuple(rxHandle, txHandle, _ringThreshold);
+}
+
+auto PipeConnection::getRxBufferAllocations() const -> size_t
+{
+    return _RxPool.getAllocations();
+}
 
-    startThread();
+auto PipeConnection::getTxWriteAllocations() const -> size_t
+{
+    return _TxPool.getAllocations();
+}
+
+auto PipeConnection::setPoolLimits(std::optional<size_t> txCount,
+                                   std::optional<size_t> rxCount,
+                                   std::optional<size_t> rxBytes) -> void
+{
+    if (txCount.has_value())
+        _TxPool.setLimit(*txCount);
+    if (rxCount.has_value() || rxBytes.has_value()) {
+        auto [count, bytes] = _RxPool.getLimits();
+        _RxPool.setLimits(rxCount.value_or(count), rxBytes.value_or(bytes));
+    }
+}
+
+auto PipeConnection::getPoolLimits() const -> nanobind::dict
+{
+    auto [rxCount, rxBytes] = _RxPool.getLimits();
+
+    nanobind::dict limits;
+    limits["tx_count"] = _TxPool.getLimit();
+    limits["rx_count"] = rxCount;
+    limits["rx_bytes"] = rxBytes;
+    return limits;
+}
+
+auto PipeConnection::getBufferSize() const -> size_t { return _bufferSize; }
+
+auto PipeConnection::getAdaptiveBuffer() const -> bool
+{
+    return _rxAdaptive.has_value();
+}
+
+auto PipeConnection::getRxBufferSize() const -> size_t
+{
+    return _rxBufferSize.load(std::memory_order_relaxed);
+}
+
+auto PipeConnection::setBusyPoll(const uint32_t busyPollUs) -> void
+{
+    if (busyPollUs > MAX_BUSY_POLL_US)
+        throw nanobind::value_error("busy_poll_us must be at most 1000000");
+    _busyPollUs.store(busyPollUs, std::memory_order_relaxed);
+}
+
+auto PipeConnection::getBusyPoll() const -> uint32_t
+{
+    return _busyPollUs.load(std::memory_order_relaxed);
+}
+
+auto PipeConnection::lockRx(
+    const bool                                  blocking,
+    const std::chrono::steady_clock::time_point deadline)
+    -> std::unique_lock<std::recursive_timed_mutex>
+{
+    // Receivers take turns: the holder waits for the next message, the
+    // others wait for the lock until their deadline, without the GIL. A
+    // non-blocking call does not wait, another thread is receiving already.
+    std::unique_lock lock(_rxMutex, std::try_to_lock);
+    if (!lock.owns_lock() && blocking) {
+        auto nogil = nanobind::gil_scoped_release();
+        if (deadline == std::chrono::steady_clock::time_point::max())
+            lock.lock();
+        else
+            (void)lock.try_lock_until(deadline);
+    }
+    return lock;
+}
+
+auto PipeConnection::popRxMessage(
+    const bool                                  blocking,
+    const std::chrono::steady_clock::time_point deadline,
+    const std::optional<uint32_t>               busyPollUs)
+    -> std::shared_ptr<MessageBuffer>
+{
+    if (!_readable) [[unlikely]]
+        throw std::runtime_error("connection is write-only");
+    if (busyPollUs.value_or(0) > MAX_BUSY_POLL_US)
+        throw nanobind::value_error("busy_poll_us must be at most 1000000");
+
+    // a deadline only applies to blocking calls
+    auto lock = lockRx(blocking, deadline);
+    if (!lock)
+        return {};
+
+    startIo();
+    releaseCompletedWrites();
+
+    // a spinning receiver measures, how long it waited for the message
+    auto spinLimit = std::chrono::microseconds(
+        busyPollUs.value_or(_busyPollUs.load(std::memory_order_relaxed)));
+    bool                                  spun{false};
+    std::optional<StatsClock::time_point> waitStart;
+    std::shared_ptr<MessageBuffer>        rxMessage;
+    auto received = [&] {
+        if (waitStart)
+            _rxSpin.record(StatsClock::now() - *waitStart, spinLimit);
+        return std::move(rxMessage);
+    };
 
     while (true) {
         if (_closed) [[unlikely]]
-            throw std::exception("handle is closed");
-
-        // Get RxQueue content and release lock asap
-        _RxQueueMutex.lock();
-        if (!_RxQueue.empty()) {
-            // RxQueue contains a message
-            auto rxMessage = std::move(_RxQueue.front());
-            _RxQueue.pop();
-            if (_RxQueue.empty())
-                ResetEvent(_RxQueueEvent);
-            _RxQueueMutex.unlock();
-
-            // create python bytes object from vector;
-            return nanobind::bytes(&rxMessage->front(), rxMessage->size());
-        };
-        _RxQueueMutex.unlock();
+            throw std::runtime_error("handle is closed");
+
+        if (tryPopRxMessage(rxMessage))
+            return received();
 
         // check thread health, if RxQueue is empty
-        checkThread();
+        checkIo();
 
-        // return None, if non-blocking
-        if (!blocking)
+        // The event might still be set by a message, which was popped in the
+        // meantime. Reset it and look again before going to sleep or telling
+        // an event loop that nothing is queued.
+        _RxQueueEvent.reset();
+        if (tryPopRxMessage(rxMessage))
+            return received();
+
+        // return nullptr, if non-blocking or timed out
+        auto now = std::chrono::steady_clock::now();
+        if (!blocking || now >= deadline)
             return {};
 
+        // spin once before going to sleep. The I/O thread pushes to RxQueue
+        // before it sets the event, so the spinning thread sees the message
+        // without being woken up.
+        if (spinLimit.count() > 0 && !spun && canSpin()) {
+            spun      = true;
+            waitStart = now;
+            auto spin = _rxSpin.budget(spinLimit);
+            if (spin.count() > 0) {
+                auto nogil   = nanobind::gil_scoped_release();
+                auto spinEnd = std::min(deadline, now + spin);
+                while (_RxQueue.empty() && _ioErr == 0 && !_closed &&
+                       std::chrono::steady_clock::now() < spinEnd)
+                    cpuRelax();
+            }
+            continue;
+        }
+
+        // wake up at least every 2s to check the thread health
+        using std::chrono::milliseconds;
+        auto waitMs = std::min(milliseconds(2000),
+                               std::chrono::ceil<milliseconds>(deadline - now));
         {
             // wait for event in case of blocking call
-            auto nogil   = nanobind::gil_scoped_release();
-            auto waitRes = WaitForSingleObject(_RxQueueEvent, 2000);
+            auto nogil = nanobind::gil_scoped_release();
+            _RxQueueEvent.wait(static_cast<uint32_t>(waitMs.count()));
         }
     }
 }
 
-auto PipeConnection::monitorIoCompletion() -> void
+auto PipeConnection::tryPopRxMessage(std::shared_ptr<MessageBuffer> &rxMessage)
+    -> bool
+{
+    bool         wasFull{false};
+    bool         isEmpty{false};
+    RxQueueEntry entry;
+    if (!_RxQueue.pop(entry, &wasFull, &isEmpty))
+        return false;
+    _stats.rxResidency.recordSince(entry.queuedAt);
+    rxMessage = std::move(entry.buffer);
+    auto queuedBytes = _rxQueuedBytes.fetch_sub(rxMessage->size()) -
+                       rxMessage->size();
+
+    if (isEmpty) {
+        // keep the event in sync with the queue for waiters. The I/O
+        // thread might have pushed a message right before the reset.
+        _RxQueueEvent.reset();
+        if (!_RxQueue.empty())
+            _RxQueueEvent.set();
+    }
+
+    // the I/O thread stopped reading, because RxQueue was full or held too
+    // many bytes. Only one side clears the flag and continues reading.
+    auto resume = wasFull;
+    if (_rxThrottled.load() && queuedBytes <= _rxLowWatermark.load() &&
+        _rxThrottled.exchange(false))
+        resume = true;
+    if (resume)
+        resumeRx();
+    return true;
+}
+
+auto PipeConnection::nextRxBufferSize(const size_t messageSize) -> size_t
+{
+    // called by the I/O thread for every received message
+    if (_rxAdaptive.has_value())
+        _rxBufferSize.store(_rxAdaptive->update(messageSize),
+                            std::memory_order_relaxed);
+    return _rxBufferSize.load(std::memory_order_relaxed);
+}
+
+auto PipeConnection::pushRxMessage(std::shared_ptr<MessageBuffer> rxMessage)
+    -> bool
+{
+    // Called by the I/O thread. If RxQueue is full, the message is kept
+    // in _rxPending and the caller must stop reading until resumeRx().
+    // The same applies, after the message reached the Rx limit.
+    auto size = rxMessage->size();
+    if (routeRxMessage(rxMessage)) [[unlikely]] {
+        _stats.rxMessages.add();
+        _stats.rxBytes.add(size);
+        if (rxMessage)
+            _RxPool.release(std::move(rxMessage));
+        return true;
+    }
+
+    bool         wasEmpty{false};
+    RxQueueEntry entry{std::move(rxMessage), _stats.rxSampler.start()};
+    _rxQueuedBytes.fetch_add(size); // before the receiver can subtract it
+    if (!_RxQueue.push(std::move(entry), &wasEmpty)) {
+        _rxQueuedBytes.fetch_sub(size);
+        _rxPending = std::move(entry.buffer);
+        return false;
+    }
+    _stats.rxMessages.add();
+    _stats.rxBytes.add(size);
+    _stats.rxQueuePeak.observe(_RxQueue.size());
+
+    // only the first message wakes up the receiver
+    if (wasEmpty)
+        _RxQueueEvent.set();
+
+    auto high = _rxHighWatermark.load();
+    if (high != 0 && _rxQueuedBytes.load() >= high) [[unlikely]] {
+        // The receiver might have drained the queue in the meantime. Either
+        // it sees the flag, or we see its count after setting it.
+        _rxThrottled.store(true);
+        if (_rxQueuedBytes.load() > _rxLowWatermark.load() ||
+            !_rxThrottled.exchange(false))
+            return false;
+    }
+    return true;
+}
+
+auto PipeConnection::setRxRouter(std::shared_ptr<RxRouter> router) -> void
+{
+    // only the first of concurrent callers installs its router
+    std::lock_guard lock(_rxRouterMutex);
+    RxRouter       *expected{nullptr};
+    if (!_rxRouter.compare_exchange_strong(expected, router.get()))
+        throw nanobind::value_error(
+            "connection is used by an RPC channel or dispatcher already");
+    _rxRouterOwner = std::move(router);
+
+    // the I/O thread might have failed before it saw the router
+    if (_ioErr != 0)
+        _rxRouterOwner->fail(_ioErr);
+}
+
+auto PipeConnection::clearRxRouter(const RxRouter *router) -> void
+{
+    std::lock_guard lock(_rxRouterMutex);
+    auto            expected = const_cast<RxRouter *>(router);
+    if (!_rxRouter.compare_exchange_strong(expected, nullptr))
+        return; // removed already, maybe another router was installed
+
+    // Either a thread sees the router removed, or we see it counted in
+    // _rxRouting, see routeRxMessage()
+    while (_rxRouting.load() != 0)
+        std::this_thread::yield();
+    _rxRouterOwner.reset();
+}
+
+auto PipeConnection::routeRxMessage(std::shared_ptr<MessageBuffer> &message)
+    -> bool
+{
+    // called by the I/O thread, plain connections skip the counting
+    if (_rxRouter.load(std::memory_order_acquire) == nullptr)
+        return false;
+
+    _rxRouting.fetch_add(1);
+    auto router = _rxRouter.load();
+    auto routed = router != nullptr && router->route(message);
+    _rxRouting.fetch_sub(1);
+    return routed;
+}
+
+auto PipeConnection::failRxRouter(NativeError errNo) -> void
 {
-    ULONG_PTR completionKey{0};
-    size_t    bytesReadTotal{0};
+    _rxRouting.fetch_add(1); // like routeRxMessage()
+    if (auto router = _rxRouter.load())
+        router->fail(errNo);
+    _rxRouting.fetch_sub(1);
+}
+
+auto PipeConnection::pushTxQueue(std::shared_ptr<OverlappedData> pOd,
+                                 const StatsClock::time_point    queuedAt)
+    -> bool
+{
+    // Must be called with _txMutex held, returns true if TxQueue was empty.
+    // `queuedAt` was sampled by the send call, once per message.
+    releaseCompletedWrites();
+
+    bool wasEmpty{false};
+    auto size     = pOd->size;
+    pOd->queuedAt = queuedAt;
+    _txInflightBytes.fetch_add(size); // before the I/O thread subtracts it
+    while (!_TxQueue.push(std::move(pOd), &wasEmpty)) {
+        // TxQueue is full, wait until the I/O thread completed a write.
+        // Non-blocking sends do not get here, they checked hasTxRoom().
+        _TxSpaceEvent.reset();
+        if (_TxQueue.push(std::move(pOd), &wasEmpty))
+            break;
 
-    while (!_closed) {
-        // wait for completed operation
-        DWORD        numberOfBytesTransferred{0};
-        LPOVERLAPPED pOv     = nullptr;
-        auto         gqcsRes = GetQueuedCompletionStatus(_completionPort,
-                                                 &numberOfBytesTransferred,
-                                                 &completionKey,
-                                                 &pOv,
-                                                 INFINITE);
-        if (pOv == nullptr) {
-            // GetQueuedCompletionStatus failed
-            goto threadExit;
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            _TxSpaceEvent.wait(2000);
         }
-        else if (pOv == &_rxOv) {
-            // receive operation completed
-            GetOverlappedResult(_handle, pOv, &numberOfBytesTransferred, false);
-            auto ovRes = GetLastError();
-            bytesReadTotal += static_cast<size_t>(numberOfBytesTransferred);
-            switch (ovRes) {
-                case ERROR_SUCCESS: { // create new vector, which will be saved
-                                      // in RxQueue
-                    auto rxMessageOut = std::shared_ptr<std::vector<char>>(
-                        new std::vector<char>(BUFSIZE));
-                    rxMessageOut->swap(_RxBuffer);
-                    rxMessageOut->resize(bytesReadTotal);
-
-                    bytesReadTotal = 0; // reset bytesReadTotal
-
-                    // push the new vector to the queue
-                    _RxQueueMutex.lock();
-                    _RxQueue.push(rxMessageOut);
-                    SetEvent(_RxQueueEvent);
-                    _RxQueueMutex.unlock();
-
-                    // reset rxOv and start next receive operation
-                    std::memset(&_rxOv, 0, sizeof(_rxOv));
-                    if (!ReadFile(_handle,
-                                  &_RxBuffer.front(),
-                                  _RxBuffer.size(),
-                                  NULL,
-                                  &_rxOv)) {
-                        auto errNo = GetLastError();
-                        if (errNo != ERROR_IO_PENDING) {
-                            goto threadExit;
-                        }
-                    }
-                    break;
-                }
-                case ERROR_MORE_DATA: {
-                    // check how much data of the message is missing
-                    DWORD bytesLeftThisMessage;
-                    PeekNamedPipe(_handle,
-                                  nullptr,
-                                  0,
-                                  nullptr,
-                                  nullptr,
-                                  &bytesLeftThisMessage);
-
-                    // check if rxBuffer size is sufficient
-                    auto msgSize = bytesReadTotal +
-                                   static_cast<size_t>(bytesLeftThisMessage);
-                    _RxBuffer.resize(msgSize);
-
-                    // Reset OVERLAPPED and read the rest of the message
-                    std::memset(&_rxOv, 0, sizeof(_rxOv));
-                    if (!ReadFile(_handle,
-                                  &_RxBuffer.at(bytesReadTotal),
-                                  bytesLeftThisMessage,
-                                  nullptr,
-                                  &_rxOv)) {
-                        goto threadExit;
-                    }
-                    break;
-                }
-                default: {
-                    goto threadExit;
-                }
-            }
+        if (_closed || _ioErr != 0) [[unlikely]] {
+            _txInflightBytes.fetch_sub(size);
+            if (_closed)
+                throw std::runtime_error("handle is closed");
+            checkIo();
         }
-        else {
-            // send operation completed
-            _TxQueueMutex.lock();
-            auto pOd = std::move(_TxQueue.front());
-            _TxQueue.pop();
-            _TxQueueMutex.unlock();
-
-            if (!GetOverlappedResult(_handle,
-                                     pOv,
-                                     &numberOfBytesTransferred,
-                                     false)) {
-                goto threadExit;
-            }
+    }
+    _txQueued++;
+    _stats.txQueuePeak.observe(_TxQueue.size());
+    return wasEmpty;
+}
+
+auto PipeConnection::pushTxLane(std::shared_ptr<OverlappedData> pOd) -> void
+{
+    // must be called with _txMutex held, like pushTxQueue()
+    releaseCompletedWrites();
+    while (!hasLaneRoom()) {
+        // the lanes are full, wait until the I/O thread completed a write.
+        // Non-blocking sends do not get here, they checked hasLaneRoom().
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            _TxSpaceEvent.wait(2000);
+        }
+        if (_closed) [[unlikely]]
+            throw std::runtime_error("handle is closed");
+        checkIo();
+    }
+
+    pOd->queuedAt = _stats.txSampler.start();
+    _txInflightBytes.fetch_add(pOd->size);
+    _txLaneQueued.fetch_add(1); // before the I/O thread can complete it
+    {
+        std::lock_guard lock(_txLaneMutex);
+        _txLanes[pOd->priority - 1].push_back(std::move(pOd));
+    }
+    notifyTxLanes();
+
+    // Either the I/O thread fails the lanes after the error, or we see it
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_ioErr != 0) [[unlikely]]
+        cleanupAndThrowExc(_ioErr);
+}
+
+auto PipeConnection::popTxLane() -> std::shared_ptr<OverlappedData>
+{
+    // called by the I/O thread, the most important lane comes first
+    std::lock_guard lock(_txLaneMutex);
+    for (auto &lane : _txLanes) {
+        if (!lane.empty()) {
+            auto pOd = std::move(lane.front());
+            lane.pop_front();
+            return pOd;
         }
     }
-threadExit:
-    _threadErr = GetLastError();
-};
+    return nullptr;
+}
+
+auto PipeConnection::failTxLanes(NativeError errNo) -> void
+{
+    // Called by the I/O thread after an error, and by close() after the
+    // I/O thread dropped the connection. Wakes up blocking senders.
+    while (auto pOd = popTxLane()) {
+        pOd->error = errNo;
+        pOd->done.store(true);
+        pOd->done.notify_all();
+        completeWrite(std::move(pOd), false);
+    }
+}
 
-inline auto PipeConnection::checkThread() -> void
+auto PipeConnection::popTxQueue() -> std::shared_ptr<OverlappedData>
 {
-    if (!_started) [[unlikely]]
-        startThread();
-    if (_threadErr != ERROR_SUCCESS) [[unlikely]]
-        cleanupAndThrowExc(_threadErr);
+    // called by the I/O thread
+    std::shared_ptr<OverlappedData> pOd;
+    bool                            wasFull{false};
+    if (_TxQueue.pop(pOd, &wasFull) && wasFull)
+        _TxSpaceEvent.set();
+    return pOd;
 }
 
-auto PipeConnection::cleanupAndThrowExc(DWORD errNo) -> void
+auto PipeConnection::completeWrite(std::shared_ptr<OverlappedData> pOd,
+                                   const bool                      written)
+    -> void
 {
-    close();
-    Win32ErrorExit(errNo);
+    // Called by the I/O thread. Releasing the buffer requires the GIL, so
+    // it is deferred to releaseCompletedWrites().
+    auto inflight = _txInflightBytes.fetch_sub(pOd->size) - pOd->size;
+    bool watched{false};
+    if (written) {
+        countWrite(pOd->size, pOd->queuedAt);
+        // the tickets of writeDone() only count writes of priority 0
+        if (pOd->priority == 0)
+            watched = _txWritten.fetch_add(1) < _txWatched.load();
+    }
+    auto laneWasFull = pOd->priority != 0 &&
+                       _txLaneQueued.fetch_sub(1) == TX_QUEUE_CAPACITY;
+    if (watched || laneWasFull ||
+        (_txThrottled.load() && inflight <= _txLowWatermark.load()))
+        _TxSpaceEvent.set();
+    if (!_TxDoneQueue.push(std::move(pOd))) [[unlikely]] {
+        // unreachable as long as every send releases completed writes first
+        auto gil = nanobind::gil_scoped_acquire();
+        pOd.reset();
+    }
 }
 
-OverlappedData::OverlappedData(const char *pBuffer, const size_t len)
+auto PipeConnection::countWrite(const size_t                 size,
+                                const StatsClock::time_point queuedAt) -> void
 {
-    overlapped = OVERLAPPED{0};
-    vector     = std::vector<char>(pBuffer, pBuffer + len);
-};
+    _stats.txMessages.add();
+    _stats.txBytes.add(size);
+    _stats.txLatency.recordSince(queuedAt);
+}
+
+auto PipeConnection::releaseCompletedWrites() -> void
+{
+    // Must be called with the GIL held. Unpinning a buffer might run Python
+    // code, which calls us again or waits for another thread, so a thread,
+    // which finds the queue being released already, leaves it to the other.
+    std::unique_lock lock(_txDoneMutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return;
+
+    std::shared_ptr<OverlappedData> pOd;
+    while (_TxDoneQueue.pop(pOd))
+        recycleWrite(std::move(pOd));
+}
+
+auto OverlappedData::pin(nanobind::handle            buffer,
+                         const size_t                offset,
+                         const std::optional<size_t> size) -> void
+{
+    view.emplace(buffer.ptr(), PyBUF_SIMPLE);
+    try {
+        this->size = getMessageSize(*view, offset, size);
+    }
+    catch (...) {
+        view.reset();
+        throw;
+    }
+    pData = view->data() + offset;
+#ifdef _WIN32
+    overlapped = {};
+#else
+    bytesSent = 0;
+#endif
+    done.store(false);
+    error    = 0;
+    priority = 0;
+    queuedAt = {};
+}
+
+auto OverlappedData::unpin() -> void
+{
+    view.reset();
+    pData = nullptr;
+}
+
+auto PipeConnection::lockTx() -> std::unique_lock<std::recursive_mutex>
+{
+    // Senders take turns. close() takes the lock too, so no write is queued
+    // after it released the pending ones. The lock is recursive for close()
+    // from a failing sender.
+    auto lock = lockWithoutGil(_txMutex);
+    if (_closed) [[unlikely]]
+        throw std::runtime_error("handle is closed");
+    return lock;
+}
+
+inline auto PipeConnection::checkIo() -> void
+{
+    if (!_started.load(std::memory_order_acquire)) [[unlikely]]
+        startIo();
+    if (_ioErr != 0) [[unlikely]]
+        cleanupAndThrowExc(_ioErr);
+}
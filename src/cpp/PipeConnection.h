@@ -5,29 +5,173 @@
 #ifndef PIPECONNECTION_H
 #define PIPECONNECTION_H
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <sys/uio.h>
+#endif
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <nanobind/nanobind.h>
 #include <optional>
-#include <queue>
+#include <tuple>
 #include <vector>
 
+#include "./Buffer.h"
+#include "./BusyPoll.h"
+#include "./Reactor.h"
+#include "./SharedMemory.h"
+#include "./SpscRing.h"
+#include "./Stats.h"
 #include "./util.h"
 
-const DWORD BUFSIZE{8192};
+// Receive buffers and write states, which are kept for reuse by each
+// connection, see setPoolLimits()
+const size_t RX_POOL_COUNT{16};
+const size_t RX_POOL_BYTES{32 * 1024 * 1024};
+const size_t TX_POOL_COUNT{64};
+
+// Capacity of the lock-free queues between the Python threads and the I/O
+// thread. The I/O thread stops reading, while RxQueue is full, and senders
+// wait, while TxQueue is full.
+const size_t RX_QUEUE_CAPACITY{4096};
+const size_t TX_QUEUE_CAPACITY{4096};
+
+// Priority classes of sendBytes(). Writes of priority 0 are handed to the OS
+// at once. Writes of the lower priorities 1 to TX_PRIORITIES - 1 wait in a
+// lane per priority, from which the I/O thread feeds them, while less than
+// TX_LANE_WINDOW bytes of them are in flight, so a later write of priority
+// 0 overtakes them. A lane holds at most TX_QUEUE_CAPACITY writes.
+const size_t TX_PRIORITIES{4};
+const size_t TX_LANE_WINDOW{256 * 1024};
+
+// Default size of the pipe buffers and of the posted read buffer
+const size_t BUFSIZE{8192};
+
+#ifndef _WIN32
+// SOCK_SEQPACKET records are limited by the socket send buffer, so a message
+// is split into records of at most MAX_RECORD bytes. The first record of each
+// message starts with a MessageHeader, which holds the total message size.
+const size_t MAX_RECORD{65536};
+
+// Number of single-record messages, which are gathered into one sendmmsg()
+const size_t MAX_BATCH{64};
+
+// Number of records, which are read per readiness event, so a busy connection
+// does not starve the other connections of its I/O thread
+const size_t MAX_RX_RECORDS{64};
+
+struct MessageHeader {
+    uint64_t size;
+};
+#endif
 
 class OverlappedData {
   public:
-    OVERLAPPED        overlapped;
-    std::vector<char> vector;
-    OverlappedData(const char *pBuffer, const size_t len);
-    OverlappedData(OverlappedData &&) = default;
+#ifdef _WIN32
+    OVERLAPPED overlapped{};
+#else
+    size_t bytesSent{0}; // including the MessageHeader
+#endif
+    // set by the I/O thread, see error
+    std::atomic<bool> done{false};
+    NativeError       error{0};
+    size_t            priority{0};
+    // pins the caller's buffer until the write has completed
+    std::optional<BufferView> view;
+    const char               *pData{nullptr};
+    size_t                    size{0};
+    StatsClock::time_point    queuedAt{};
+
+    // Resets the state for a new write of the message at `offset` of the
+    // buffer, see getMessageSize(). Like unpin(), it must be called with the
+    // GIL held. The objects are recycled through an ObjectPool.
+    auto pin(nanobind::handle            buffer,
+             const size_t                offset = 0,
+             const std::optional<size_t> size   = {}) -> void;
+    auto unpin() -> void;
 };
 
+// Writes of one priority, which wait for the I/O thread
+using TxLane = std::deque<std::shared_ptr<OverlappedData>>;
+
+// Message in RxQueue, the timestamp measures its residency
+struct RxQueueEntry {
+    std::shared_ptr<MessageBuffer> buffer;
+    StatsClock::time_point         queuedAt{};
+};
+
+// Payload of a received message, either a pipe message or a span of the
+// shared memory ring
+struct RxPayload {
+    std::shared_ptr<MessageBuffer>    buffer;
+    std::shared_ptr<SharedRingReader> ring;
+    SharedRingSpan                    span{};
+
+    auto data() const -> const char *;
+    auto size() const -> size_t;
+};
+
+// Takes messages off the I/O thread, before they are queued in RxQueue, see
+// RpcChannel and PipeDispatcher. Both methods are called by the I/O thread
+// without the GIL.
+class RxRouter {
+  public:
+    virtual ~RxRouter() = default;
+
+    // Returns true, if the message was consumed. A consumed message, which
+    // was left in `message`, goes back to the buffer pool.
+    virtual auto route(std::shared_ptr<MessageBuffer> &message) -> bool = 0;
+
+    // The connection failed with `errNo` or was closed (0)
+    virtual auto fail(NativeError errNo) -> void = 0;
+};
+
+// Raises ValueError for a buffer size of 0
+auto checkBufferSize(size_t bufferSize) -> void;
+
+// Deadline of a wait, an empty timeout never expires
+auto getDeadline(const std::optional<double> timeout)
+    -> std::chrono::steady_clock::time_point;
+
+// Locks the mutex. If it is contended, the GIL is released while waiting,
+// because the holder might be waiting for the GIL itself.
+template <typename Mutex>
+auto lockWithoutGil(Mutex &mutex) -> std::unique_lock<Mutex>
+{
+    std::unique_lock lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        auto nogil = nanobind::gil_scoped_release();
+        lock.lock();
+    }
+    return lock;
+}
+
+// Size of the message at `offset` of the buffer, which is the rest of the
+// buffer for an empty `size`. Raises ValueError, if it exceeds the buffer or
+// the buffer is empty.
+auto getMessageSize(const BufferView           &view,
+                    const size_t                offset,
+                    const std::optional<size_t> size) -> size_t;
+
+// A connection may be used by any number of threads, also without the GIL
+// on free-threaded Python. The senders take turns on _txMutex, so TxQueue
+// keeps a single producer, and the receivers on _rxMutex, so RxQueue keeps
+// a single consumer. A blocking sender waits for its write without the lock.
 class PipeConnection {
   public:
-    PipeConnection(size_t handle, bool readable = true, bool writable = true);
+    // Reads are posted with buffers of `bufferSize` bytes, larger messages
+    // are read in a second step. With `adaptiveBuffer` the size follows the
+    // received messages, see AdaptiveBufferSize.
+    PipeConnection(size_t handle,
+                   bool   readable       = true,
+                   bool   writable       = true,
+                   size_t bufferSize     = BUFSIZE,
+                   bool   adaptiveBuffer = false);
 
     auto getHandle() const -> size_t;
 
@@ -37,40 +181,308 @@ class PipeConnection {
 
     auto getClosed() -> bool;
 
-    auto sendBytes(const nanobind::bytes       buffer,
+    // See TX_PRIORITIES. Writes of the same priority complete in order.
+    auto sendBytes(nanobind::handle            buffer,
                    const size_t                offset   = 0,
                    const std::optional<size_t> size     = {},
-                   const bool                  blocking = true) -> void;
+                   const bool                  blocking = true,
+                   const size_t                priority = 0) -> void;
 
-    auto recvBytes(std::optional<int> maxLength = {},
-                   const bool         blocking  = true)
+    auto sendBytesMany(nanobind::iterable buffers, const bool blocking = true)
+        -> void;
+
+    // `busyPollUs` overrides the setting of the connection for this call
+    auto recvBytes(std::optional<int>            maxLength  = {},
+                   const bool                    blocking   = true,
+                   const std::optional<uint32_t> busyPollUs = {})
         -> std::optional<nanobind::bytes>;
 
+    auto recvBytesMany(const std::optional<size_t> maxCount = {},
+                       const std::optional<double> timeout  = {})
+        -> nanobind::list;
+
+    auto recvBytesInto(nanobind::handle buffer,
+                       const size_t     offset   = 0,
+                       const bool       blocking = true)
+        -> std::optional<size_t>;
+
+    auto recvBytesView(const bool blocking = true)
+        -> std::optional<nanobind::object>;
+
+    // Waits until a message can be received without blocking. An empty
+    // timeout waits forever.
+    auto poll(const std::optional<double> timeout = 0.0) -> bool;
+
+    // True, if receiving would not block: a message is queued, or the
+    // connection failed or was closed and receiving raises
+    auto isReady() -> bool;
+
+    auto getRxBufferAllocations() const -> size_t;
+    auto getTxWriteAllocations() const -> size_t;
+
+    // Limits of the free lists of receive buffers (count and bytes) and of
+    // write states, an empty value keeps the current limit. Lower limits
+    // free memory at once, higher ones let a burst be absorbed without
+    // allocations.
+    auto setPoolLimits(std::optional<size_t> txCount,
+                       std::optional<size_t> rxCount,
+                       std::optional<size_t> rxBytes) -> void;
+    auto getPoolLimits() const -> nanobind::dict;
+
+    auto getBufferSize() const -> size_t;
+    auto getAdaptiveBuffer() const -> bool;
+
+    // size of the read buffer, which is posted next
+    auto getRxBufferSize() const -> size_t;
+
+    // A blocking receive spins for up to `busyPollUs` microseconds with the
+    // GIL released, before it waits for the Rx event, see AdaptiveSpin. This
+    // saves the wake-up of a sleeping thread at the cost of CPU time. 0 (the
+    // default) does not spin.
+    auto setBusyPoll(const uint32_t busyPollUs) -> void;
+    auto getBusyPoll() const -> uint32_t;
+
+    // Backpressure with hysteresis. While `high` bytes of writes are in
+    // flight, senders wait or fail with BlockingIOError, until the I/O thread
+    // completed writes down to `low` bytes. While `high` bytes are queued for
+    // the receiver, the I/O thread stops reading, until the receiver drained
+    // RxQueue down to `low` bytes. An empty `high` removes the limit, `low`
+    // defaults to half of `high`.
+    auto setTxLimit(std::optional<size_t> high, std::optional<size_t> low = {})
+        -> void;
+    auto setRxLimit(std::optional<size_t> high, std::optional<size_t> low = {})
+        -> void;
+    auto getTxLimit() const -> std::optional<size_t>;
+    auto getRxLimit() const -> std::optional<size_t>;
+
+    // current queue depths
+    auto getTxInflightBytes() const -> size_t;
+    auto getTxQueued() const -> size_t;
+    auto getRxQueuedBytes() const -> size_t;
+    auto getRxQueued() const -> size_t;
+
+    // Counters and latency histograms, see ConnectionStats
+    auto getStats() const -> nanobind::dict;
+    auto resetStats() -> void;
+
+    // Support for the coroutines in win32_pipes._asyncio. The event loop
+    // watches the native events, the I/O thread sets them.
+    //
+    // The Rx event is set, while messages are queued or after the connection
+    // failed. The Tx event is set, when TxQueue has room again, the Tx limit
+    // is released or a write completed, which writeDone() is waiting for.
+    auto getRxEventHandle() const -> size_t;
+    auto getTxEventHandle() const -> size_t;
+
+    // Queues the message without waiting. Returns an empty optional, if
+    // TxQueue is full or the Tx limit was reached, otherwise a ticket for
+    // writeDone(). Ticket 0 means the message was sent already.
+    auto sendBytesNowait(nanobind::handle            buffer,
+                         const size_t                offset = 0,
+                         const std::optional<size_t> size   = {})
+        -> std::optional<uint64_t>;
+
+    // Returns true, if the write of `ticket` completed, raises if it failed
+    auto writeDone(const uint64_t ticket) -> bool;
+
+    // Payloads of at least `threshold` bytes are passed through a shared
+    // memory ring, the pipe only carries a SharedRingDescriptor.
+    static auto connectSharedMemory(PipeConnection &reader,
+                                    PipeConnection &writer,
+                                    size_t          size,
+                                    size_t          threshold) -> void;
+
+    auto attachSharedMemory(std::optional<size_t> rxHandle,
+                            std::optional<size_t> txHandle,
+                            size_t                threshold) -> void;
+
+    auto getSharedMemory() const -> std::optional<
+        std::tuple<std::optional<size_t>, std::optional<size_t>, size_t>>;
+
     auto close() -> void;
 
     ~PipeConnection();
 
   private:
-    const HANDLE                                   _handle;
-    const bool                                     _readable;
-    const bool                                     _writable;
-    bool                                           _closed  = false;
-    bool                                           _started = false;
-    HANDLE                                         _completionPort;
-    std::queue<std::shared_ptr<OverlappedData>>    _TxQueue;
-    std::mutex                                     _TxQueueMutex;
-    std::thread                                    _thread;
-    DWORD                                          _threadErr{ERROR_SUCCESS};
-    OVERLAPPED                                     _rxOv{0};
-    std::vector<char>                              _RxBuffer{0};
-    std::queue<std::shared_ptr<std::vector<char>>> _RxQueue;
-    std::mutex                                     _RxQueueMutex;
-    HANDLE _RxQueueEvent{INVALID_HANDLE_VALUE};
-
-    auto              monitorIoCompletion() -> void;
-    inline auto       startThread() -> void;
-    inline auto       checkThread() -> void;
-    [[noreturn]] auto cleanupAndThrowExc(DWORD errNo = 0) -> void;
+    const NativeHandle                        _handle;
+    const bool                                _readable;
+    const bool                                _writable;
+    std::atomic<bool>                         _closed{false};
+    std::atomic<bool>                         _started{false};
+    std::recursive_mutex                      _startMutex; // see startIo()
+    std::recursive_mutex                      _txMutex; // see lockTx()
+    SpscRing<std::shared_ptr<OverlappedData>> _TxQueue{TX_QUEUE_CAPACITY};
+    // pushTxQueue() releases completed writes before every push, the lanes
+    // hold at most as many writes as TxQueue
+    SpscRing<std::shared_ptr<OverlappedData>> _TxDoneQueue{
+        2 * TX_QUEUE_CAPACITY + 1};
+    std::mutex                                _txDoneMutex; // its consumer
+    std::mutex                                _txLaneMutex;
+    std::array<TxLane, TX_PRIORITIES - 1>     _txLanes;
+    std::atomic<size_t>                       _txLaneQueued{0}; // until done
+    Event                                     _TxSpaceEvent;
+    uint64_t                                  _txQueued{0};  // writes ever
+    std::atomic<uint64_t>                     _txWritten{0}; // completed
+    std::atomic<uint64_t>                     _txWatched{0}; // max. ticket
+    std::atomic<size_t>                       _txInflightBytes{0};
+    std::atomic<size_t>                       _txHighWatermark{0}; // 0: none
+    std::atomic<size_t>                       _txLowWatermark{0};
+    std::atomic<bool>                         _txThrottled{false};
+    ReactorWorker                            *_worker{nullptr};
+    std::atomic<NativeError>                  _ioErr{0};
+    const size_t                              _bufferSize;
+    std::optional<AdaptiveBufferSize>         _rxAdaptive;
+    std::atomic<size_t>                       _rxBufferSize;
+    MessageBuffer                             _RxBuffer;
+    SpscRing<RxQueueEntry>                    _RxQueue{RX_QUEUE_CAPACITY};
+    std::recursive_timed_mutex                _rxMutex; // see lockRx()
+    std::shared_ptr<MessageBuffer>            _rxPending; // RxQueue was full
+    Event                                     _RxQueueEvent;
+    std::atomic<size_t>                       _rxQueuedBytes{0};
+    std::atomic<size_t>                       _rxHighWatermark{0}; // 0: none
+    std::atomic<size_t>                       _rxLowWatermark{0};
+    std::atomic<bool> _rxThrottled{false}; // I/O thread stopped reading
+    std::mutex        _resumeMutex; // see close()
+    BufferPool _RxPool{RX_POOL_COUNT, RX_POOL_BYTES};
+    ObjectPool<OverlappedData>        _TxPool{TX_POOL_COUNT};
+    std::shared_ptr<SharedRingReader> _rxRing;
+    std::shared_ptr<SharedRingWriter> _txRing;
+    size_t                            _ringThreshold{0};
+    std::atomic<uint32_t>             _busyPollUs{0};
+    AdaptiveSpin                      _rxSpin; // used with _rxMutex held
+    ConnectionStats                   _stats;
+    // the owner keeps the router alive for the I/O thread, _rxRouting
+    // counts the threads, which might use it, see clearRxRouter()
+    std::mutex                _rxRouterMutex;
+    std::shared_ptr<RxRouter> _rxRouterOwner;
+    std::atomic<RxRouter *>   _rxRouter{nullptr};
+    std::atomic<uint32_t>     _rxRouting{0};
+#ifdef _WIN32
+    // set in _pendingIo by close(), which waits for the outstanding completions
+    static const uint32_t IO_CLOSING{0x80000000};
+
+    OVERLAPPED            _rxOv{0};
+    OVERLAPPED            _resumeOv{0}; // posted when RxQueue is no longer full
+    OVERLAPPED            _txFeedOv{0}; // posted when a lane write is queued
+    std::atomic<bool>     _txFeedPending{false};
+    TxLane                _txLanePosted;      // lane writes in flight
+    size_t                _txLaneInflight{0}; // bytes of _txLanePosted
+    size_t                _rxBytesReceived{0};
+    bool                  _rxPaused{false}; // no read is pending
+    std::atomic<uint32_t> _pendingIo{0}; // operations, which will complete
+    Event                 _ioIdleEvent;
+
+    auto startRead(const size_t offset, const size_t size) -> NativeError;
+    auto completeRead(DWORD numberOfBytesTransferred, NativeError errNo)
+        -> NativeError;
+    auto startWrite(OverlappedData &od) -> void;
+    auto feedTxLanes() -> NativeError;
+    auto acquireIo() -> void;
+    auto releaseIo() -> void;
+    auto handleCompletion(OVERLAPPED *pOv,
+                          DWORD       numberOfBytesTransferred,
+                          NativeError errNo) -> void;
+#else
+    std::atomic<bool> _wakePending{false};
+    bool              _txArmed{false};
+    bool              _rxArmed{false};
+    std::vector<char> _RxOverflow;
+    // lane write, which is partially sent. Its records must not be
+    // interleaved with those of other messages.
+    std::shared_ptr<OverlappedData> _txLaneCurrent;
+    size_t            _rxMessageSize{0};
+    size_t            _rxBytesReceived{0};
+
+    auto sendRecords(const char  *pData,
+                     const size_t size,
+                     size_t      &bytesSent) -> NativeError;
+    auto queueWrite(std::shared_ptr<OverlappedData> pOd,
+                    const StatsClock::time_point    queuedAt) -> void;
+    auto sendMessages(const iovec *messages,
+                      const size_t count,
+                      size_t      &messagesSent) -> NativeError;
+    auto flushTxQueue() -> NativeError;
+    auto failTxQueue(NativeError errNo) -> void;
+    auto updateEpoll(bool rxArmed, bool txArmed) -> void;
+    auto receiveRecords() -> NativeError;
+    auto completeRxMessage() -> bool;
+    auto wake() -> void;
+    auto handleEvents(uint32_t events) -> void;
+    auto handleWakeup() -> void;
+#endif
+
+    // called by the ReactorWorker, which serves this connection
+    friend class ReactorWorker;
+    // installs its router and receives the requests of the peer
+    friend class RpcChannel;
+    // installs a router per worker and checks for shared memory
+    friend class PipeDispatcher;
+    auto setRxRouter(std::shared_ptr<RxRouter> router) -> void;
+    // Removes `router`, if it is still installed. Returns after the other
+    // threads stopped using it.
+    auto clearRxRouter(const RxRouter *router) -> void;
+    auto routeRxMessage(std::shared_ptr<MessageBuffer> &message) -> bool;
+    auto failRxRouter(NativeError errNo) -> void;
+    auto registerIo(ReactorWorker &worker) -> void;
+    auto unregisterIo() -> void;
+    auto failIo(NativeError errNo) -> void;
+
+    auto              startIo() -> void;
+    inline auto       checkIo() -> void;
+    auto              lockTx() -> std::unique_lock<std::recursive_mutex>;
+    auto lockRx(const bool                                  blocking,
+                const std::chrono::steady_clock::time_point deadline)
+        -> std::unique_lock<std::recursive_timed_mutex>;
+    auto popRxMessage(const bool blocking,
+                      const std::chrono::steady_clock::time_point deadline =
+                          std::chrono::steady_clock::time_point::max(),
+                      const std::optional<uint32_t> busyPollUs = {})
+        -> std::shared_ptr<MessageBuffer>;
+    auto popRxPayload(const bool blocking,
+                      const std::chrono::steady_clock::time_point deadline =
+                          std::chrono::steady_clock::time_point::max(),
+                      const std::optional<uint32_t> busyPollUs = {})
+        -> std::optional<RxPayload>;
+    auto releaseRxPayload(RxPayload &payload) -> void;
+    auto              tryPopRxMessage(std::shared_ptr<MessageBuffer> &rxMessage)
+        -> bool;
+    auto              pushRxMessage(std::shared_ptr<MessageBuffer> rxMessage)
+        -> bool;
+    auto              resumeRx() -> void;
+    auto nextRxBufferSize(const size_t messageSize) -> size_t;
+    auto acquireWrite(nanobind::handle            buffer,
+                      const size_t                offset = 0,
+                      const std::optional<size_t> size   = {})
+        -> std::shared_ptr<OverlappedData>;
+    auto recycleWrite(std::shared_ptr<OverlappedData> pOd) -> void;
+    // The write functions are called with _txMutex held. They return the
+    // write, which a blocking sender waits for, or nullptr, if the message
+    // was sent already.
+    auto writeMessage(std::shared_ptr<OverlappedData> pOd)
+        -> std::shared_ptr<OverlappedData>;
+    auto writeDescriptor(const SharedRingDescriptor &descriptor)
+        -> std::shared_ptr<OverlappedData>;
+    auto writeBytes(std::shared_ptr<OverlappedData> pOd)
+        -> std::shared_ptr<OverlappedData>;
+    auto writeBytesMany(std::vector<std::shared_ptr<OverlappedData>> writes)
+        -> std::shared_ptr<OverlappedData>;
+    auto              waitForWrite(std::shared_ptr<OverlappedData> pOd) -> void;
+    auto              waitForTxCredit(const bool wait) -> bool;
+    auto              hasTxRoom(const size_t messages) -> bool;
+    auto              hasLaneRoom() -> bool;
+    auto pushTxQueue(std::shared_ptr<OverlappedData> pOd,
+                     const StatsClock::time_point    queuedAt) -> bool;
+    auto              pushTxLane(std::shared_ptr<OverlappedData> pOd) -> void;
+    auto              popTxLane() -> std::shared_ptr<OverlappedData>;
+    auto              failTxLanes(NativeError errNo) -> void;
+    auto              notifyTxLanes() -> void;
+    auto              popTxQueue() -> std::shared_ptr<OverlappedData>;
+    auto completeWrite(std::shared_ptr<OverlappedData> pOd,
+                       const bool                      written = true) -> void;
+    auto              releaseCompletedWrites() -> void;
+    auto countWrite(const size_t size, const StatsClock::time_point queuedAt)
+        -> void;
+    [[noreturn]] auto cleanupAndThrowExc(NativeError errNo = 0) -> void;
 };
 
 #endif
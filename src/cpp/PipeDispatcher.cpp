@@ -0,0 +1,411 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./PipeDispatcher.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+DispatchQueue::DispatchQueue(size_t workers, DispatchPolicy policy)
+    : _policy{policy},
+      _workers(workers),
+      _active{workers}
+{
+}
+
+auto DispatchQueue::getLoad(const Worker &worker) const -> size_t
+{
+    if (_policy == DispatchPolicy::LeastBytes)
+        return worker.stats.outstandingBytes;
+    return worker.stats.outstanding;
+}
+
+auto DispatchQueue::assign(uint64_t                 id,
+                           size_t                   size,
+                           const std::vector<bool> &busy)
+    -> std::optional<size_t>
+{
+    std::lock_guard lock(_mutex);
+    if (_closed)
+        throw std::runtime_error("dispatcher is closed");
+    if (_active == 0)
+        throw std::runtime_error("no worker available");
+
+    // the search starts behind the last choice, so equal loads take turns
+    auto   count = _workers.size();
+    size_t best  = count;
+    for (size_t i = 0; i < count; i++) {
+        auto  index  = (_next + i) % count;
+        auto &worker = _workers[index];
+        if (worker.stats.failed || busy[index])
+            continue;
+        if (best == count || getLoad(worker) < getLoad(_workers[best]))
+            best = index;
+        if (_policy == DispatchPolicy::RoundRobin || getLoad(worker) == 0)
+            break;
+    }
+    if (best == count)
+        return {};
+    _next = (best + 1) % count;
+
+    auto &worker = _workers[best];
+    worker.tasks.push_back({id, size});
+    worker.stats.submitted++;
+    worker.stats.outstanding++;
+    worker.stats.outstandingBytes += size;
+    return best;
+}
+
+auto DispatchQueue::cancel(size_t worker, uint64_t id) -> void
+{
+    std::lock_guard lock(_mutex);
+    auto           &w = _workers[worker];
+    if (!w.tasks.empty() && w.tasks.back().id == id) {
+        w.stats.submitted--;
+        w.stats.outstanding--;
+        w.stats.outstandingBytes -= w.tasks.back().size;
+        w.tasks.pop_back();
+        return;
+    }
+
+    // the worker failed in the meantime, the caller raises instead
+    auto it = std::find_if(_results.rbegin(),
+                           _results.rend(),
+                           [id](auto &result) { return result.id == id; });
+    if (it != _results.rend())
+        _results.erase(std::next(it).base());
+}
+
+auto DispatchQueue::route(size_t                          worker,
+                          std::shared_ptr<MessageBuffer> &message) -> bool
+{
+    std::lock_guard lock(_mutex);
+    auto           &w = _workers[worker];
+    if (_closed || w.tasks.empty())
+        return false; // not a result, queued like any other message
+
+    auto task = w.tasks.front();
+    w.tasks.pop_front();
+    w.stats.completed++;
+    w.stats.outstanding--;
+    w.stats.outstandingBytes -= task.size;
+
+    // only the first result wakes up a receiver, see take()
+    if (_results.empty())
+        _cv.notify_one();
+    _results.push_back({task.id, worker, std::move(message)});
+    return true;
+}
+
+auto DispatchQueue::fail(size_t worker) -> void
+{
+    std::lock_guard lock(_mutex);
+    auto           &w = _workers[worker];
+    if (w.stats.failed)
+        return;
+    w.stats.failed = true;
+    _active--;
+
+    // the outstanding tasks of the worker complete without a result
+    for (auto &task : w.tasks)
+        _results.push_back({task.id, worker, nullptr});
+    w.tasks.clear();
+    w.stats.outstanding      = 0;
+    w.stats.outstandingBytes = 0;
+
+    // the receivers also learn, if there is no worker left
+    _cv.notify_all();
+}
+
+auto DispatchQueue::take(size_t                                maxCount,
+                         std::chrono::steady_clock::time_point deadline)
+    -> std::vector<DispatchResult>
+{
+    std::unique_lock lock(_mutex);
+    auto             ready = [this] {
+        return !_results.empty() || _closed || _active == 0;
+    };
+    if (deadline == std::chrono::steady_clock::time_point::max())
+        _cv.wait(lock, ready);
+    else if (!_cv.wait_until(lock, deadline, ready))
+        return {};
+
+    if (_closed)
+        throw std::runtime_error("dispatcher is closed");
+    if (_results.empty())
+        throw std::runtime_error("no worker available");
+
+    auto count = std::min(maxCount, _results.size());
+    std::vector<DispatchResult> results;
+    results.reserve(count);
+    std::move(_results.begin(),
+              _results.begin() + count,
+              std::back_inserter(results));
+    _results.erase(_results.begin(), _results.begin() + count);
+
+    // route() wakes up a single receiver, it passes on the rest
+    if (!_results.empty())
+        _cv.notify_one();
+    return results;
+}
+
+auto DispatchQueue::close() -> void
+{
+    {
+        std::lock_guard lock(_mutex);
+        _closed = true;
+        _results.clear();
+    }
+    _cv.notify_all();
+}
+
+auto DispatchQueue::getOutstanding() const -> size_t
+{
+    std::lock_guard lock(_mutex);
+    size_t          outstanding{0};
+    for (auto &worker : _workers)
+        outstanding += worker.stats.outstanding;
+    return outstanding;
+}
+
+auto DispatchQueue::getWorkerStats() const -> std::vector<DispatchWorkerStats>
+{
+    std::lock_guard                  lock(_mutex);
+    std::vector<DispatchWorkerStats> stats;
+    stats.reserve(_workers.size());
+    for (auto &worker : _workers)
+        stats.push_back(worker.stats);
+    return stats;
+}
+
+DispatchRouter::DispatchRouter(std::shared_ptr<DispatchQueue> queue,
+                               size_t                         worker)
+    : _queue{std::move(queue)},
+      _worker{worker}
+{
+}
+
+auto DispatchRouter::route(std::shared_ptr<MessageBuffer> &message) -> bool
+{
+    return _queue->route(_worker, message);
+}
+
+auto DispatchRouter::fail(NativeError) -> void
+{
+    // the error is seen by the receivers of the worker connection
+    _queue->fail(_worker);
+}
+
+static auto parsePolicy(const std::string &policy) -> DispatchPolicy
+{
+    if (policy == "round_robin")
+        return DispatchPolicy::RoundRobin;
+    if (policy == "least_outstanding")
+        return DispatchPolicy::LeastOutstanding;
+    if (policy == "least_bytes")
+        return DispatchPolicy::LeastBytes;
+    throw nanobind::value_error(
+        "policy must be 'round_robin', 'least_outstanding' or 'least_bytes'");
+}
+
+PipeDispatcher::PipeDispatcher(nanobind::iterable workers,
+                               const std::string &policy)
+    : _policy{parsePolicy(policy)}
+{
+    // all workers are checked, before any router is installed
+    for (auto worker : workers) {
+        if (!nanobind::isinstance<PipeConnection>(worker))
+            throw nanobind::type_error("expected a PipeConnection");
+        auto pc = nanobind::cast<PipeConnection *>(worker);
+        if (!pc->getReadable() || !pc->getWritable())
+            throw nanobind::value_error("a worker needs a duplex connection");
+        if (pc->_rxRing || pc->_txRing)
+            throw nanobind::value_error(
+                "a dispatcher does not support shared memory");
+        if (pc->_rxRouter.load() != nullptr)
+            throw nanobind::value_error(
+                "connection is used by an RPC channel or dispatcher already");
+        if (pc->getClosed())
+            throw std::runtime_error("handle is closed");
+        for (auto &other : _workers)
+            if (other.connection == pc)
+                throw nanobind::value_error("connection is a worker already");
+        _workers.push_back({nanobind::borrow(worker), pc});
+    }
+    if (_workers.empty())
+        throw nanobind::value_error("a dispatcher needs at least one worker");
+
+    _queue = std::make_shared<DispatchQueue>(_workers.size(), _policy);
+    for (size_t i = 0; i < _workers.size(); i++) {
+        auto router = std::make_shared<DispatchRouter>(_queue, i);
+        try {
+            _workers[i].connection->setRxRouter(router);
+        }
+        catch (...) {
+            // another thread installed a router in the meantime
+            close();
+            throw;
+        }
+        _workers[i].router = router.get();
+    }
+}
+
+PipeDispatcher::~PipeDispatcher() { close(); }
+
+[[noreturn]] static auto raiseAllBusy() -> void
+{
+    PyErr_SetString(PyExc_BlockingIOError, "all workers are busy");
+    throw nanobind::python_error();
+}
+
+auto PipeDispatcher::submitLocked(nanobind::handle buffer)
+    -> std::optional<uint64_t>
+{
+    size_t size;
+    {
+        auto view = BufferView(buffer.ptr(), PyBUF_SIMPLE);
+        size      = view.size();
+    }
+
+    // A worker is busy, while its send queue or its Tx limit is full. The
+    // task goes to the best of the others then, it never waits for one.
+    std::vector<bool> busy(_workers.size(), false);
+    for (;;) {
+        // the task must be assigned before its result can arrive
+        auto id     = _nextId;
+        auto worker = _queue->assign(id, size, busy);
+        if (!worker.has_value())
+            return {};
+        try {
+            _workers[*worker].connection->sendBytes(buffer, 0, {}, false);
+            _nextId++;
+            return id;
+        }
+        catch (const nanobind::python_error &e) {
+            _queue->cancel(*worker, id);
+            if (!e.matches(PyExc_BlockingIOError))
+                throw;
+            busy[*worker] = true;
+        }
+        catch (...) {
+            _queue->cancel(*worker, id);
+            throw;
+        }
+    }
+}
+
+auto PipeDispatcher::submit(nanobind::handle buffer) -> uint64_t
+{
+    auto lock = lockWithoutGil(_submitMutex);
+    auto id   = submitLocked(buffer);
+    if (!id.has_value())
+        raiseAllBusy();
+    return *id;
+}
+
+auto PipeDispatcher::submitMany(nanobind::iterable buffers)
+    -> std::vector<uint64_t>
+{
+    // the iteration might run Python code, so it is done without the lock
+    std::vector<nanobind::object> tasks;
+    for (auto buffer : buffers)
+        tasks.push_back(nanobind::borrow(buffer));
+
+    std::vector<uint64_t> ids;
+    ids.reserve(tasks.size());
+    auto lock = lockWithoutGil(_submitMutex);
+    for (auto &task : tasks) {
+        auto id = submitLocked(task);
+        if (!id.has_value())
+            break;
+        ids.push_back(*id);
+    }
+    if (ids.empty() && !tasks.empty())
+        raiseAllBusy();
+    return ids;
+}
+
+auto PipeDispatcher::recvResults(const std::optional<size_t> maxCount,
+                                 const std::optional<double> timeout)
+    -> nanobind::list
+{
+    if (maxCount.has_value() && maxCount.value() == 0)
+        throw nanobind::value_error("max_count must be greater than 0");
+
+    std::vector<DispatchResult> results;
+    {
+        auto nogil = nanobind::gil_scoped_release();
+        results    = _queue->take(maxCount.value_or(SIZE_MAX),
+                                  getDeadline(timeout));
+    }
+
+    nanobind::list list;
+    for (auto &result : results) {
+        if (!result.message) {
+            list.append(nanobind::make_tuple(result.id, nanobind::none()));
+            continue;
+        }
+        auto &message = *result.message;
+        auto  payload = nanobind::bytes(message.data(), message.size());
+        list.append(nanobind::make_tuple(result.id, payload));
+        _workers[result.worker].connection->_RxPool.release(
+            std::move(result.message));
+    }
+    return list;
+}
+
+auto PipeDispatcher::close() -> void
+{
+    _queue->close();
+    for (auto &worker : _workers) {
+        if (worker.router != nullptr)
+            worker.connection->clearRxRouter(worker.router);
+    }
+}
+
+auto PipeDispatcher::getWorkers() const -> nanobind::list
+{
+    nanobind::list workers;
+    for (auto &worker : _workers)
+        workers.append(worker.object);
+    return workers;
+}
+
+auto PipeDispatcher::getPolicy() const -> std::string
+{
+    switch (_policy) {
+        case DispatchPolicy::RoundRobin:
+            return "round_robin";
+        case DispatchPolicy::LeastBytes:
+            return "least_bytes";
+        default:
+            return "least_outstanding";
+    }
+}
+
+auto PipeDispatcher::getOutstanding() const -> size_t
+{
+    return _queue->getOutstanding();
+}
+
+auto PipeDispatcher::getStats() const -> nanobind::list
+{
+    nanobind::list stats;
+    auto           workerStats = _queue->getWorkerStats();
+    for (size_t i = 0; i < _workers.size(); i++) {
+        auto &ws = workerStats[i];
+
+        nanobind::dict entry;
+        entry["connection"]        = _workers[i].object;
+        entry["state"]             = ws.failed ? "failed" : "active";
+        entry["submitted"]         = ws.submitted;
+        entry["completed"]         = ws.completed;
+        entry["outstanding"]       = ws.outstanding;
+        entry["outstanding_bytes"] = ws.outstandingBytes;
+        stats.append(entry);
+    }
+    return stats;
+}
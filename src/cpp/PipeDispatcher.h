@@ -0,0 +1,165 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef PIPEDISPATCHER_H
+#define PIPEDISPATCHER_H
+
+#include "./PipeConnection.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <nanobind/nanobind.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+// How PipeDispatcher chooses the worker of a task
+enum class DispatchPolicy {
+    RoundRobin,       // "round_robin"
+    LeastOutstanding, // "least_outstanding": fewest tasks without result
+    LeastBytes,       // "least_bytes": fewest task bytes without result
+};
+
+// Result of a task, `message` is empty, if its worker failed
+struct DispatchResult {
+    uint64_t                       id;
+    size_t                         worker;
+    std::shared_ptr<MessageBuffer> message;
+};
+
+// Load of a worker, as seen by the dispatcher
+struct DispatchWorkerStats {
+    bool     failed{false};
+    uint64_t submitted{0};
+    uint64_t completed{0};
+    size_t   outstanding{0};
+    size_t   outstandingBytes{0};
+};
+
+// Tasks of the workers of a PipeDispatcher. A worker sends one message per
+// task and in order, so the I/O thread pairs every message with the oldest
+// task of its worker and moves it into the merged result queue.
+class DispatchQueue {
+  public:
+    DispatchQueue(size_t workers, DispatchPolicy policy);
+
+    // Chooses the worker for a task of `size` bytes among those, which are
+    // not `busy`, and returns its index, nothing if all of them are busy.
+    // Raises, if the dispatcher is closed or all workers failed.
+    auto assign(uint64_t id, size_t size, const std::vector<bool> &busy)
+        -> std::optional<size_t>;
+    // Withdraws the task, which was just assigned, its message was not sent
+    auto cancel(size_t worker, uint64_t id) -> void;
+
+    // called by the I/O thread of the worker
+    auto route(size_t worker, std::shared_ptr<MessageBuffer> &message)
+        -> bool;
+    auto fail(size_t worker) -> void;
+
+    // Waits until a result is available and returns up to `maxCount` of
+    // them, nothing on timeout. Called without the GIL.
+    auto take(size_t maxCount, std::chrono::steady_clock::time_point deadline)
+        -> std::vector<DispatchResult>;
+
+    // Results of tasks, which are still outstanding, are dropped
+    auto close() -> void;
+    auto getOutstanding() const -> size_t;
+    auto getWorkerStats() const -> std::vector<DispatchWorkerStats>;
+
+  private:
+    struct Task {
+        uint64_t id;
+        size_t   size;
+    };
+
+    struct Worker {
+        std::deque<Task>    tasks; // in the order of their messages
+        DispatchWorkerStats stats;
+    };
+
+    const DispatchPolicy       _policy;
+    mutable std::mutex         _mutex;
+    std::condition_variable    _cv;
+    std::vector<Worker>        _workers;
+    std::deque<DispatchResult> _results;
+    size_t                     _next{0}; // first candidate of assign()
+    size_t                     _active;  // workers, which did not fail
+    bool                       _closed{false};
+
+    auto getLoad(const Worker &worker) const -> size_t;
+};
+
+// Hands the messages of one worker connection to its DispatchQueue
+class DispatchRouter : public RxRouter {
+  public:
+    DispatchRouter(std::shared_ptr<DispatchQueue> queue, size_t worker);
+
+    auto route(std::shared_ptr<MessageBuffer> &message) -> bool override;
+    auto fail(NativeError errNo) -> void override;
+
+  private:
+    std::shared_ptr<DispatchQueue> _queue;
+    const size_t                   _worker;
+};
+
+// Distributes tasks over worker connections and merges their results. Every
+// task is sent to the worker chosen by the policy without waiting, and the
+// worker must answer it with exactly one message. Completions are observed
+// on the I/O threads, so the loads are current without any Python code. Any
+// number of threads may submit tasks and receive results.
+class PipeDispatcher {
+  public:
+    PipeDispatcher(nanobind::iterable workers,
+                   const std::string &policy = "least_outstanding");
+    ~PipeDispatcher();
+
+    // Sends the task like send_bytes(buffer, blocking=False) and returns
+    // its ID. A worker, whose send raises BlockingIOError, is busy and the
+    // next one is tried. Raises BlockingIOError, if all workers are busy.
+    auto submit(nanobind::handle buffer) -> uint64_t;
+    // Returns the IDs of the tasks, which were submitted, fewer than
+    // `buffers` if all workers became busy. Raises like submit(), if not
+    // even the first task was submitted.
+    auto submitMany(nanobind::iterable buffers) -> std::vector<uint64_t>;
+
+    // Returns (ID, result) tuples in the order of their arrival, the result
+    // of a task of a failed worker is None. Waits until at least one result
+    // is available, an empty list means the timeout expired.
+    auto recvResults(const std::optional<size_t> maxCount = {},
+                     const std::optional<double> timeout  = {})
+        -> nanobind::list;
+
+    // Stops routing and releases the workers, later messages of the workers
+    // are queued like plain messages
+    auto close() -> void;
+
+    auto getWorkers() const -> nanobind::list;
+    auto getPolicy() const -> std::string;
+    auto getOutstanding() const -> size_t;
+
+    // One dict per worker with its state ("active" or "failed") and its
+    // submitted, completed and outstanding tasks and bytes
+    auto getStats() const -> nanobind::list;
+
+  private:
+    struct Worker {
+        nanobind::object object; // keeps the connection alive
+        PipeConnection  *connection;
+        const RxRouter  *router{nullptr}; // installed by us
+    };
+
+    DispatchPolicy                 _policy;
+    std::vector<Worker>            _workers;
+    std::shared_ptr<DispatchQueue> _queue;
+    std::mutex _submitMutex; // keeps the tasks of a worker in order
+    uint64_t   _nextId{1};   // used with _submitMutex held
+
+    // returns nothing, if all workers are busy
+    auto submitLocked(nanobind::handle buffer) -> std::optional<uint64_t>;
+};
+
+#endif
@@ -6,28 +6,82 @@
 #define PIPELISTENER_H
 
 #include "./PipeConnection.h"
-#include "Windows.h"
+#include "./util.h"
+#include <atomic>
+#include <deque>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <vector>
+
+#ifdef _WIN32
+// Number of pipe instances, which wait for clients, if no backlog is given
+const size_t DEFAULT_BACKLOG{16};
+
+// Pipe instance with a pending ConnectNamedPipe()
+struct PendingInstance {
+    HANDLE     handle{INVALID_HANDLE_VALUE};
+    OVERLAPPED overlapped{};
+    bool       connected{false};
+};
+#endif
 
 class PipeListener {
   private:
-    std::string        _address;
-    std::queue<HANDLE> _handleQueue{};
-    std::mutex         _handleQueueMutex{};
-    bool               _closed{false};
-    HANDLE             _closeEvent{};
+    std::string       _address;
+    size_t            _bufferSize;
+    bool              _adaptiveBuffer;
+    std::atomic<bool> _closed{false};
+    Event             _closeEvent{};
+#ifdef _WIN32
+    // All instances signal the same event, accept() checks which completed
+    std::vector<PendingInstance> _instances{};
+    std::deque<HANDLE>           _readyQueue{}; // connected instances
+    std::mutex                   _mutex{};
+    Event                        _connectEvent{};
+
+    auto postConnect(PendingInstance &instance, bool first = false)
+        -> NativeError;
+    auto collectConnected() -> NativeError;
+#else
+    // close() leaves the socket to the last thread, which uses it, so no
+    // thread polls a descriptor, which was closed and reused
+    int        _handle{-1};
+    std::mutex _mutex{};
+    size_t     _handleUsers{0};
 
-    auto              newHandle(bool first) -> HANDLE;
-    [[noreturn]] auto cleanupAndThrowExc(DWORD errNo = 0) -> void;
+    auto acquireHandle() -> int;
+    auto releaseHandle() -> void;
+#endif
+
+    [[noreturn]] auto cleanupAndThrowExc(NativeError errNo = 0) -> void;
 
   public:
-    PipeListener(std::string address, std::optional<size_t> backlog = {});
+    // `bufferSize` and `adaptiveBuffer` apply to the accepted connections,
+    // on Windows `bufferSize` also sets the quotas of the pipe instances
+    PipeListener(std::string           address,
+                 std::optional<size_t> backlog        = {},
+                 size_t                bufferSize     = BUFSIZE,
+                 bool                  adaptiveBuffer = false);
     ~PipeListener();
     auto accept() -> PipeConnection *;
+
+    // Waits until at least one client connected or the timeout expired and
+    // returns up to `maxCount` connections
+    auto acceptMany(const size_t                maxCount,
+                    const std::optional<double> timeout = {})
+        -> std::vector<PipeConnection *>;
     auto close() -> void;
     auto getAddress() -> std::string;
+
+    // Native handles, which an event loop watches for accept_async(). One of
+    // them is signalled, when a client connected or the listener was closed.
+    // Raises, if the listener is closed already.
+    auto getWaitHandles() const -> std::vector<size_t>;
+
+    // True, if accept() would not block: a client is waiting, or the
+    // listener was closed and accept() raises
+    auto isReady() -> bool;
 };
 
 #endif
@@ -0,0 +1,66 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./Reactor.h"
+#include <algorithm>
+#include <nanobind/nanobind.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+static Reactor *reactorInstance{nullptr};
+static std::once_flag reactorOnce;
+
+Reactor::Reactor()
+    : _threadCount{std::clamp<size_t>(std::thread::hardware_concurrency(),
+                                      1,
+                                      MAX_DEFAULT_REACTOR_THREADS)}
+{
+}
+
+auto Reactor::instance() -> Reactor &
+{
+    std::call_once(reactorOnce, [] {
+#ifndef _WIN32
+        // The I/O threads do not survive fork(), so the child starts with a
+        // new reactor. The old one is leaked, its locks might be held.
+        pthread_atfork(nullptr, nullptr, [] {
+            reactorInstance = new Reactor();
+        });
+#endif
+        reactorInstance = new Reactor();
+    });
+    // never destroyed, the I/O threads run until the process exits
+    return *reactorInstance;
+}
+
+auto Reactor::assign() -> ReactorWorker &
+{
+    std::scoped_lock lock(_mutex);
+    while (_workers.size() < _threadCount)
+        _workers.push_back(std::make_unique<ReactorWorker>());
+
+    auto worker = std::min_element(
+        _workers.begin(),
+        _workers.begin() + static_cast<ptrdiff_t>(_threadCount),
+        [](const auto &a, const auto &b) {
+            return a->getConnectionCount() < b->getConnectionCount();
+        });
+    return **worker;
+}
+
+auto Reactor::setThreadCount(size_t count) -> void
+{
+    if (count == 0)
+        throw nanobind::value_error("count must be greater than 0");
+
+    std::scoped_lock lock(_mutex);
+    _threadCount = count;
+}
+
+auto Reactor::getThreadCount() -> size_t
+{
+    std::scoped_lock lock(_mutex);
+    return _threadCount;
+}
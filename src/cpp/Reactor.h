@@ -0,0 +1,98 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/types.h>
+#endif
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "./util.h"
+
+class PipeConnection;
+
+// Upper limit of the default number of reactor threads
+const size_t MAX_DEFAULT_REACTOR_THREADS{8};
+
+// I/O thread of the reactor, which waits on its own completion port (Windows)
+// or epoll instance (POSIX). A connection is served by the same worker for its
+// whole lifetime, so its I/O state is only ever touched by a single thread.
+class ReactorWorker {
+  public:
+    ReactorWorker();
+    ReactorWorker(const ReactorWorker &)                     = delete;
+    auto operator=(const ReactorWorker &) -> ReactorWorker & = delete;
+
+    // Registers the connection's handle. The I/O thread calls back into the
+    // connection until remove() returned.
+    auto add(PipeConnection &connection) -> void;
+
+    // Blocks until the I/O thread dropped the connection
+    auto remove(PipeConnection &connection) -> void;
+
+    auto getConnectionCount() const -> size_t;
+
+#ifdef _WIN32
+    auto getCompletionPort() const -> HANDLE;
+#else
+    auto getEpollFd() const -> int;
+
+    // Lets the I/O thread call PipeConnection::handleWakeup(). Wake-ups of
+    // the same connection are coalesced by the caller.
+    auto wake(PipeConnection &connection) -> void;
+#endif
+
+  private:
+    std::atomic<size_t> _connections{0};
+#ifdef _WIN32
+    HANDLE _completionPort;
+#else
+    using Removal = std::pair<PipeConnection *, std::promise<void>>;
+
+    pid_t                         _pid; // the thread is lost on fork()
+    int                           _epollFd;
+    Event                         _wakeEvent;
+    std::mutex                    _mutex;
+    std::vector<PipeConnection *> _wakeups;
+    std::vector<Removal>          _removals;
+
+    auto processRequests() -> void;
+#endif
+
+    auto run() -> void;
+};
+
+// Process-wide pool of I/O threads, which all connections register with
+// instead of starting a thread each. Workers are started on demand.
+class Reactor {
+  public:
+    static auto instance() -> Reactor &;
+
+    // Assigns the least loaded worker to a new connection
+    auto assign() -> ReactorWorker &;
+
+    // Only affects connections, which start their I/O afterwards
+    auto setThreadCount(size_t count) -> void;
+    auto getThreadCount() -> size_t;
+
+  private:
+    Reactor();
+
+    std::mutex                                  _mutex;
+    size_t                                      _threadCount;
+    std::vector<std::unique_ptr<ReactorWorker>> _workers;
+};
+
+#endif
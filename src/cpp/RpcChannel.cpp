@@ -0,0 +1,328 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./RpcChannel.h"
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+auto RpcRouter::route(std::shared_ptr<MessageBuffer> &message) -> bool
+{
+    // called by the I/O thread for every received message
+    RpcHeader header;
+    if (message->size() < sizeof(header))
+        return false;
+    std::memcpy(&header, message->data(), sizeof(header));
+    if (header.magic != RpcHeader::MAGIC || header.kind != RpcHeader::REPLY)
+        return false;
+
+    std::lock_guard lock(_mutex);
+    auto            it = _slots.find(header.id);
+    if (it == _slots.end() || it->second->done)
+        return true; // timed out or cancelled, the reply is dropped
+
+    auto &slot = *it->second;
+    slot.reply = std::move(message);
+    slot.done  = true;
+    if (slot.notify) {
+        if (_completed.empty())
+            _completedEvent.set();
+        _completed.push_back(header.id);
+    }
+    else {
+        slot.cv.notify_all();
+    }
+    return true;
+}
+
+auto RpcRouter::fail(NativeError errNo) -> void
+{
+    std::lock_guard lock(_mutex);
+    if (_failed)
+        return;
+    _failed = true;
+    _error  = errNo;
+    for (auto &[id, slot] : _slots) {
+        if (slot->done)
+            continue;
+        slot->done = true;
+        if (slot->notify)
+            _completed.push_back(id);
+        else
+            slot->cv.notify_all();
+    }
+    if (!_completed.empty())
+        _completedEvent.set();
+}
+
+auto RpcRouter::close() -> void
+{
+    {
+        std::lock_guard lock(_mutex);
+        _closed = true;
+    }
+    fail(0);
+}
+
+auto RpcRouter::raiseFailure(std::unique_lock<std::mutex> &lock) -> void
+{
+    auto error  = _error;
+    auto closed = _closed;
+    lock.unlock();
+    if (closed)
+        throw std::runtime_error("RPC channel is closed");
+    if (error != 0) {
+#ifdef _WIN32
+        Win32ErrorExit(error);
+#else
+        PosixErrorExit(error);
+#endif
+    }
+    throw std::runtime_error("handle is closed");
+}
+
+auto RpcRouter::add(uint64_t id, bool notify) -> void
+{
+    std::unique_lock lock(_mutex);
+    if (_failed) [[unlikely]]
+        raiseFailure(lock);
+    auto &slot = _slots[id];
+    if (!slot)
+        slot = std::make_shared<Slot>();
+    slot->notify = notify;
+}
+
+auto RpcRouter::cancel(uint64_t id) -> void
+{
+    std::lock_guard lock(_mutex);
+    auto            it = _slots.find(id);
+    if (it == _slots.end())
+        return;
+
+    // the waiters find the slot gone, see wait()
+    it->second->done = true;
+    it->second->cv.notify_all();
+    _slots.erase(it);
+}
+
+auto RpcRouter::wait(uint64_t                              id,
+                     std::chrono::steady_clock::time_point deadline) -> bool
+{
+    std::unique_lock lock(_mutex);
+    auto             it = _slots.find(id);
+    if (it == _slots.end())
+        return true;
+
+    // another thread might cancel the request, while we wait
+    auto slot = it->second;
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        slot->cv.wait(lock, [&slot] { return slot->done; });
+        return true;
+    }
+    return slot->cv.wait_until(lock, deadline, [&slot] { return slot->done; });
+}
+
+auto RpcRouter::take(uint64_t id) -> std::shared_ptr<MessageBuffer>
+{
+    std::unique_lock lock(_mutex);
+    auto             it = _slots.find(id);
+    if (it == _slots.end())
+        throw nanobind::value_error("unknown request ID");
+    if (!it->second->done)
+        return nullptr;
+
+    auto reply = std::move(it->second->reply);
+    _slots.erase(it);
+    if (!reply)
+        raiseFailure(lock);
+    return reply;
+}
+
+auto RpcRouter::takeCompleted() -> std::vector<uint64_t>
+{
+    // route() sets the event again with the next completion
+    std::lock_guard lock(_mutex);
+    _completedEvent.reset();
+    return std::exchange(_completed, {});
+}
+
+auto RpcRouter::getPending() const -> size_t
+{
+    std::lock_guard lock(_mutex);
+    return _slots.size();
+}
+
+auto RpcRouter::getCompletedEvent() const -> const Event &
+{
+    return _completedEvent;
+}
+
+RpcChannel::RpcChannel(nanobind::handle connection)
+    : _router{std::make_shared<RpcRouter>()}
+{
+    if (!nanobind::isinstance<PipeConnection>(connection))
+        throw nanobind::type_error("expected a PipeConnection");
+    _object     = nanobind::borrow(connection);
+    _connection = nanobind::cast<PipeConnection *>(connection);
+    if (!_connection->getReadable() || !_connection->getWritable())
+        throw nanobind::value_error("an RPC channel needs a duplex connection");
+    if (_connection->_rxRing || _connection->_txRing)
+        throw nanobind::value_error(
+            "an RPC channel does not support shared memory");
+    if (_connection->getClosed())
+        throw std::runtime_error("handle is closed");
+    _connection->setRxRouter(_router);
+}
+
+RpcChannel::~RpcChannel() { close(); }
+
+auto RpcChannel::encode(uint32_t kind, uint64_t id, nanobind::handle buffer)
+    -> nanobind::bytes
+{
+    // the header and the payload must arrive as one message, so the payload
+    // is copied behind the header. The copy is immutable, which lets the
+    // message be queued without waiting for the write.
+    auto      view = BufferView(buffer.ptr(), PyBUF_SIMPLE);
+    RpcHeader header{RpcHeader::MAGIC, kind, id};
+    auto      message = nanobind::steal<nanobind::bytes>(
+        PyBytes_FromStringAndSize(nullptr, sizeof(header) + view.size()));
+    if (!message.is_valid())
+        throw nanobind::python_error();
+    auto pData = PyBytes_AsString(message.ptr());
+    std::memcpy(pData, &header, sizeof(header));
+    std::memcpy(pData + sizeof(header), view.data(), view.size());
+    return message;
+}
+
+auto RpcChannel::decode(std::shared_ptr<MessageBuffer> message)
+    -> nanobind::bytes
+{
+    auto payload = nanobind::bytes(message->data() + sizeof(RpcHeader),
+                                   message->size() - sizeof(RpcHeader));
+    _connection->_RxPool.release(std::move(message));
+    return payload;
+}
+
+auto RpcChannel::sendRequest(nanobind::handle buffer) -> uint64_t
+{
+    auto id      = _nextId.fetch_add(1);
+    auto message = encode(RpcHeader::REQUEST, id, buffer);
+
+    // the slot must exist before the reply can arrive
+    _router->add(id, false);
+    try {
+        _connection->sendBytes(message, 0, {}, true);
+    }
+    catch (...) {
+        _router->cancel(id);
+        throw;
+    }
+    return id;
+}
+
+auto RpcChannel::submitRequest(nanobind::handle buffer)
+    -> std::optional<uint64_t>
+{
+    auto id      = _nextId.fetch_add(1);
+    auto message = encode(RpcHeader::REQUEST, id, buffer);
+
+    _router->add(id, true);
+    std::optional<uint64_t> ticket;
+    try {
+        ticket = _connection->sendBytesNowait(message);
+    }
+    catch (...) {
+        _router->cancel(id);
+        throw;
+    }
+    if (!ticket) {
+        _router->cancel(id);
+        return {};
+    }
+    return id;
+}
+
+auto RpcChannel::waitReply(const uint64_t              id,
+                           const std::optional<double> timeout)
+    -> nanobind::bytes
+{
+    auto deadline = getDeadline(timeout);
+    bool done;
+    {
+        auto nogil = nanobind::gil_scoped_release();
+        done       = _router->wait(id, deadline);
+    }
+    if (!done) {
+        _router->cancel(id);
+        PyErr_SetString(PyExc_TimeoutError, "no reply within the timeout");
+        throw nanobind::python_error();
+    }
+    return takeReply(id);
+}
+
+auto RpcChannel::call(nanobind::handle            buffer,
+                      const std::optional<double> timeout) -> nanobind::bytes
+{
+    return waitReply(sendRequest(buffer), timeout);
+}
+
+auto RpcChannel::takeReply(const uint64_t id) -> nanobind::bytes
+{
+    auto reply = _router->take(id);
+    if (!reply)
+        throw nanobind::value_error("the reply has not been received yet");
+    return decode(std::move(reply));
+}
+
+auto RpcChannel::takeCompleted() -> std::vector<uint64_t>
+{
+    return _router->takeCompleted();
+}
+
+auto RpcChannel::cancel(const uint64_t id) -> void { _router->cancel(id); }
+
+auto RpcChannel::recvRequest(const std::optional<double> timeout)
+    -> std::optional<std::tuple<uint64_t, nanobind::bytes>>
+{
+    auto message = _connection->popRxMessage(true, getDeadline(timeout));
+    if (!message)
+        return {};
+
+    RpcHeader header{};
+    if (message->size() >= sizeof(header))
+        std::memcpy(&header, message->data(), sizeof(header));
+    if (header.magic != RpcHeader::MAGIC ||
+        header.kind != RpcHeader::REQUEST) [[unlikely]] {
+        _connection->_RxPool.release(std::move(message));
+        throw std::runtime_error("message is not an RPC request");
+    }
+    return std::make_tuple(header.id, decode(std::move(message)));
+}
+
+auto RpcChannel::reply(const uint64_t id, nanobind::handle buffer) -> void
+{
+    _connection->sendBytes(encode(RpcHeader::REPLY, id, buffer), 0, {}, true);
+}
+
+auto RpcChannel::close() -> void
+{
+    // later replies are received like plain messages, and the connection
+    // can be used by another channel
+    _router->close();
+    _connection->clearRxRouter(_router.get());
+}
+
+auto RpcChannel::getConnection() const -> nanobind::object { return _object; }
+
+auto RpcChannel::getPending() const -> size_t { return _router->getPending(); }
+
+auto RpcChannel::getCompletedEventHandle() const -> size_t
+{
+    auto handle = _router->getCompletedEvent().getNativeHandle();
+#ifdef _WIN32
+    return reinterpret_cast<size_t>(handle);
+#else
+    return static_cast<size_t>(handle);
+#endif
+}
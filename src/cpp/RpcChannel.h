@@ -0,0 +1,135 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef RPCCHANNEL_H
+#define RPCCHANNEL_H
+
+#include "./PipeConnection.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <nanobind/nanobind.h>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// Prefix of every message of an RpcChannel
+struct RpcHeader {
+    static const uint32_t MAGIC{0x43505257}; // "WRPC"
+    static const uint32_t REQUEST{1};
+    static const uint32_t REPLY{2};
+
+    uint32_t magic;
+    uint32_t kind;
+    uint64_t id; // correlation ID, chosen by the caller
+};
+
+// Completion slots of the pending requests of an RpcChannel. The I/O thread
+// moves every reply straight into the slot of its request and wakes up the
+// waiting thread. Requests, which were submitted for an event loop, are
+// reported through takeCompleted() and the completion event instead.
+class RpcRouter : public RxRouter {
+  public:
+    auto route(std::shared_ptr<MessageBuffer> &message) -> bool override;
+    auto fail(NativeError errNo) -> void override;
+
+    // Raises the failure of the channel, if it failed already
+    auto add(uint64_t id, bool notify) -> void;
+    // Removes the slot and wakes up its waiters
+    auto cancel(uint64_t id) -> void;
+
+    // Returns false on timeout, true if the request completed, was cancelled
+    // or is unknown. Called without the GIL, time_point::max() waits forever.
+    auto wait(uint64_t id, std::chrono::steady_clock::time_point deadline)
+        -> bool;
+
+    // Removes the slot of a completed request and returns its reply. Returns
+    // nullptr, if the request is still pending, raises, if it failed.
+    auto take(uint64_t id) -> std::shared_ptr<MessageBuffer>;
+
+    auto takeCompleted() -> std::vector<uint64_t>;
+    auto close() -> void;
+    auto getPending() const -> size_t;
+    auto getCompletedEvent() const -> const Event &;
+
+  private:
+    // shared with the waiting threads, so cancel() can remove it any time
+    struct Slot {
+        std::shared_ptr<MessageBuffer> reply; // empty, if the request failed
+        bool                           done{false};
+        bool                           notify{false};
+        std::condition_variable        cv;
+    };
+
+    mutable std::mutex                                  _mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Slot>> _slots;
+
+    std::vector<uint64_t> _completed; // of slots with `notify`
+    Event                 _completedEvent;
+    bool                  _failed{false};
+    bool                  _closed{false}; // by close()
+    NativeError           _error{0};      // 0: closed
+
+    [[noreturn]] auto raiseFailure(std::unique_lock<std::mutex> &lock)
+        -> void;
+};
+
+// Request/response messaging over one duplex connection. Any number of
+// threads and coroutines can wait for replies at the same time, each one is
+// woken up by its own reply only. Requests of the peer are queued like plain
+// messages and received with recvRequest(). A connection has at most one
+// channel, which must not be combined with shared memory.
+class RpcChannel {
+  public:
+    explicit RpcChannel(nanobind::handle connection);
+    ~RpcChannel();
+
+    // Sends a request and waits for its reply. Raises TimeoutError, if the
+    // reply did not arrive within `timeout` seconds.
+    auto call(nanobind::handle            buffer,
+              const std::optional<double> timeout = {}) -> nanobind::bytes;
+
+    // Sends a request like send_bytes() and returns its ID for waitReply(),
+    // without waiting for the reply. Requests and replies wait for room in
+    // the send queue and the Tx limit, so they are not lost under load.
+    auto sendRequest(nanobind::handle buffer) -> uint64_t;
+    auto waitReply(const uint64_t id, const std::optional<double> timeout = {})
+        -> nanobind::bytes;
+
+    // Returns the ID and payload of the next request of the peer. An empty
+    // timeout waits forever, an empty optional means it expired.
+    auto recvRequest(const std::optional<double> timeout = {})
+        -> std::optional<std::tuple<uint64_t, nanobind::bytes>>;
+    auto reply(const uint64_t id, nanobind::handle buffer) -> void;
+
+    // Fails the pending calls and releases the connection, which stays open
+    auto close() -> void;
+
+    auto getConnection() const -> nanobind::object;
+    auto getPending() const -> size_t;
+
+    // Support for call_async() in win32_pipes._asyncio. submitRequest()
+    // returns an empty optional, if TxQueue is full or the Tx limit was
+    // reached. The completion event is set, while takeCompleted() would
+    // return IDs.
+    auto submitRequest(nanobind::handle buffer) -> std::optional<uint64_t>;
+    auto takeCompleted() -> std::vector<uint64_t>;
+    auto takeReply(const uint64_t id) -> nanobind::bytes;
+    auto cancel(const uint64_t id) -> void;
+    auto getCompletedEventHandle() const -> size_t;
+
+  private:
+    nanobind::object           _object; // keeps the connection alive
+    PipeConnection            *_connection;
+    std::shared_ptr<RpcRouter> _router;
+    std::atomic<uint64_t>      _nextId{1};
+
+    auto encode(uint32_t kind, uint64_t id, nanobind::handle buffer)
+        -> nanobind::bytes;
+    auto decode(std::shared_ptr<MessageBuffer> message) -> nanobind::bytes;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./SharedMemory.h"
+#include <nanobind/nanobind.h>
+#include <stdexcept>
+
+auto SharedMemory::size() const -> size_t { return _size; }
+
+auto SharedMemory::data() const -> char * { return _data; }
+
+auto SharedMemory::fromHandle(size_t handle) -> std::shared_ptr<SharedMemory>
+{
+#ifdef _WIN32
+    return std::make_shared<SharedMemory>(reinterpret_cast<HANDLE>(handle));
+#else
+    return std::make_shared<SharedMemory>(static_cast<int>(handle));
+#endif
+}
+
+auto FileMapping::data() const -> const char * { return _data; }
+
+auto FileMapping::size() const -> size_t { return _size; }
+
+auto fileRegionSize(uint64_t                fileSize,
+                    uint64_t                offset,
+                    std::optional<uint64_t> size) -> size_t
+{
+    if (offset > fileSize)
+        throw nanobind::value_error("offset exceeds the file size");
+    auto regionSize = size.value_or(fileSize - offset);
+    if (regionSize > fileSize - offset)
+        throw nanobind::value_error("region exceeds the file size");
+    if (regionSize == 0)
+        throw nanobind::value_error("file region is empty");
+    if (regionSize > SIZE_MAX)
+        throw nanobind::value_error("region too large to map");
+    return static_cast<size_t>(regionSize);
+}
+
+auto createSharedRing(size_t size) -> std::shared_ptr<SharedMemory>
+{
+    if (size <= sizeof(SharedRingHeader))
+        throw nanobind::value_error("shared memory size too small");
+
+    // the new mapping is zero-filled, so head and tail start at 0
+    auto memory      = std::make_shared<SharedMemory>(size);
+    auto header      = reinterpret_cast<SharedRingHeader *>(memory->data());
+    header->capacity = size - sizeof(SharedRingHeader);
+    header->magic    = SharedRingHeader::MAGIC;
+    return memory;
+}
+
+static auto getRingHeader(const std::shared_ptr<SharedMemory> &memory)
+    -> SharedRingHeader *
+{
+    auto header = reinterpret_cast<SharedRingHeader *>(memory->data());
+    if (memory->size() <= sizeof(SharedRingHeader) ||
+        header->magic != SharedRingHeader::MAGIC ||
+        header->capacity > memory->size() - sizeof(SharedRingHeader))
+        throw std::runtime_error("invalid shared memory ring");
+    return header;
+}
+
+SharedRingWriter::SharedRingWriter(std::shared_ptr<SharedMemory> memory)
+    : _memory{std::move(memory)},
+      _header{getRingHeader(_memory)},
+      _data{_memory->data() + sizeof(SharedRingHeader)},
+      _capacity{_header->capacity}
+{
+}
+
+auto SharedRingWriter::allocate(size_t size, char *&pData)
+    -> std::optional<SharedRingDescriptor>
+{
+    // only the writer moves head, so a relaxed load sees its own value
+    auto head  = _header->head.load(std::memory_order_relaxed);
+    auto tail  = _header->tail.load(std::memory_order_acquire);
+    auto index = head % _capacity;
+
+    // payloads are contiguous, skip the end of the ring if it is too short
+    auto padding = index + size > _capacity ? _capacity - index : 0;
+    if (head + padding + size - tail > _capacity)
+        return {};
+
+    SharedRingDescriptor descriptor{
+        SharedRingDescriptor::MAGIC, head, head + padding, size};
+    pData = _data + descriptor.offset % _capacity;
+    _header->head.store(descriptor.offset + size, std::memory_order_release);
+    return descriptor;
+}
+
+auto SharedRingWriter::getMemory() const
+    -> const std::shared_ptr<SharedMemory> &
+{
+    return _memory;
+}
+
+SharedRingReader::SharedRingReader(std::shared_ptr<SharedMemory> memory)
+    : _memory{std::move(memory)},
+      _header{getRingHeader(_memory)},
+      _data{_memory->data() + sizeof(SharedRingHeader)},
+      _capacity{_header->capacity},
+      _tail{_header->tail.load(std::memory_order_acquire)}
+{
+}
+
+auto SharedRingReader::resolve(const SharedRingDescriptor &descriptor)
+    -> SharedRingSpan
+{
+    // the descriptor comes from another process, don't trust it
+    auto index = descriptor.offset % _capacity;
+    if (descriptor.size > _capacity - index ||
+        descriptor.begin > descriptor.offset ||
+        descriptor.offset - descriptor.begin >= _capacity)
+        throw std::runtime_error("invalid shared memory descriptor");
+
+    return {_data + index,
+            static_cast<size_t>(descriptor.size),
+            descriptor.begin,
+            descriptor.offset + descriptor.size};
+}
+
+auto SharedRingReader::release(const SharedRingSpan &span) -> void
+{
+    std::scoped_lock lock(_mutex);
+    if (span.begin != _tail) {
+        // an older payload is still in use
+        _released.emplace(span.begin, span.end);
+        return;
+    }
+
+    _tail = span.end;
+    for (auto it = _released.begin();
+         it != _released.end() && it->first == _tail;
+         it = _released.erase(it))
+        _tail = it->second;
+    _header->tail.store(_tail, std::memory_order_release);
+}
+
+auto SharedRingReader::getMemory() const
+    -> const std::shared_ptr<SharedMemory> &
+{
+    return _memory;
+}
+
+SharedRingView::SharedRingView(std::shared_ptr<SharedRingReader> ring,
+                               SharedRingSpan                    span)
+    : _ring{std::move(ring)},
+      _span{span}
+{
+}
+
+SharedRingView::~SharedRingView() { _ring->release(_span); }
+
+auto SharedRingView::data() const -> const char * { return _span.data; }
+
+auto SharedRingView::size() const -> size_t { return _span.size; }
@@ -0,0 +1,165 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "./util.h"
+
+// Default size from which payloads are passed through shared memory
+const size_t SHARED_MEMORY_THRESHOLD{65536};
+
+// Anonymous shared memory mapping: a pagefile-backed section on Windows, a
+// memfd on Linux. The mapping owns its handle, which can be duplicated into
+// another process and opened there.
+class SharedMemory {
+  public:
+    explicit SharedMemory(size_t size);
+    explicit SharedMemory(NativeHandle handle);
+    SharedMemory(const SharedMemory &)                     = delete;
+    auto operator=(const SharedMemory &) -> SharedMemory & = delete;
+    ~SharedMemory();
+
+    // takes ownership of a handle, e.g. one duplicated from another process
+    static auto fromHandle(size_t handle) -> std::shared_ptr<SharedMemory>;
+
+    auto getHandle() const -> size_t;
+    auto data() const -> char *;
+    auto size() const -> size_t;
+
+  private:
+    NativeHandle _handle;
+    char        *_data{nullptr};
+    size_t       _size{0};
+
+    auto map(size_t size) -> void;
+};
+
+// Read-only mapping of a file region, e.g. for send_file(). The region need
+// not be aligned, the mapping starts at the page (allocation granularity on
+// Windows) boundary before it. The file handle is not kept open.
+class FileMapping {
+  public:
+    // An empty `size` maps the rest of the file
+    FileMapping(size_t handle, uint64_t offset, std::optional<uint64_t> size);
+    FileMapping(const FileMapping &)                     = delete;
+    auto operator=(const FileMapping &) -> FileMapping & = delete;
+    ~FileMapping();
+
+    auto data() const -> const char *;
+    auto size() const -> size_t;
+
+  private:
+    void       *_base{nullptr};
+    size_t      _mappedSize{0};
+    const char *_data{nullptr};
+    size_t      _size{0};
+};
+
+// Size of the region of a file of `fileSize` bytes, raises ValueError for a
+// region, which is empty or exceeds the file
+auto fileRegionSize(uint64_t                fileSize,
+                    uint64_t                offset,
+                    std::optional<uint64_t> size) -> size_t;
+
+// Layout at the start of the mapping, followed by the ring data. Positions
+// count bytes since creation, the data index is position % capacity. The
+// writer publishes head, the reader publishes tail.
+struct SharedRingHeader {
+    static const uint64_t MAGIC{0x676e69722d32336e}; // "n32-ring"
+
+    uint64_t                          magic;
+    uint64_t                          capacity;
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+// Pipe message, which replaces a payload written to the ring. The payload
+// starts at `offset`, `begin` is the writer's head before it skipped the
+// unused end of the ring. Any pipe message of exactly this size is a
+// descriptor, so a payload of this size is preceded by an INLINE one.
+struct SharedRingDescriptor {
+    static const uint64_t MAGIC{0x6d68732d32336e77}; // "wn32-shm"
+    static const uint64_t INLINE{UINT64_MAX};
+
+    uint64_t magic;
+    uint64_t begin;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Creates a mapping of `size` bytes and initializes an empty ring in it
+auto createSharedRing(size_t size) -> std::shared_ptr<SharedMemory>;
+
+// Range of the ring, which must be released when the payload was consumed
+struct SharedRingSpan {
+    const char *data;
+    size_t      size;
+    uint64_t    begin;
+    uint64_t    end;
+};
+
+class SharedRingWriter {
+  public:
+    SharedRingWriter(std::shared_ptr<SharedMemory> memory);
+
+    // Reserves `size` contiguous bytes. Returns an empty optional, if the
+    // reader did not release enough space yet.
+    auto allocate(size_t size, char *&pData)
+        -> std::optional<SharedRingDescriptor>;
+    auto getMemory() const -> const std::shared_ptr<SharedMemory> &;
+
+  private:
+    std::shared_ptr<SharedMemory> _memory;
+    SharedRingHeader             *_header;
+    char                         *_data;
+    uint64_t                      _capacity;
+};
+
+class SharedRingReader {
+  public:
+    SharedRingReader(std::shared_ptr<SharedMemory> memory);
+
+    auto resolve(const SharedRingDescriptor &descriptor) -> SharedRingSpan;
+
+    // Spans may be released in any order, the ring space is handed back to
+    // the writer in order.
+    auto release(const SharedRingSpan &span) -> void;
+    auto getMemory() const -> const std::shared_ptr<SharedMemory> &;
+
+  private:
+    std::shared_ptr<SharedMemory> _memory;
+    SharedRingHeader             *_header;
+    char                         *_data;
+    uint64_t                      _capacity;
+    std::mutex                    _mutex;
+    uint64_t                      _tail;
+    std::map<uint64_t, uint64_t>  _released; // begin -> end
+};
+
+// Exports a received payload to Python without copying it. The ring space
+// is released, when the last memoryview of it was released.
+class SharedRingView {
+  public:
+    SharedRingView(std::shared_ptr<SharedRingReader> ring, SharedRingSpan span);
+    SharedRingView(const SharedRingView &)                     = delete;
+    auto operator=(const SharedRingView &) -> SharedRingView & = delete;
+    ~SharedRingView();
+
+    auto data() const -> const char *;
+    auto size() const -> size_t;
+
+  private:
+    std::shared_ptr<SharedRingReader> _ring;
+    SharedRingSpan                    _span;
+};
+
+#endif
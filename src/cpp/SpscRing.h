@@ -0,0 +1,104 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// Bounded lock-free single-producer/single-consumer ring.
+//
+// One thread may push while another thread pops. Threads may take turns on
+// either side, as long as each side is serialized externally (e.g. by the
+// GIL). Besides the slot indices, which are private to their side, producer
+// and consumer only share an element count. Its previous value tells the
+// caller about empty/full transitions, so events only need to be signalled
+// when the state actually changes.
+//
+// T must be default constructible and move assignable. Popped slots are left
+// in their moved-from state.
+template <typename T> class SpscRing {
+  public:
+    explicit SpscRing(size_t capacity)
+        : _capacity{capacity},
+          _slots{std::make_unique<T[]>(capacity)}
+    {
+    }
+
+    SpscRing(const SpscRing &)                     = delete;
+    auto operator=(const SpscRing &) -> SpscRing & = delete;
+
+    // Producer side. Returns false and leaves `value` untouched, if the ring
+    // is full. `wasEmpty` is set, if the ring was empty before this push.
+    auto push(T &&value, bool *wasEmpty = nullptr) -> bool
+    {
+        if (_count.load(std::memory_order_acquire) == _capacity)
+            return false;
+
+        _slots[_head] = std::move(value);
+        _head         = _head + 1 == _capacity ? 0 : _head + 1;
+
+        auto previous = _count.fetch_add(1, std::memory_order_acq_rel);
+        if (wasEmpty)
+            *wasEmpty = previous == 0;
+        return true;
+    }
+
+    // Consumer side. Returns false, if the ring is empty. `wasFull` is set, if
+    // the ring was full before this pop, `isEmpty` if it is empty afterwards.
+    auto pop(T &value, bool *wasFull = nullptr, bool *isEmpty = nullptr)
+        -> bool
+    {
+        if (_count.load(std::memory_order_acquire) == 0)
+            return false;
+
+        value = std::move(_slots[_tail]);
+        _tail = _tail + 1 == _capacity ? 0 : _tail + 1;
+
+        auto previous = _count.fetch_sub(1, std::memory_order_acq_rel);
+        if (wasFull)
+            *wasFull = previous == _capacity;
+        if (isEmpty)
+            *isEmpty = previous == 1;
+        return true;
+    }
+
+    // Consumer side. Returns the oldest element without removing it, or
+    // nullptr if the ring is empty.
+    auto front() -> T * { return peek(0); }
+
+    // Consumer side. Returns the element at `index` counted from the oldest,
+    // or nullptr if the ring holds fewer elements.
+    auto peek(size_t index) -> T *
+    {
+        if (_count.load(std::memory_order_acquire) <= index)
+            return nullptr;
+        auto slot = _tail + index;
+        return &_slots[slot < _capacity ? slot : slot - _capacity];
+    }
+
+    auto size() const -> size_t
+    {
+        return _count.load(std::memory_order_acquire);
+    }
+
+    auto empty() const -> bool { return size() == 0; }
+
+    auto capacity() const -> size_t { return _capacity; }
+
+  private:
+    const size_t         _capacity;
+    std::unique_ptr<T[]> _slots;
+
+    // keep the producer index, the consumer index and the shared count on
+    // separate cache lines
+    alignas(64) size_t _head{0};
+    alignas(64) size_t _tail{0};
+    alignas(64) std::atomic<size_t> _count{0};
+};
+
+#endif
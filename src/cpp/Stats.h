@@ -0,0 +1,178 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+using StatsClock = std::chrono::steady_clock;
+
+// Counters are relaxed: a reader sees every counter on its own, but not a
+// consistent snapshot across counters.
+class StatCounter {
+  public:
+    auto add(uint64_t n = 1) -> void
+    {
+        _value.fetch_add(n, std::memory_order_relaxed);
+    }
+    auto get() const -> uint64_t
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+    auto reset() -> void { _value.store(0, std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> _value{0};
+};
+
+// Counter with a single writer thread, which avoids the locked
+// read-modify-write of StatCounter. A concurrent reset() might be lost.
+class LocalCounter {
+  public:
+    auto add(uint64_t n = 1) -> void
+    {
+        _value.store(_value.load(std::memory_order_relaxed) + n,
+                     std::memory_order_relaxed);
+    }
+    auto get() const -> uint64_t
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+    auto reset() -> void { _value.store(0, std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> _value{0};
+};
+
+// Highest value, which was observed since the last reset. Values are only
+// observed by the producer of a queue, so a concurrent reset() might be lost.
+class PeakGauge {
+  public:
+    auto observe(uint64_t value) -> void
+    {
+        if (value > _value.load(std::memory_order_relaxed))
+            _value.store(value, std::memory_order_relaxed);
+    }
+    auto get() const -> uint64_t
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+    auto reset(uint64_t value = 0) -> void
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<uint64_t> _value{0};
+};
+
+// Histogram of durations with power of two buckets: bucket 0 counts the
+// durations below 1 us, bucket i those from 2^(i-1) us to below 2^i us. The
+// last bucket also takes all longer durations.
+class LatencyHistogram {
+  public:
+    static constexpr size_t BUCKETS{32};
+
+    static auto bucket(StatsClock::duration duration) -> size_t
+    {
+        auto us =
+            std::chrono::duration_cast<std::chrono::microseconds>(duration)
+                .count();
+        if (us <= 0)
+            return 0;
+        return std::min(
+            static_cast<size_t>(std::bit_width(static_cast<uint64_t>(us))),
+            BUCKETS - 1);
+    }
+
+    auto record(StatsClock::duration duration) -> void
+    {
+        _counts[bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // records the time since `start`, if it was sampled
+    auto recordSince(StatsClock::time_point start) -> void
+    {
+        if (start != StatsClock::time_point{})
+            record(StatsClock::now() - start);
+    }
+
+    auto counts() const -> std::vector<uint64_t>
+    {
+        std::vector<uint64_t> counts(BUCKETS);
+        for (size_t i = 0; i < BUCKETS; i++)
+            counts[i] = _counts[i].load(std::memory_order_relaxed);
+        return counts;
+    }
+
+    auto reset() -> void
+    {
+        for (auto &count : _counts)
+            count.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, BUCKETS> _counts{};
+};
+
+// Reading the clock costs more than updating all counters together, so only
+// every SAMPLE_INTERVAL-th message is timestamped for the histograms. Each
+// sampler is used by a single thread at a time.
+class LatencySampler {
+  public:
+    static constexpr uint64_t SAMPLE_INTERVAL{16};
+
+    // returns an empty time point for the messages, which are not sampled
+    auto start() -> StatsClock::time_point
+    {
+        auto next = _next.load(std::memory_order_relaxed);
+        _next.store(next + 1, std::memory_order_relaxed);
+        return next % SAMPLE_INTERVAL == 0 ? StatsClock::now()
+                                           : StatsClock::time_point{};
+    }
+
+  private:
+    std::atomic<uint64_t> _next{0};
+};
+
+// Performance counters of a PipeConnection. The Tx and Rx counters are on
+// separate cache lines, because they are mostly updated by different threads.
+struct ConnectionStats {
+    alignas(64) StatCounter txMessages; // written to the pipe
+    StatCounter      txBytes;
+    PeakGauge        txQueuePeak;
+    LatencySampler   txSampler;
+    LatencyHistogram txLatency; // from the send call to the completed write
+
+    // only updated by the I/O thread, apart from rxResidency
+    alignas(64) LocalCounter rxMessages; // read from the pipe
+    LocalCounter     rxBytes;
+    LocalCounter     rxMoreData; // messages larger than the posted buffer
+    PeakGauge        rxQueuePeak;
+    LatencySampler   rxSampler;
+    LatencyHistogram rxResidency; // time of a message in RxQueue
+
+    auto reset(uint64_t txQueued, uint64_t rxQueued) -> void
+    {
+        txMessages.reset();
+        txBytes.reset();
+        txQueuePeak.reset(txQueued);
+        txLatency.reset();
+        rxMessages.reset();
+        rxBytes.reset();
+        rxMoreData.reset();
+        rxQueuePeak.reset(rxQueued);
+        rxResidency.reset();
+    }
+};
+
+#endif
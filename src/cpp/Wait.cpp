@@ -0,0 +1,79 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "./Wait.h"
+#include "./PipeConnection.h"
+#include "./PipeListener.h"
+#include "./util.h"
+#include <chrono>
+#include <vector>
+
+// Object passed to wait(), exactly one of the pointers is set
+struct Waitable {
+    nanobind::object object;
+    PipeConnection  *connection;
+    PipeListener    *listener;
+
+    auto isReady() const -> bool
+    {
+        return connection ? connection->isReady() : listener->isReady();
+    }
+};
+
+auto waitForObjects(nanobind::iterable          objects,
+                    const std::optional<double> timeout) -> nanobind::list
+{
+    auto deadline = getDeadline(timeout);
+
+    // Every connection is signalled by its Rx event, every listener by its
+    // close event and its connect event (listening socket on POSIX).
+    std::vector<Waitable> waitables;
+    std::vector<size_t>   handles;
+    for (auto object : objects) {
+        if (nanobind::isinstance<PipeConnection>(object)) {
+            auto connection = nanobind::cast<PipeConnection *>(object);
+            waitables.push_back(
+                {nanobind::borrow(object), connection, nullptr});
+            handles.push_back(connection->getRxEventHandle());
+        }
+        else if (nanobind::isinstance<PipeListener>(object)) {
+            auto listener = nanobind::cast<PipeListener *>(object);
+            waitables.push_back({nanobind::borrow(object), nullptr, listener});
+            for (auto handle : listener->getWaitHandles())
+                handles.push_back(handle);
+        }
+        else {
+            throw nanobind::type_error(
+                "expected PipeConnection or PipeListener objects");
+        }
+    }
+
+    nanobind::list ready;
+    if (waitables.empty())
+        return ready;
+
+    while (true) {
+        // the events only wake up this thread, the state decides
+        for (auto &waitable : waitables) {
+            if (waitable.isReady())
+                ready.append(waitable.object);
+        }
+        if (nanobind::len(ready) != 0)
+            return ready;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return ready;
+
+        uint32_t waitMs{UINT32_MAX};
+        if (deadline != std::chrono::steady_clock::time_point::max())
+            waitMs = static_cast<uint32_t>(
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - now)
+                    .count());
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            waitForAny(handles, waitMs);
+        }
+    }
+}
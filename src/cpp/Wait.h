@@ -0,0 +1,18 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <nanobind/nanobind.h>
+#include <optional>
+
+// Like multiprocessing.connection.wait(): waits until at least one of the
+// PipeConnection and PipeListener objects is ready, or the timeout expired,
+// and returns the ready ones. The GIL is released while waiting.
+auto waitForObjects(nanobind::iterable          objects,
+                    const std::optional<double> timeout = {})
+    -> nanobind::list;
+
+#endif
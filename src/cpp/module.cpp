@@ -6,25 +6,79 @@
 #include <nanobind/stl/optional.h>
 #include <nanobind/stl/string.h>
 #include <nanobind/stl/tuple.h>
+#include <nanobind/stl/vector.h>
 
 #include "./Pipe.h"
+#include "./PipeBroadcaster.h"
 #include "./PipeClient.h"
 #include "./PipeConnection.h"
+#include "./PipeDispatcher.h"
 #include "./PipeListener.h"
+#include "./Reactor.h"
+#include "./RpcChannel.h"
+#include "./SharedMemory.h"
+#include "./Wait.h"
 #include "./util.h"
 
 #define STRINGIFY(x) #x
 
 using namespace nanobind::literals;
 
+static auto sharedRingViewGetBuffer(PyObject *self, Py_buffer *view, int flags)
+    -> int
+{
+    auto ringView = nanobind::inst_ptr<SharedRingView>(self);
+    return PyBuffer_FillInfo(view,
+                             self,
+                             const_cast<char *>(ringView->data()),
+                             static_cast<Py_ssize_t>(ringView->size()),
+                             1,
+                             flags);
+}
+
+static PyType_Slot sharedRingViewSlots[] = {
+    {Py_bf_getbuffer, reinterpret_cast<void *>(sharedRingViewGetBuffer)},
+    {0, nullptr}};
+
+static auto fileMappingGetBuffer(PyObject *self, Py_buffer *view, int flags)
+    -> int
+{
+    auto mapping = nanobind::inst_ptr<FileMapping>(self);
+    return PyBuffer_FillInfo(view,
+                             self,
+                             const_cast<char *>(mapping->data()),
+                             static_cast<Py_ssize_t>(mapping->size()),
+                             1,
+                             flags);
+}
+
+static PyType_Slot fileMappingSlots[] = {
+    {Py_bf_getbuffer, reinterpret_cast<void *>(fileMappingGetBuffer)},
+    {0, nullptr}};
+
+// Function of a Python submodule, which implements a method, e.g.
+// win32_pipes._pickle.send() or the `*_async` coroutines of
+// win32_pipes._asyncio
+static auto implFunction(const char *module, const char *name)
+    -> nanobind::object
+{
+    return nanobind::module_::import_(module).attr(name);
+}
+
+// Defaults of send_stream() and recv_stream(), see win32_pipes._stream
+const size_t STREAM_CHUNK_SIZE{1024 * 1024};
+const size_t STREAM_WINDOW{8 * 1024 * 1024};
+
 NB_MODULE(_ext, m)
 {
     nanobind::register_exception_translator(systemErrorToOsError);
     nanobind::class_<PipeConnection>(m, "PipeConnection")
-        .def(nanobind::init<size_t, bool, bool>(),
+        .def(nanobind::init<size_t, bool, bool, size_t, bool>(),
              "handle"_a,
-             "readable"_a = true,
-             "writable"_a = true)
+             "readable"_a        = true,
+             "writable"_a        = true,
+             "buffer_size"_a     = BUFSIZE,
+             "adaptive_buffer"_a = false)
         .def("close", &PipeConnection::close)
         .def("fileno", &PipeConnection::getHandle)
         .def("send_bytes",
@@ -32,14 +86,152 @@ NB_MODULE(_ext, m)
              "buffer"_a,
              "offset"_a   = 0,
              "size"_a     = nanobind::none(),
+             "blocking"_a = true,
+             "priority"_a = 0)
+        .def("send_bytes_many",
+             &PipeConnection::sendBytesMany,
+             "buffers"_a,
              "blocking"_a = true)
         .def("recv_bytes",
              &PipeConnection::recvBytes,
-             "maxlength"_a = nanobind::none(),
-             "blocking"_a  = true)
+             "maxlength"_a    = nanobind::none(),
+             "blocking"_a     = true,
+             "busy_poll_us"_a = nanobind::none())
+        .def("recv_bytes_many",
+             &PipeConnection::recvBytesMany,
+             "max_count"_a = nanobind::none(),
+             "timeout"_a   = nanobind::none())
+        .def("recv_bytes_view",
+             &PipeConnection::recvBytesView,
+             "blocking"_a = true)
+        .def("recv_bytes_into",
+             &PipeConnection::recvBytesInto,
+             "buffer"_a,
+             "offset"_a   = 0,
+             "blocking"_a = true)
+        .def("poll", &PipeConnection::poll, "timeout"_a.none() = 0.0)
+        .def(
+            "send",
+            [](PipeConnection &pc, nanobind::handle obj) {
+                implFunction("win32_pipes._pickle", "send")(
+                    nanobind::find(&pc), obj);
+            },
+            "obj"_a)
+        .def("recv",
+             [](PipeConnection &pc) {
+                 return implFunction("win32_pipes._pickle", "recv")(
+                     nanobind::find(&pc));
+             })
+        .def(
+            "send_stream",
+            [](PipeConnection  &pc,
+               nanobind::handle source,
+               size_t           chunkSize,
+               size_t           window) {
+                return implFunction("win32_pipes._stream", "send_stream")(
+                    nanobind::find(&pc), source, chunkSize, window);
+            },
+            "source"_a,
+            "chunk_size"_a = STREAM_CHUNK_SIZE,
+            "window"_a     = STREAM_WINDOW)
+        .def(
+            "recv_stream",
+            [](PipeConnection &pc, size_t window) {
+                return implFunction("win32_pipes._stream", "recv_stream")(
+                    nanobind::find(&pc), window);
+            },
+            "window"_a = STREAM_WINDOW)
+        .def(
+            "send_file",
+            [](PipeConnection         &pc,
+               nanobind::handle        file,
+               uint64_t                offset,
+               std::optional<uint64_t> count,
+               std::optional<size_t>   chunkSize,
+               size_t                  window,
+               bool                    blocking) {
+                return implFunction("win32_pipes._file", "send_file")(
+                    nanobind::find(&pc),
+                    file,
+                    offset,
+                    count,
+                    chunkSize,
+                    window,
+                    blocking);
+            },
+            "file"_a,
+            "offset"_a     = 0,
+            "count"_a      = nanobind::none(),
+            "chunk_size"_a = nanobind::none(),
+            "window"_a     = STREAM_WINDOW,
+            "blocking"_a   = true)
+        .def("recv_bytes_async",
+             [](PipeConnection &pc) {
+                 return implFunction("win32_pipes._asyncio",
+                                     "recv_bytes_async")(nanobind::find(&pc));
+             })
+        .def(
+            "send_bytes_async",
+            [](PipeConnection       &pc,
+               nanobind::handle      buffer,
+               size_t                offset,
+               std::optional<size_t> size) {
+                return implFunction("win32_pipes._asyncio",
+                                    "send_bytes_async")(
+                    nanobind::find(&pc), buffer, offset, size);
+            },
+            "buffer"_a,
+            "offset"_a = 0,
+            "size"_a   = nanobind::none())
+        .def("_send_bytes_nowait",
+             &PipeConnection::sendBytesNowait,
+             "buffer"_a,
+             "offset"_a = 0,
+             "size"_a   = nanobind::none())
+        .def("_write_done", &PipeConnection::writeDone, "ticket"_a)
+        .def_prop_ro("_rx_event", &PipeConnection::getRxEventHandle)
+        .def_prop_ro("_tx_event", &PipeConnection::getTxEventHandle)
         .def_prop_ro("closed", &PipeConnection::getClosed)
         .def_prop_ro("readable", &PipeConnection::getReadable)
         .def_prop_ro("writable", &PipeConnection::getWritable)
+        .def_prop_ro("rx_buffer_allocations",
+                     &PipeConnection::getRxBufferAllocations)
+        .def_prop_ro("tx_write_allocations",
+                     &PipeConnection::getTxWriteAllocations)
+        .def("set_pool_limits",
+             &PipeConnection::setPoolLimits,
+             "tx_count"_a = nanobind::none(),
+             "rx_count"_a = nanobind::none(),
+             "rx_bytes"_a = nanobind::none())
+        .def_prop_ro("pool_limits", &PipeConnection::getPoolLimits)
+        .def_prop_ro("buffer_size", &PipeConnection::getBufferSize)
+        .def_prop_ro("adaptive_buffer", &PipeConnection::getAdaptiveBuffer)
+        .def_prop_ro("rx_buffer_size", &PipeConnection::getRxBufferSize)
+        .def_prop_rw("busy_poll_us",
+                     &PipeConnection::getBusyPoll,
+                     &PipeConnection::setBusyPoll)
+        .def_prop_ro("shared_memory", &PipeConnection::getSharedMemory)
+        .def("set_tx_limit",
+             &PipeConnection::setTxLimit,
+             "max_inflight_bytes"_a.none(),
+             "low_watermark"_a = nanobind::none())
+        .def("set_rx_limit",
+             &PipeConnection::setRxLimit,
+             "max_queued_bytes"_a.none(),
+             "low_watermark"_a = nanobind::none())
+        .def_prop_ro("max_tx_inflight_bytes", &PipeConnection::getTxLimit)
+        .def_prop_ro("max_rx_queued_bytes", &PipeConnection::getRxLimit)
+        .def_prop_ro("tx_inflight_bytes", &PipeConnection::getTxInflightBytes)
+        .def_prop_ro("tx_queued", &PipeConnection::getTxQueued)
+        .def_prop_ro("rx_queued_bytes", &PipeConnection::getRxQueuedBytes)
+        .def_prop_ro("rx_queued", &PipeConnection::getRxQueued)
+        .def("stats", &PipeConnection::getStats)
+        .def("reset_stats", &PipeConnection::resetStats)
+        .def("_attach_shared_memory",
+             &PipeConnection::attachSharedMemory,
+             "rx_handle"_a.none(),
+             "tx_handle"_a.none(),
+             "threshold"_a)
         .def("__enter__", [](PipeConnection &pc) { return &pc; })
         .def(
             "__exit__",
@@ -52,15 +244,47 @@ NB_MODULE(_ext, m)
             "traceback"_a.none());
 
     m.def("generate_pipe_address", &generatePipeAddress);
-    m.def("Pipe", &pipe, "duplex"_a = true);
+    m.def("Pipe",
+          &createPipe,
+          "duplex"_a                  = true,
+          "shared_memory_size"_a      = 0,
+          "shared_memory_threshold"_a = SHARED_MEMORY_THRESHOLD,
+          "buffer_size"_a             = BUFSIZE,
+          "adaptive_buffer"_a         = false);
+
+    // owner of the memoryviews returned by recv_bytes_view()
+    nanobind::class_<SharedRingView>(
+        m, "SharedRingView", nanobind::type_slots(sharedRingViewSlots));
+
+    // read-only buffer of a file region, which send_file() sends
+    nanobind::class_<FileMapping>(
+        m, "FileMapping", nanobind::type_slots(fileMappingSlots))
+        .def(nanobind::init<size_t, uint64_t, std::optional<uint64_t>>(),
+             "handle"_a,
+             "offset"_a = 0,
+             "size"_a   = nanobind::none())
+        .def("__len__", &FileMapping::size);
 
     nanobind::class_<PipeListener>(m, "PipeListener")
-        .def(nanobind::init<std::string, std::optional<size_t>>(),
+        .def(nanobind::init<std::string, std::optional<size_t>, size_t, bool>(),
              "address"_a,
-             "backlog"_a = nanobind::none())
+             "backlog"_a         = nanobind::none(),
+             "buffer_size"_a     = BUFSIZE,
+             "adaptive_buffer"_a = false)
         .def("accept", &PipeListener::accept)
+        .def("accept_many",
+             &PipeListener::acceptMany,
+             "max_count"_a,
+             "timeout"_a = nanobind::none(),
+             nanobind::rv_policy::take_ownership)
+        .def("accept_async",
+             [](PipeListener &pl) {
+                 return implFunction("win32_pipes._asyncio",
+                                     "accept_async")(nanobind::find(&pl));
+             })
         .def("close", &PipeListener::close)
         .def_prop_ro("address", &PipeListener::getAddress)
+        .def_prop_ro("_wait_handles", &PipeListener::getWaitHandles)
         .def_prop_ro("last_accepted",
                      [](PipeListener &pl) { return nanobind::none(); })
         .def("__enter__", [](PipeListener &pl) { return &pl; })
@@ -73,5 +297,116 @@ NB_MODULE(_ext, m)
             "exc_type"_a.none(),
             "exc_value"_a.none(),
             "traceback"_a.none());
-    m.def("PipeClient", &pipeClient, "address"_a);
+    nanobind::class_<PipeBroadcaster>(m, "PipeBroadcaster")
+        .def(nanobind::init<nanobind::iterable,
+                            size_t,
+                            std::optional<size_t>,
+                            const std::string &>(),
+             "connections"_a,
+             "max_queued"_a       = BROADCAST_MAX_QUEUED,
+             "max_queued_bytes"_a = nanobind::none(),
+             "on_slow"_a          = "drop")
+        // without the GIL, concurrent calls take turns on the broadcaster
+        .def("add",
+             &PipeBroadcaster::add,
+             "connection"_a,
+             nanobind::lock_self())
+        .def("remove",
+             &PipeBroadcaster::remove,
+             "connection"_a,
+             nanobind::lock_self())
+        .def("publish",
+             &PipeBroadcaster::publish,
+             "buffer"_a,
+             "offset"_a = 0,
+             "size"_a   = nanobind::none(),
+             nanobind::lock_self())
+        .def_prop_ro("subscribers",
+                     &PipeBroadcaster::getSubscribers,
+                     nanobind::lock_self())
+        .def("stats", &PipeBroadcaster::getStats, nanobind::lock_self());
+    // weak references map a channel to the futures of its call_async()
+    nanobind::class_<RpcChannel>(
+        m, "RpcChannel", nanobind::is_weak_referenceable())
+        .def(nanobind::init<nanobind::handle>(), "connection"_a)
+        .def("call",
+             &RpcChannel::call,
+             "buffer"_a,
+             "timeout"_a = nanobind::none())
+        .def("send_request", &RpcChannel::sendRequest, "buffer"_a)
+        .def("wait_reply",
+             &RpcChannel::waitReply,
+             "request_id"_a,
+             "timeout"_a = nanobind::none())
+        .def(
+            "call_async",
+            [](RpcChannel &rc, nanobind::handle buffer) {
+                return implFunction("win32_pipes._asyncio",
+                                    "rpc_call_async")(nanobind::find(&rc),
+                                                      buffer);
+            },
+            "buffer"_a)
+        .def("recv_request",
+             &RpcChannel::recvRequest,
+             "timeout"_a = nanobind::none())
+        .def("reply", &RpcChannel::reply, "request_id"_a, "buffer"_a)
+        .def("close", &RpcChannel::close)
+        .def_prop_ro("connection", &RpcChannel::getConnection)
+        .def_prop_ro("pending", &RpcChannel::getPending)
+        .def("_submit", &RpcChannel::submitRequest, "buffer"_a)
+        .def("_take_completed", &RpcChannel::takeCompleted)
+        .def("_take_reply", &RpcChannel::takeReply, "request_id"_a)
+        .def("_cancel", &RpcChannel::cancel, "request_id"_a)
+        .def_prop_ro("_completed_event", &RpcChannel::getCompletedEventHandle)
+        .def("__enter__", [](RpcChannel &rc) { return &rc; })
+        .def(
+            "__exit__",
+            [](RpcChannel &rc,
+               nanobind::handle,
+               nanobind::handle,
+               nanobind::handle) { rc.close(); },
+            "exc_type"_a.none(),
+            "exc_value"_a.none(),
+            "traceback"_a.none());
+    nanobind::class_<PipeDispatcher>(m, "PipeDispatcher")
+        .def(nanobind::init<nanobind::iterable, const std::string &>(),
+             "workers"_a,
+             "policy"_a = "least_outstanding")
+        .def("submit", &PipeDispatcher::submit, "buffer"_a)
+        .def("submit_many", &PipeDispatcher::submitMany, "buffers"_a)
+        .def("recv_results",
+             &PipeDispatcher::recvResults,
+             "max_count"_a = nanobind::none(),
+             "timeout"_a   = nanobind::none())
+        .def("close", &PipeDispatcher::close)
+        .def_prop_ro("workers", &PipeDispatcher::getWorkers)
+        .def_prop_ro("policy", &PipeDispatcher::getPolicy)
+        .def_prop_ro("outstanding", &PipeDispatcher::getOutstanding)
+        .def("stats", &PipeDispatcher::getStats)
+        .def("__enter__", [](PipeDispatcher &pd) { return &pd; })
+        .def(
+            "__exit__",
+            [](PipeDispatcher &pd,
+               nanobind::handle,
+               nanobind::handle,
+               nanobind::handle) { pd.close(); },
+            "exc_type"_a.none(),
+            "exc_value"_a.none(),
+            "traceback"_a.none());
+    m.def("PipeClient",
+          &pipeClient,
+          "address"_a,
+          "buffer_size"_a     = BUFSIZE,
+          "adaptive_buffer"_a = false);
+    m.def("wait",
+          &waitForObjects,
+          "object_list"_a,
+          "timeout"_a = nanobind::none());
+
+    m.def(
+        "set_reactor_threads",
+        [](size_t count) { Reactor::instance().setThreadCount(count); },
+        "count"_a);
+    m.def("get_reactor_threads",
+          []() { return Reactor::instance().getThreadCount(); });
 }
@@ -0,0 +1,50 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../Pipe.h"
+#include "../util.h"
+#include <filesystem>
+#include <memory>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static size_t     _mmap_counter{0};
+static std::mutex _mmap_counter_lock;
+
+auto generatePipeAddress() -> std::string
+{
+    std::scoped_lock lock(_mmap_counter_lock);
+    auto             name = "win32_pipes-" + std::to_string(getpid()) + "-" +
+                std::to_string(_mmap_counter++) + "-";
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+auto createPipe(bool   duplex,
+                size_t sharedMemorySize,
+                size_t sharedMemoryThreshold,
+                size_t bufferSize,
+                bool   adaptiveBuffer)
+    -> std::tuple<PipeConnection *, PipeConnection *>
+{
+    checkBufferSize(bufferSize);
+
+    // SOCK_SEQPACKET keeps message boundaries like PIPE_TYPE_MESSAGE
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1)
+        PosixErrorExit();
+
+    auto c1 = std::make_unique<PipeConnection>(
+        static_cast<size_t>(fds[0]), true, duplex, bufferSize, adaptiveBuffer);
+    auto c2 = std::make_unique<PipeConnection>(
+        static_cast<size_t>(fds[1]), duplex, true, bufferSize, adaptiveBuffer);
+    if (sharedMemorySize > 0) {
+        PipeConnection::connectSharedMemory(
+            *c1, *c2, sharedMemorySize, sharedMemoryThreshold);
+        if (duplex)
+            PipeConnection::connectSharedMemory(
+                *c2, *c1, sharedMemorySize, sharedMemoryThreshold);
+    }
+
+    return std::make_tuple(c1.release(), c2.release());
+};
@@ -0,0 +1,45 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeClient.h"
+#include "../PipeConnection.h"
+#include "../util.h"
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+auto pipeClient(std::string address, size_t bufferSize, bool adaptiveBuffer)
+    -> PipeConnection *
+{
+    checkBufferSize(bufferSize);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (address.size() >= sizeof(addr.sun_path))
+        PosixErrorExit(ENAMETOOLONG);
+    std::memcpy(addr.sun_path, address.c_str(), address.size());
+
+    auto handle = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (handle == -1)
+        PosixErrorExit();
+
+    // connect() waits while the backlog of the listener is full
+    int connectRes;
+    {
+        auto nogil = nanobind::gil_scoped_release();
+        connectRes =
+            connect(handle, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+    if (connectRes == -1) {
+        auto errNo = errno;
+        ::close(handle);
+        PosixErrorExit(errNo);
+    }
+
+    return new PipeConnection(
+        static_cast<size_t>(handle), true, true, bufferSize, adaptiveBuffer);
+}
@@ -0,0 +1,603 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeConnection.h"
+#include "../util.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <nanobind/nanobind.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <utility>
+
+static auto raiseSocketBuffer(int fd, int option, size_t size) -> void
+{
+    // best effort, the kernel caps the size at net.core.wmem_max/rmem_max
+    int       current{0};
+    socklen_t length = sizeof(current);
+    if (getsockopt(fd, SOL_SOCKET, option, &current, &length) == 0 &&
+        static_cast<size_t>(current) < size) {
+        auto value = static_cast<int>(std::min<size_t>(size, INT_MAX / 2));
+        setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value));
+    }
+}
+
+PipeConnection::PipeConnection(size_t handle,
+                               bool   readable,
+                               bool   writable,
+                               size_t bufferSize,
+                               bool   adaptiveBuffer)
+    : _handle{static_cast<int>(handle)},
+      _readable{readable},
+      _writable{writable},
+      _bufferSize{bufferSize},
+      _rxBufferSize{bufferSize}
+{
+    if (!readable && !writable)
+        throw nanobind::value_error(
+            "at least one of `readable` and `writable` must be True");
+    checkBufferSize(bufferSize);
+    if (adaptiveBuffer)
+        _rxAdaptive.emplace(bufferSize);
+
+    // A record must fit into the socket buffers, so they are never shrunk
+    // below the default, which holds several MAX_RECORD records
+    raiseSocketBuffer(_handle, SO_SNDBUF, bufferSize);
+    raiseSocketBuffer(_handle, SO_RCVBUF, bufferSize);
+};
+
+auto PipeConnection::close() -> void
+{
+    // only the first of concurrent callers closes the connection
+    if (_closed.exchange(true))
+        return;
+
+    if (_readable) {
+        _RxQueueEvent.set();
+    }
+    if (_writable) {
+        _TxSpaceEvent.set();
+    }
+    failRxRouter(0); // wake up the callers waiting for replies
+
+    // the woken up senders give up the lock, see lockTx()
+    auto txLock = lockWithoutGil(_txMutex);
+
+    // receivers resume reading without the lock. Once a resumption in
+    // progress finished, later ones see _closed, see wake().
+    {
+        std::scoped_lock lock(_resumeMutex);
+    }
+
+    // wait until the I/O thread dropped the connection. The descriptor is
+    // closed afterwards, so the thread never sees a reused descriptor. The
+    // thread might need the GIL meanwhile, see completeWrite().
+    {
+        std::scoped_lock lock(_startMutex);
+        if (_worker != nullptr) {
+            auto nogil = nanobind::gil_scoped_release();
+            _worker->remove(*this);
+        }
+    }
+
+    // release blocking senders and unpin the buffers of pending and
+    // completed writes
+    failTxQueue(ECANCELED);
+    releaseCompletedWrites();
+
+    // close handle
+    if (::close(_handle) != 0)
+        PosixErrorExit();
+}
+
+auto PipeConnection::startIo() -> void
+{
+    // the first send or receive starts the I/O, concurrent ones wait for it
+    if (_started.load(std::memory_order_acquire))
+        return;
+    std::scoped_lock lock(_startMutex);
+    if (_started.load(std::memory_order_relaxed) || _closed)
+        return;
+
+    if (_readable) {
+        // initialize read buffers
+        _RxPool.resize(_RxBuffer, _rxBufferSize.load());
+        _RxOverflow.resize(MAX_RECORD);
+    }
+
+    Reactor::instance().assign().add(*this);
+    _started.store(true, std::memory_order_release);
+}
+
+auto PipeConnection::registerIo(ReactorWorker &worker) -> void
+{
+    // EPOLLHUP and EPOLLERR are always reported, even for write-only
+    // connections
+    _worker  = &worker;
+    _rxArmed = _readable;
+    epoll_event ev{};
+    ev.events   = _rxArmed ? EPOLLIN : 0;
+    ev.data.ptr = this;
+    if (epoll_ctl(_worker->getEpollFd(), EPOLL_CTL_ADD, _handle, &ev) == -1)
+        cleanupAndThrowExc();
+}
+
+auto PipeConnection::unregisterIo() -> void
+{
+    // called by the I/O thread, the handle might be removed already
+    epoll_ctl(_worker->getEpollFd(), EPOLL_CTL_DEL, _handle, nullptr);
+}
+
+auto PipeConnection::getHandle() const -> size_t
+{
+    return static_cast<size_t>(_handle);
+}
+
+auto PipeConnection::getRxEventHandle() const -> size_t
+{
+    return static_cast<size_t>(_RxQueueEvent.getNativeHandle());
+}
+
+auto PipeConnection::getTxEventHandle() const -> size_t
+{
+    return static_cast<size_t>(_TxSpaceEvent.getNativeHandle());
+}
+
+auto PipeConnection::writeBytes(std::shared_ptr<OverlappedData> pOd)
+    -> std::shared_ptr<OverlappedData>
+{
+    auto t0 = _stats.txSampler.start();
+    if (_TxQueue.empty() && _txLaneQueued.load() == 0) {
+        // Nothing is queued, so the I/O thread is not sending and we can
+        // send straight from the caller's buffer.
+        auto errNo = sendRecords(pOd->pData, pOd->size, pOd->bytesSent);
+        if (errNo == 0) {
+            countWrite(pOd->size, t0);
+            recycleWrite(std::move(pOd));
+            return nullptr;
+        }
+        if (errNo != EAGAIN && errNo != EWOULDBLOCK)
+            cleanupAndThrowExc(errNo);
+
+        // socket buffer is full, let the I/O thread send the rest
+    }
+
+    queueWrite(pOd, t0);
+    return pOd;
+}
+
+auto PipeConnection::writeBytesMany(
+    std::vector<std::shared_ptr<OverlappedData>> writes)
+    -> std::shared_ptr<OverlappedData>
+{
+    // every message is sampled once, whether it is sent here or queued
+    for (auto &write : writes)
+        write->queuedAt = _stats.txSampler.start();
+
+    size_t next{0};
+    if (_TxQueue.empty() && _txLaneQueued.load() == 0) {
+        // send as much as possible straight from the caller's buffers, runs
+        // of single-record messages with one sendmmsg() call each
+        while (next < writes.size()) {
+            NativeError errNo{0};
+            if (writes[next]->size + sizeof(MessageHeader) <= MAX_RECORD) {
+                iovec  batch[MAX_BATCH];
+                size_t count{0};
+                while (count < MAX_BATCH && next + count < writes.size()) {
+                    auto &od = *writes[next + count];
+                    if (od.size + sizeof(MessageHeader) > MAX_RECORD)
+                        break;
+                    batch[count++] = {const_cast<char *>(od.pData), od.size};
+                }
+                size_t messagesSent{0};
+                errNo = sendMessages(batch, count, messagesSent);
+                for (size_t i = 0; i < messagesSent; i++) {
+                    countWrite(batch[i].iov_len, writes[next]->queuedAt);
+                    recycleWrite(std::move(writes[next++]));
+                }
+            }
+            else {
+                auto &od = *writes[next];
+                errNo    = sendRecords(od.pData, od.size, od.bytesSent);
+                if (errNo == 0) {
+                    countWrite(od.size, od.queuedAt);
+                    recycleWrite(std::move(writes[next++]));
+                }
+            }
+            if (errNo == EAGAIN || errNo == EWOULDBLOCK)
+                break;
+            if (errNo != 0)
+                cleanupAndThrowExc(errNo);
+        }
+    }
+
+    // socket buffer is full, let the I/O thread send the rest
+    std::shared_ptr<OverlappedData> pOd;
+    for (; next < writes.size(); next++) {
+        pOd = std::move(writes[next]);
+        queueWrite(pOd, pOd->queuedAt);
+    }
+    return pOd;
+}
+
+auto PipeConnection::queueWrite(std::shared_ptr<OverlappedData> pOd,
+                                const StatsClock::time_point    queuedAt)
+    -> void
+{
+    // only the first write needs to wake up the I/O thread
+    if (pushTxQueue(std::move(pOd), queuedAt))
+        wake();
+
+    // The I/O thread sets _ioErr before it fails the queued writes.
+    // Either it sees this write, or we see the error.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_ioErr != 0) [[unlikely]]
+        cleanupAndThrowExc(_ioErr);
+}
+
+auto PipeConnection::waitForWrite(std::shared_ptr<OverlappedData> pOd) -> void
+{
+    {
+        auto nogil = nanobind::gil_scoped_release();
+        pOd->done.wait(false);
+    }
+    if (pOd->error != 0) {
+        if (_closed)
+            throw std::runtime_error("handle is closed");
+        cleanupAndThrowExc(pOd->error);
+    }
+    // the write goes back to the pool, if the I/O thread released it already
+    pOd.reset();
+    releaseCompletedWrites();
+}
+
+auto PipeConnection::sendRecords(const char  *pData,
+                                 const size_t size,
+                                 size_t      &bytesSent) -> NativeError
+{
+    const auto total = size + sizeof(MessageHeader);
+    while (bytesSent < total) {
+        MessageHeader header{static_cast<uint64_t>(size)};
+        iovec         iov[2];
+        size_t        iovCount{0};
+        size_t        offset{0};
+        size_t        recordSize{MAX_RECORD};
+
+        if (bytesSent == 0) {
+            // first record of the message carries the header
+            iov[iovCount++] = {&header, sizeof(header)};
+            recordSize -= sizeof(header);
+        }
+        else {
+            offset = bytesSent - sizeof(header);
+        }
+        iov[iovCount++] = {const_cast<char *>(pData + offset),
+                           std::min(size - offset, recordSize)};
+
+        msghdr msg{};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = iovCount;
+        auto n         = sendmsg(_handle, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        // records are sent atomically
+        bytesSent += static_cast<size_t>(n);
+    }
+    return 0;
+}
+
+auto PipeConnection::sendMessages(const iovec *messages,
+                                  const size_t count,
+                                  size_t      &messagesSent) -> NativeError
+{
+    // gathered write of complete messages, which fit into a single record
+    MessageHeader headers[MAX_BATCH];
+    iovec         iov[MAX_BATCH][2];
+    mmsghdr       msgs[MAX_BATCH]{};
+    for (size_t i = 0; i < count; i++) {
+        headers[i].size            = messages[i].iov_len;
+        iov[i][0]                  = {&headers[i], sizeof(MessageHeader)};
+        iov[i][1]                  = messages[i];
+        msgs[i].msg_hdr.msg_iov    = iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+
+    while (true) {
+        auto n = sendmmsg(_handle,
+                          msgs,
+                          static_cast<unsigned int>(count),
+                          MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+        messagesSent = static_cast<size_t>(n);
+        return 0;
+    }
+}
+
+auto PipeConnection::flushTxQueue() -> NativeError
+{
+    // Called by the I/O thread, which is the only consumer of TxQueue and
+    // of the lanes. A lane write is started only while TxQueue is empty, but
+    // once started, it is finished first: the records of two messages must
+    // not be interleaved.
+    while (true) {
+        NativeError errNo{0};
+        auto laneStarted = _txLaneCurrent && _txLaneCurrent->bytesSent != 0;
+        auto ppOd        = laneStarted ? nullptr : _TxQueue.front();
+        if (ppOd) {
+            size_t messagesSent{0};
+            auto  &pOd = *ppOd;
+            if (pOd->bytesSent == 0 &&
+                pOd->size + sizeof(MessageHeader) <= MAX_RECORD) {
+                // gather the following single-record messages, too
+                iovec  batch[MAX_BATCH];
+                size_t count{0};
+                while (count < MAX_BATCH) {
+                    auto ppNext = _TxQueue.peek(count);
+                    if (!ppNext || (*ppNext)->bytesSent != 0 ||
+                        (*ppNext)->size + sizeof(MessageHeader) > MAX_RECORD)
+                        break;
+                    batch[count++] = {const_cast<char *>((*ppNext)->pData),
+                                      (*ppNext)->size};
+                }
+                errNo = sendMessages(batch, count, messagesSent);
+            }
+            else {
+                errNo = sendRecords(pOd->pData, pOd->size, pOd->bytesSent);
+                if (errNo == 0)
+                    messagesSent = 1;
+            }
+
+            for (size_t i = 0; i < messagesSent; i++) {
+                auto pDone = popTxQueue();
+                pDone->done.store(true);
+                pDone->done.notify_all();
+                completeWrite(std::move(pDone));
+            }
+        }
+        else {
+            if (!_txLaneCurrent && !(_txLaneCurrent = popTxLane()))
+                break; // nothing left to send
+
+            auto &pOd = *_txLaneCurrent;
+            errNo     = sendRecords(pOd.pData, pOd.size, pOd.bytesSent);
+            if (errNo == 0) {
+                auto pDone = std::move(_txLaneCurrent);
+                pDone->done.store(true);
+                pDone->done.notify_all();
+                completeWrite(std::move(pDone));
+            }
+        }
+
+        if (errNo == EAGAIN || errNo == EWOULDBLOCK) {
+            updateEpoll(_rxArmed, true); // wait for EPOLLOUT
+            return 0;
+        }
+        if (errNo != 0)
+            return errNo;
+    }
+    updateEpoll(_rxArmed, false);
+    return 0;
+}
+
+auto PipeConnection::failTxQueue(NativeError errNo) -> void
+{
+    // Called by the I/O thread after an error, and by close() after the
+    // I/O thread dropped the connection. Wakes up blocking senders.
+    while (auto pOd = popTxQueue()) {
+        pOd->error = errNo;
+        pOd->done.store(true);
+        pOd->done.notify_all();
+        completeWrite(std::move(pOd), false);
+    }
+    if (auto pOd = std::move(_txLaneCurrent)) {
+        pOd->error = errNo;
+        pOd->done.store(true);
+        pOd->done.notify_all();
+        completeWrite(std::move(pOd), false);
+    }
+    failTxLanes(errNo);
+}
+
+auto PipeConnection::notifyTxLanes() -> void { wake(); }
+
+auto PipeConnection::updateEpoll(bool rxArmed, bool txArmed) -> void
+{
+    // called by the I/O thread only
+    if ((_rxArmed == rxArmed && _txArmed == txArmed) || _ioErr != 0)
+        return;
+
+    // EPOLLHUP can not be masked. While a receiver is paused and nothing is
+    // sent, the handle is removed, so a hang-up does not spin the thread. The
+    // remaining messages are read after resuming, then EOF is reported.
+    auto wasRegistered = !_readable || _rxArmed || _txArmed;
+    auto isRegistered  = !_readable || rxArmed || txArmed;
+
+    epoll_event ev{};
+    ev.events   = (rxArmed ? EPOLLIN : 0) | (txArmed ? EPOLLOUT : 0);
+    ev.data.ptr = this;
+    auto op     = !isRegistered   ? EPOLL_CTL_DEL
+                  : wasRegistered ? EPOLL_CTL_MOD
+                                  : EPOLL_CTL_ADD;
+    epoll_ctl(_worker->getEpollFd(), op, _handle, &ev);
+    _rxArmed = rxArmed;
+    _txArmed = txArmed;
+}
+
+auto PipeConnection::receiveRecords() -> NativeError
+{
+    // epoll is level-triggered, so the rest is reported again
+    for (size_t records = 0; records < MAX_RX_RECORDS; records++) {
+        ssize_t n;
+        msghdr  msg{};
+        if (_rxMessageSize == 0 && _rxBytesReceived == 0) {
+            // first record of a message: small messages land in _RxBuffer
+            // directly, the remainder of a large first record in _RxOverflow
+            MessageHeader header{};
+            iovec         iov[3] = {
+                {&header, sizeof(header)},
+                {_RxBuffer.data(), _RxBuffer.size()},
+                {_RxOverflow.data(), _RxOverflow.size()},
+            };
+            msg.msg_iov    = iov;
+            msg.msg_iovlen = 3;
+            n              = recvmsg(_handle, &msg, MSG_DONTWAIT);
+            if (n > 0) {
+                if (static_cast<size_t>(n) < sizeof(header) ||
+                    msg.msg_flags & MSG_TRUNC)
+                    return EPROTO;
+
+                auto payload = static_cast<size_t>(n) - sizeof(header);
+                if (payload > header.size)
+                    return EPROTO;
+
+                auto inBuffer = std::min(payload, _RxBuffer.size());
+                if (header.size > _RxBuffer.size()) {
+                    _stats.rxMoreData.add();
+                    _RxPool.resize(_RxBuffer, header.size);
+                }
+                std::memcpy(_RxBuffer.data() + inBuffer,
+                            _RxOverflow.data(),
+                            payload - inBuffer);
+
+                _rxMessageSize   = header.size;
+                _rxBytesReceived = payload;
+            }
+        }
+        else {
+            // continuation record: read straight into the message buffer
+            iovec iov      = {_RxBuffer.data() + _rxBytesReceived,
+                              _rxMessageSize - _rxBytesReceived};
+            msg.msg_iov    = &iov;
+            msg.msg_iovlen = 1;
+            n              = recvmsg(_handle, &msg, MSG_DONTWAIT);
+            if (n > 0) {
+                if (msg.msg_flags & MSG_TRUNC)
+                    return EPROTO;
+                _rxBytesReceived += static_cast<size_t>(n);
+            }
+        }
+
+        if (n == 0)
+            return EPIPE; // peer closed the connection
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return errno;
+        }
+
+        if (_rxBytesReceived == _rxMessageSize && !completeRxMessage()) {
+            // RxQueue is full or at its limit, stop reading until resumeRx()
+            updateEpoll(false, _txArmed);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+auto PipeConnection::completeRxMessage() -> bool
+{
+    // take a recycled vector, which will be saved in RxQueue
+    auto rxMessageOut = _RxPool.acquire(nextRxBufferSize(_rxMessageSize));
+    rxMessageOut->swap(_RxBuffer);
+    rxMessageOut->resize(_rxMessageSize);
+
+    _rxMessageSize   = 0;
+    _rxBytesReceived = 0;
+
+    // push the new vector to the queue
+    return pushRxMessage(std::move(rxMessageOut));
+}
+
+auto PipeConnection::resumeRx() -> void
+{
+    // the I/O thread picks up _rxPending and starts reading again, unless
+    // RxQueue is still at its limit
+    wake();
+}
+
+auto PipeConnection::wake() -> void
+{
+    // coalesce the wake-ups until the I/O thread handled them
+    if (_wakePending.exchange(true, std::memory_order_acq_rel))
+        return;
+
+    // close() waits for a wake-up in progress and later ones are dropped,
+    // so the I/O thread never sees the connection after remove()
+    std::scoped_lock lock(_resumeMutex);
+    if (!_closed)
+        _worker->wake(*this);
+}
+
+auto PipeConnection::handleWakeup() -> void
+{
+    // new writes in TxQueue or room in RxQueue. Clearing the flag first
+    // makes the writes of the waking thread visible.
+    _wakePending.exchange(false, std::memory_order_acq_rel);
+    if (_ioErr != 0) {
+        failTxQueue(_ioErr); // queued after the error
+        return;
+    }
+
+    NativeError errNo{0};
+    if (_readable && !_rxArmed) {
+        // reading was paused, see receiveRecords()
+        auto resume = _rxPending ? pushRxMessage(std::move(_rxPending))
+                                 : !_rxThrottled.load();
+        if (resume) {
+            updateEpoll(true, _txArmed);
+            errNo = receiveRecords();
+        }
+    }
+    if (errNo == 0 && !_txArmed)
+        errNo = flushTxQueue();
+    if (errNo != 0)
+        failIo(errNo);
+}
+
+auto PipeConnection::handleEvents(uint32_t events) -> void
+{
+    NativeError errNo{0};
+    if (_rxArmed && (events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        errNo = receiveRecords();
+    if (errNo == 0 && (events & (EPOLLOUT | EPOLLHUP | EPOLLERR)))
+        errNo = flushTxQueue();
+    if (errNo == 0 && !_readable && (events & (EPOLLHUP | EPOLLERR)))
+        errNo = EPIPE; // nothing to read, but the peer is gone
+    if (errNo != 0)
+        failIo(errNo);
+}
+
+auto PipeConnection::failIo(NativeError errNo) -> void
+{
+    // stop watching the handle, a hang-up would be reported over and over
+    epoll_ctl(_worker->getEpollFd(), EPOLL_CTL_DEL, _handle, nullptr);
+
+    _ioErr = errNo;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    failTxQueue(errNo);
+    _TxSpaceEvent.set();
+    if (_readable)
+        _RxQueueEvent.set();
+    failRxRouter(errNo);
+}
+
+auto PipeConnection::cleanupAndThrowExc(NativeError errNo) -> void
+{
+    close();
+    PosixErrorExit(errNo);
+}
@@ -0,0 +1,217 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeListener.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+PipeListener::PipeListener(std::string           address,
+                           std::optional<size_t> backlog,
+                           size_t                bufferSize,
+                           bool                  adaptiveBuffer)
+    : _address(address),
+      _bufferSize(bufferSize),
+      _adaptiveBuffer(adaptiveBuffer)
+{
+    checkBufferSize(bufferSize);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (_address.size() >= sizeof(addr.sun_path))
+        PosixErrorExit(ENAMETOOLONG);
+    std::memcpy(addr.sun_path, _address.c_str(), _address.size());
+
+    // non-blocking, so accept() never stalls while holding the GIL
+    auto handle =
+        socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (handle == -1)
+        PosixErrorExit();
+
+    // bind() fails with EADDRINUSE, if the address exists already. This
+    // matches FILE_FLAG_FIRST_PIPE_INSTANCE on Windows.
+    if (bind(handle, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1) {
+        auto errNo = errno;
+        ::close(handle);
+        PosixErrorExit(errNo);
+    }
+    _handle = handle;
+
+    auto _backlog = static_cast<int>(backlog.value_or(SOMAXCONN));
+    if (listen(_handle, _backlog) == -1)
+        cleanupAndThrowExc();
+}
+
+PipeListener::~PipeListener()
+{
+    if (!_closed)
+        close();
+}
+
+auto PipeListener::accept() -> PipeConnection *
+{
+    return acceptMany(1).front();
+}
+
+static auto releaseAll(std::vector<std::unique_ptr<PipeConnection>> &accepted)
+    -> std::vector<PipeConnection *>
+{
+    std::vector<PipeConnection *> connections;
+    connections.reserve(accepted.size()); // nothing throws after this
+    for (auto &connection : accepted)
+        connections.push_back(connection.release());
+    return connections;
+}
+
+auto PipeListener::acceptMany(const size_t                maxCount,
+                              const std::optional<double> timeout)
+    -> std::vector<PipeConnection *>
+{
+    if (maxCount == 0)
+        throw nanobind::value_error("max_count must be greater than 0");
+
+    auto deadline = getDeadline(timeout);
+
+    // the socket stays open, while this thread uses it
+    auto handle = acquireHandle();
+    struct HandleUse {
+        PipeListener &listener;
+        ~HandleUse() { listener.releaseHandle(); }
+    } use{*this};
+
+    // the accepted connections are owned here, until they are returned
+    std::vector<std::unique_ptr<PipeConnection>> accepted;
+    while (true) {
+        if (_closed)
+            throw std::runtime_error("PipeListener was closed.");
+
+        // the kernel queues up to `backlog` connections, take what is ready
+        while (accepted.size() < maxCount) {
+            auto connection = accept4(handle, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connection == -1) {
+                if (errno == EINTR || errno == ECONNABORTED)
+                    continue;
+                // another thread might have taken the connection
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    break;
+                // hand out the accepted ones, the error persists
+                if (!accepted.empty())
+                    break;
+                cleanupAndThrowExc();
+            }
+            std::unique_ptr<PipeConnection> pc;
+            try {
+                pc = std::make_unique<PipeConnection>(
+                    static_cast<size_t>(connection),
+                    true,
+                    true,
+                    _bufferSize,
+                    _adaptiveBuffer);
+            }
+            catch (...) {
+                ::close(connection); // not owned by a connection yet
+                throw;
+            }
+            accepted.push_back(std::move(pc));
+        }
+        if (!accepted.empty())
+            return releaseAll(accepted);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return {};
+
+        int waitMs{-1};
+        if (deadline != std::chrono::steady_clock::time_point::max())
+            waitMs = static_cast<int>(
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - now)
+                    .count());
+
+        pollfd pfds[2] = {
+            {_closeEvent.getNativeHandle(), POLLIN, 0},
+            {handle, POLLIN, 0},
+        };
+        int pollRes;
+        {
+            // release global interpreter lock before waiting
+            auto nogil = nanobind::gil_scoped_release();
+            pollRes    = poll(pfds, 2, waitMs);
+        }
+        if (pollRes == -1) {
+            if (errno == EINTR)
+                continue;
+            cleanupAndThrowExc();
+        }
+        if (pfds[0].revents != 0)
+            throw std::runtime_error("PipeListener was closed.");
+    }
+}
+
+auto PipeListener::close() -> void
+{
+    if (_closed.exchange(true))
+        return;
+    _closeEvent.set();
+
+    std::scoped_lock lock(_mutex);
+    if (_handle != -1) {
+        unlink(_address.c_str());
+        if (_handleUsers == 0) {
+            ::close(_handle);
+            _handle = -1;
+        }
+    }
+}
+
+auto PipeListener::acquireHandle() -> int
+{
+    std::scoped_lock lock(_mutex);
+    if (_closed)
+        throw std::runtime_error("PipeListener was closed.");
+    _handleUsers++;
+    return _handle;
+}
+
+auto PipeListener::releaseHandle() -> void
+{
+    std::scoped_lock lock(_mutex);
+    if (--_handleUsers == 0 && _closed && _handle != -1) {
+        ::close(_handle);
+        _handle = -1;
+    }
+}
+
+auto PipeListener::getAddress() -> std::string { return std::string(_address); }
+
+auto PipeListener::getWaitHandles() const -> std::vector<size_t>
+{
+    // the socket is closed or about to be, it must not reach poll()
+    if (_closed)
+        throw std::runtime_error("handle is closed");
+    return {static_cast<size_t>(_closeEvent.getNativeHandle()),
+            static_cast<size_t>(_handle)};
+}
+
+auto PipeListener::isReady() -> bool
+{
+    std::scoped_lock lock(_mutex);
+    if (_closed)
+        return true;
+    pollfd pfd{_handle, POLLIN, 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+auto PipeListener::cleanupAndThrowExc(NativeError errNo) -> void
+{
+    auto _errNo = errNo == 0 ? errno : errNo;
+    close();
+    PosixErrorExit(_errNo);
+}
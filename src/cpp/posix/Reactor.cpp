@@ -0,0 +1,123 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeConnection.h"
+#include "../Reactor.h"
+#include "../util.h"
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+// Number of readiness events, which are fetched per epoll_wait()
+const int MAX_EVENTS{64};
+
+ReactorWorker::ReactorWorker()
+    : _pid{getpid()},
+      _epollFd{epoll_create1(EPOLL_CLOEXEC)}
+{
+    if (_epollFd == -1)
+        PosixErrorExit();
+
+    // the wake-up event is the only one without a connection
+    epoll_event ev{};
+    ev.events   = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(_epollFd,
+                  EPOLL_CTL_ADD,
+                  _wakeEvent.getNativeHandle(),
+                  &ev) == -1) {
+        auto errNo = errno;
+        ::close(_epollFd);
+        PosixErrorExit(errNo);
+    }
+
+    std::thread(&ReactorWorker::run, this).detach();
+}
+
+auto ReactorWorker::add(PipeConnection &connection) -> void
+{
+    _connections++;
+    connection.registerIo(*this);
+}
+
+auto ReactorWorker::remove(PipeConnection &connection) -> void
+{
+    if (getpid() != _pid)
+        return; // inherited through fork(), there is no I/O thread
+
+    std::future<void> removed;
+    {
+        std::scoped_lock lock(_mutex);
+        _removals.emplace_back(&connection, std::promise<void>());
+        removed = _removals.back().second.get_future();
+    }
+    _wakeEvent.set();
+    removed.wait();
+    _connections--;
+}
+
+auto ReactorWorker::wake(PipeConnection &connection) -> void
+{
+    {
+        std::scoped_lock lock(_mutex);
+        _wakeups.push_back(&connection);
+    }
+    _wakeEvent.set();
+}
+
+auto ReactorWorker::getConnectionCount() const -> size_t
+{
+    return _connections;
+}
+
+auto ReactorWorker::getEpollFd() const -> int { return _epollFd; }
+
+auto ReactorWorker::processRequests() -> void
+{
+    std::vector<PipeConnection *> wakeups;
+    std::vector<Removal>          removals;
+    {
+        std::scoped_lock lock(_mutex);
+        _wakeEvent.reset();
+        wakeups.swap(_wakeups);
+        removals.swap(_removals);
+    }
+
+    // the connections of removals may be destroyed right after
+    for (auto &[connection, removed] : removals) {
+        std::erase(wakeups, connection);
+        connection->unregisterIo();
+        removed.set_value();
+    }
+    for (auto connection : wakeups)
+        connection->handleWakeup();
+}
+
+auto ReactorWorker::run() -> void
+{
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        auto n = epoll_wait(_epollFd, events, MAX_EVENTS, -1);
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        bool requests{false};
+        for (int i = 0; i < n; i++) {
+            auto connection = static_cast<PipeConnection *>(events[i].data.ptr);
+            if (connection == nullptr)
+                requests = true;
+            else
+                connection->handleEvents(events[i].events);
+        }
+
+        // Removals are handled after the batch, because it might still
+        // contain events of the removed connections.
+        if (requests)
+            processRequests();
+    }
+}
@@ -0,0 +1,87 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../SharedMemory.h"
+#include "../util.h"
+#include <cerrno>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SharedMemory::SharedMemory(size_t size)
+    : _handle{memfd_create("win32_pipes", MFD_CLOEXEC)}
+{
+    if (_handle == -1)
+        PosixErrorExit();
+    if (ftruncate(_handle, static_cast<off_t>(size)) == -1) {
+        auto errNo = errno;
+        ::close(_handle);
+        PosixErrorExit(errNo);
+    }
+    map(size);
+}
+
+SharedMemory::SharedMemory(NativeHandle handle)
+    : _handle{handle}
+{
+    struct stat st{};
+    if (fstat(_handle, &st) == -1) {
+        auto errNo = errno;
+        ::close(_handle);
+        PosixErrorExit(errNo);
+    }
+    map(static_cast<size_t>(st.st_size));
+}
+
+SharedMemory::~SharedMemory()
+{
+    munmap(_data, _size);
+    ::close(_handle);
+}
+
+auto SharedMemory::map(size_t size) -> void
+{
+    auto data =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _handle, 0);
+    if (data == MAP_FAILED) {
+        auto errNo = errno;
+        ::close(_handle);
+        PosixErrorExit(errNo);
+    }
+    _data = static_cast<char *>(data);
+    _size = size;
+}
+
+FileMapping::FileMapping(size_t                  handle,
+                         uint64_t                offset,
+                         std::optional<uint64_t> size)
+{
+    auto        fd = static_cast<int>(handle);
+    struct stat st{};
+    if (fstat(fd, &st) == -1)
+        PosixErrorExit();
+    _size = fileRegionSize(static_cast<uint64_t>(st.st_size), offset, size);
+
+    auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    auto start    = offset - offset % pageSize;
+    _mappedSize   = _size + static_cast<size_t>(offset - start);
+    _base         = mmap(nullptr,
+                         _mappedSize,
+                         PROT_READ,
+                         MAP_SHARED,
+                         fd,
+                         static_cast<off_t>(start));
+    if (_base == MAP_FAILED)
+        PosixErrorExit();
+    // the region is read once, front to back
+    madvise(_base, _mappedSize, MADV_SEQUENTIAL);
+    _data = static_cast<const char *>(_base) + (offset - start);
+}
+
+FileMapping::~FileMapping() { munmap(_base, _mappedSize); }
+
+auto SharedMemory::getHandle() const -> size_t
+{
+    return static_cast<size_t>(_handle);
+}
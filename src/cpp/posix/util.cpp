@@ -0,0 +1,85 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../util.h"
+#include <Python.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+[[noreturn]] extern auto PosixErrorExit(int errNo) -> void
+{
+    int  _errNo = errNo == 0 ? errno : errNo;
+    auto ec     = std::error_code(_errNo, std::generic_category());
+    throw std::system_error(ec);
+}
+
+extern auto systemErrorToOsError(const std::exception_ptr &eptr, void *data)
+    -> void
+{
+    try {
+        std::rethrow_exception(eptr);
+    }
+    catch (const std::system_error &e) {
+        // OSError picks the matching subclass (e.g. BrokenPipeError) by errno
+        errno = e.code().value();
+        PyErr_SetFromErrno(PyExc_OSError);
+    }
+}
+
+Event::Event()
+    : _handle{eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+{
+    if (_handle == -1)
+        PosixErrorExit();
+}
+
+Event::~Event() { ::close(_handle); }
+
+auto Event::set() -> void
+{
+    uint64_t value{1};
+    write(_handle, &value, sizeof(value));
+}
+
+auto Event::reset() -> void
+{
+    // reading an eventfd resets its counter to zero
+    uint64_t value;
+    read(_handle, &value, sizeof(value));
+}
+
+// UINT32_MAX is the INFINITE of the Win32 API, poll() waits forever for -1
+static auto toPollTimeout(uint32_t timeoutMs) -> int
+{
+    if (timeoutMs == UINT32_MAX)
+        return -1;
+    return static_cast<int>(std::min<uint32_t>(timeoutMs, INT_MAX));
+}
+
+auto Event::wait(uint32_t timeoutMs) -> bool
+{
+    pollfd pfd{_handle, POLLIN, 0};
+    return poll(&pfd, 1, toPollTimeout(timeoutMs)) > 0;
+}
+
+auto Event::getNativeHandle() const -> NativeHandle { return _handle; }
+
+extern auto waitForAny(const std::vector<size_t> &handles, uint32_t timeoutMs)
+    -> void
+{
+    std::vector<pollfd> pfds;
+    pfds.reserve(handles.size());
+    for (auto handle : handles)
+        pfds.push_back({static_cast<int>(handle), POLLIN, 0});
+    if (poll(pfds.data(), pfds.size(), toPollTimeout(timeoutMs)) == -1 &&
+        errno != EINTR)
+        PosixErrorExit();
+}
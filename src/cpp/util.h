@@ -5,11 +5,52 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <cstddef>
+#include <cstdint>
 #include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+using NativeHandle = HANDLE;
+using NativeError  = DWORD;
+#else
+using NativeHandle = int;
+using NativeError  = int;
+#endif
+
+// Manual-reset event. On Windows this wraps an event object, on POSIX an
+// eventfd, so it can be waited on together with other native handles.
+class Event {
+  public:
+    Event();
+    Event(const Event &)                     = delete;
+    auto operator=(const Event &) -> Event & = delete;
+    ~Event();
+
+    auto set() -> void;
+    auto reset() -> void;
+    auto wait(uint32_t timeoutMs) -> bool;
+    auto getNativeHandle() const -> NativeHandle;
+
+  private:
+    NativeHandle _handle;
+};
+
+// Waits until one of the handles is signalled (readable on POSIX) or the
+// timeout expired, UINT32_MAX waits forever. Unlike WaitForMultipleObjects(),
+// the number of handles is not limited.
+extern auto waitForAny(const std::vector<size_t> &handles, uint32_t timeoutMs)
+    -> void;
 
 extern auto systemErrorToOsError(const std::exception_ptr &eptr, void *data)
     -> void;
+#ifdef _WIN32
 [[noreturn]] extern auto Win32ErrorExit(DWORD errNo = 0) -> void;
+#else
+[[noreturn]] extern auto PosixErrorExit(int errNo = 0) -> void;
+#endif
 
 #endif
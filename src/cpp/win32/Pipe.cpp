@@ -2,7 +2,10 @@
 #
 # SPDX-License-Identifier: MIT */
 
-#include "./Pipe.h"
+#include "../Pipe.h"
+#include <algorithm>
+#include <format>
+#include <memory>
 
 static size_t     _mmap_counter{0};
 static std::mutex _mmap_counter_lock;
@@ -15,13 +18,21 @@ auto generatePipeAddress() -> std::string
                        _mmap_counter++);
 }
 
-auto pipe(bool duplex) -> std::tuple<PipeConnection *, PipeConnection *>
+auto createPipe(bool   duplex,
+                size_t sharedMemorySize,
+                size_t sharedMemoryThreshold,
+                size_t bufferSize,
+                bool   adaptiveBuffer)
+    -> std::tuple<PipeConnection *, PipeConnection *>
 {
+    checkBufferSize(bufferSize);
+
+    // the buffer sizes are the quotas of the pipe in both directions
     auto address  = generatePipeAddress();
     auto openmode = PIPE_ACCESS_DUPLEX;
     auto access   = GENERIC_READ | GENERIC_WRITE;
-    auto obsize   = BUFSIZE;
-    auto ibsize   = BUFSIZE;
+    auto obsize   = static_cast<DWORD>(std::min<size_t>(bufferSize, MAXDWORD));
+    auto ibsize   = obsize;
     if (!duplex) {
         openmode = PIPE_ACCESS_INBOUND;
         access   = GENERIC_WRITE;
@@ -67,7 +78,17 @@ auto pipe(bool duplex) -> std::tuple<PipeConnection *, PipeConnection *>
             Win32ErrorExit(0);
     }
 
-    return std::make_tuple<PipeConnection *, PipeConnection *>(
-        new PipeConnection(reinterpret_cast<size_t>(h1), true, duplex),
-        new PipeConnection(reinterpret_cast<size_t>(h2), duplex, true));
+    auto c1 = std::make_unique<PipeConnection>(
+        reinterpret_cast<size_t>(h1), true, duplex, bufferSize, adaptiveBuffer);
+    auto c2 = std::make_unique<PipeConnection>(
+        reinterpret_cast<size_t>(h2), duplex, true, bufferSize, adaptiveBuffer);
+    if (sharedMemorySize > 0) {
+        PipeConnection::connectSharedMemory(
+            *c1, *c2, sharedMemorySize, sharedMemoryThreshold);
+        if (duplex)
+            PipeConnection::connectSharedMemory(
+                *c2, *c1, sharedMemorySize, sharedMemoryThreshold);
+    }
+
+    return std::make_tuple(c1.release(), c2.release());
 };
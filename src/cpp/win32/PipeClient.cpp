@@ -0,0 +1,62 @@
+#include "../PipeClient.h"
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeConnection.h"
+#include "../util.h"
+#include <Windows.h>
+#include <chrono>
+#include <string>
+#include <utility>
+
+// Like multiprocessing, a client waits up to 20s for a free pipe instance
+const auto CONNECTION_TIMEOUT = std::chrono::seconds(20);
+
+static auto connectHandle(HANDLE handle,
+                          size_t bufferSize,
+                          bool   adaptiveBuffer) -> PipeConnection *
+{
+    DWORD mode{PIPE_READMODE_MESSAGE};
+    if (!SetNamedPipeHandleState(handle, &mode, nullptr, nullptr)) {
+        auto errNo = GetLastError();
+        CloseHandle(handle);
+        Win32ErrorExit(errNo);
+    }
+
+    return new PipeConnection(reinterpret_cast<size_t>(handle),
+                              true,
+                              true,
+                              bufferSize,
+                              adaptiveBuffer);
+}
+
+auto pipeClient(std::string address, size_t bufferSize, bool adaptiveBuffer)
+    -> PipeConnection *
+{
+    // the quotas of the pipe are set by the listener
+    checkBufferSize(bufferSize);
+
+    auto deadline = std::chrono::steady_clock::now() + CONNECTION_TIMEOUT;
+    while (true) {
+        auto handle = CreateFile(address.c_str(),
+                                 GENERIC_READ | GENERIC_WRITE,
+                                 0,
+                                 NULL,
+                                 OPEN_EXISTING,
+                                 FILE_FLAG_OVERLAPPED,
+                                 NULL);
+        if (handle != INVALID_HANDLE_VALUE)
+            return connectHandle(handle, bufferSize, adaptiveBuffer);
+
+        // all instances of the listener are taken, wait for the next one
+        auto errNo = GetLastError();
+        if (errNo != ERROR_PIPE_BUSY ||
+            std::chrono::steady_clock::now() >= deadline)
+            Win32ErrorExit(errNo);
+        {
+            auto nogil = nanobind::gil_scoped_release();
+            WaitNamedPipe(address.c_str(), 1000);
+        }
+    }
+}
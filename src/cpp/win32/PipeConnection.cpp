@@ -0,0 +1,412 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeConnection.h"
+#include "../util.h"
+#include <cstring>
+#include <nanobind/nanobind.h>
+
+PipeConnection::PipeConnection(size_t handle,
+                               bool   readable,
+                               bool   writable,
+                               size_t bufferSize,
+                               bool   adaptiveBuffer)
+    : _handle{reinterpret_cast<const HANDLE>(handle)},
+      _readable{readable},
+      _writable{writable},
+      _bufferSize{bufferSize},
+      _rxBufferSize{bufferSize}
+{
+    if (!readable && !writable)
+        throw nanobind::value_error(
+            "at least one of `readable` and `writable` must be True");
+    checkBufferSize(bufferSize);
+    if (adaptiveBuffer)
+        _rxAdaptive.emplace(bufferSize);
+};
+
+auto PipeConnection::close() -> void
+{
+    // only the first of concurrent callers closes the connection
+    if (_closed.exchange(true))
+        return;
+
+    if (_readable) {
+        _RxQueueEvent.set();
+    }
+    if (_writable) {
+        _TxSpaceEvent.set();
+    }
+    failRxRouter(0); // wake up the callers waiting for replies
+
+    // the woken up senders give up the lock, see lockTx()
+    auto txLock = lockWithoutGil(_txMutex);
+
+    // receivers resume reading without the lock. Once a resumption in
+    // progress finished, later ones see _closed, see resumeRx().
+    {
+        std::scoped_lock lock(_resumeMutex);
+    }
+
+    // closing the handle aborts the pending operations, wait until the
+    // I/O thread handled their completions. The thread might need the GIL
+    // meanwhile, see completeWrite().
+    auto closed = CloseHandle(_handle);
+    auto errNo  = GetLastError();
+    {
+        std::scoped_lock lock(_startMutex);
+        if (_worker != nullptr) {
+            auto nogil = nanobind::gil_scoped_release();
+            _worker->remove(*this);
+        }
+    }
+
+    // unpin the buffers of pending and completed writes, and release
+    // the senders of writes, which were never started
+    while (auto pOd = popTxQueue()) {
+        pOd->error = ERROR_OPERATION_ABORTED;
+        pOd->done.store(true);
+        pOd->done.notify_all();
+    }
+    _txLanePosted.clear();
+    failTxLanes(ERROR_OPERATION_ABORTED);
+    releaseCompletedWrites();
+
+    if (!closed)
+        Win32ErrorExit(errNo);
+}
+
+auto PipeConnection::startIo() -> void
+{
+    // the first send or receive starts the I/O, concurrent ones wait for it
+    if (_started.load(std::memory_order_acquire))
+        return;
+    std::scoped_lock lock(_startMutex);
+    if (_started.load(std::memory_order_relaxed) || _closed)
+        return;
+
+    Reactor::instance().assign().add(*this);
+
+    if (_readable) {
+        // initialize read buffer and start first read operation
+        _RxPool.resize(_RxBuffer, _rxBufferSize.load());
+        auto errNo = startRead(0, _RxBuffer.size());
+        if (errNo != ERROR_SUCCESS)
+            cleanupAndThrowExc(errNo);
+    }
+    _started.store(true, std::memory_order_release);
+}
+
+auto PipeConnection::registerIo(ReactorWorker &worker) -> void
+{
+    // completions are queued to the worker's port, keyed by the connection
+    _worker = &worker;
+    if (CreateIoCompletionPort(_handle,
+                               _worker->getCompletionPort(),
+                               reinterpret_cast<ULONG_PTR>(this),
+                               0) == NULL)
+        cleanupAndThrowExc();
+}
+
+auto PipeConnection::unregisterIo() -> void
+{
+    // The handle is closed already. Wait until the I/O thread handled the
+    // completions of all operations, which still refer to this connection.
+    if ((_pendingIo.fetch_add(IO_CLOSING) & ~IO_CLOSING) != 0)
+        _ioIdleEvent.wait(INFINITE);
+}
+
+auto PipeConnection::acquireIo() -> void { _pendingIo++; }
+
+auto PipeConnection::releaseIo() -> void
+{
+    // close() waits for the last completion, afterwards the connection might
+    // be destroyed at any time
+    if (_pendingIo.fetch_sub(1) == IO_CLOSING + 1)
+        _ioIdleEvent.set();
+}
+
+auto PipeConnection::getHandle() const -> size_t
+{
+    return reinterpret_cast<size_t>(_handle);
+}
+
+auto PipeConnection::getRxEventHandle() const -> size_t
+{
+    return reinterpret_cast<size_t>(_RxQueueEvent.getNativeHandle());
+}
+
+auto PipeConnection::getTxEventHandle() const -> size_t
+{
+    return reinterpret_cast<size_t>(_TxSpaceEvent.getNativeHandle());
+}
+
+auto PipeConnection::writeBytes(std::shared_ptr<OverlappedData> pOd)
+    -> std::shared_ptr<OverlappedData>
+{
+    // push the OverlappedData to the queue before starting WriteFile(),
+    // otherwise the I/O thread might try to clean up before it is inserted
+    pushTxQueue(pOd, _stats.txSampler.start());
+    startWrite(*pOd);
+    return pOd;
+}
+
+auto PipeConnection::startWrite(OverlappedData &od) -> void
+{
+    acquireIo();
+    if (!WriteFile(_handle,
+                   od.pData,
+                   static_cast<DWORD>(od.size),
+                   NULL,
+                   &od.overlapped)) {
+        auto errNo = GetLastError();
+        switch (errNo) {
+            case ERROR_SUCCESS:
+            case ERROR_IO_INCOMPLETE:
+            case ERROR_IO_PENDING:
+                break;
+            default:
+                releaseIo(); // no completion is queued
+                cleanupAndThrowExc(errNo);
+        }
+    }
+}
+
+auto PipeConnection::notifyTxLanes() -> void
+{
+    // a single feed packet is queued at a time
+    if (_txFeedPending.exchange(true))
+        return;
+    acquireIo();
+    if (!PostQueuedCompletionStatus(_worker->getCompletionPort(),
+                                    0,
+                                    reinterpret_cast<ULONG_PTR>(this),
+                                    &_txFeedOv)) {
+        _txFeedPending.store(false);
+        releaseIo();
+    }
+}
+
+auto PipeConnection::feedTxLanes() -> NativeError
+{
+    // Called by the I/O thread. Lane writes are posted, while less than
+    // TX_LANE_WINDOW bytes of them are in flight, but at least one, so a
+    // write of priority 0 waits for this window only.
+    while (_ioErr == 0 && !_closed &&
+           (_txLanePosted.empty() || _txLaneInflight < TX_LANE_WINDOW)) {
+        auto pOd = popTxLane();
+        if (!pOd)
+            break;
+
+        _txLaneInflight += pOd->size;
+        _txLanePosted.push_back(pOd);
+        acquireIo();
+        if (!WriteFile(_handle,
+                       pOd->pData,
+                       static_cast<DWORD>(pOd->size),
+                       NULL,
+                       &pOd->overlapped)) {
+            auto errNo = GetLastError();
+            if (errNo != ERROR_SUCCESS && errNo != ERROR_IO_INCOMPLETE &&
+                errNo != ERROR_IO_PENDING) {
+                releaseIo(); // no completion is queued
+                _txLanePosted.pop_back();
+                _txLaneInflight -= pOd->size;
+                pOd->error = errNo;
+                pOd->done.store(true);
+                pOd->done.notify_all();
+                completeWrite(std::move(pOd), false);
+                return errNo;
+            }
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+auto PipeConnection::startRead(const size_t offset, const size_t size)
+    -> NativeError
+{
+    std::memset(&_rxOv, 0, sizeof(_rxOv));
+    acquireIo();
+    if (!ReadFile(_handle,
+                  _RxBuffer.data() + offset,
+                  static_cast<DWORD>(size),
+                  nullptr,
+                  &_rxOv)) {
+        // a partial message completes through the port, too
+        auto errNo = GetLastError();
+        if (errNo != ERROR_IO_PENDING && errNo != ERROR_MORE_DATA) {
+            releaseIo();
+            return errNo;
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+auto PipeConnection::writeBytesMany(
+    std::vector<std::shared_ptr<OverlappedData>> writes)
+    -> std::shared_ptr<OverlappedData>
+{
+    // Message mode pipes have no gathered writes, WriteFileGather() only works
+    // for files. Each message is still its own WriteFile() call, but the batch
+    // needs a single GIL round trip.
+    std::shared_ptr<OverlappedData> pOd;
+    for (auto &write : writes) {
+        pOd = std::move(write);
+        pushTxQueue(pOd, _stats.txSampler.start());
+        startWrite(*pOd);
+    }
+    return pOd;
+}
+
+auto PipeConnection::waitForWrite(std::shared_ptr<OverlappedData> pOd) -> void
+{
+    // The I/O thread flags every completed write. GetOverlappedResult() is
+    // not used, it would wait for the file handle, which is signalled by the
+    // completion of any operation, while several senders wait.
+    {
+        auto nogil = nanobind::gil_scoped_release();
+        pOd->done.wait(false);
+    }
+    // cleanup needs the GIL to release pinned buffers
+    if (pOd->error != ERROR_SUCCESS) {
+        if (_closed)
+            throw std::runtime_error("handle is closed");
+        cleanupAndThrowExc(pOd->error);
+    }
+    // the write goes back to the pool, if the I/O thread released it already
+    pOd.reset();
+    releaseCompletedWrites();
+}
+
+auto PipeConnection::resumeRx() -> void
+{
+    // the I/O thread picks up _rxPending and starts reading again, unless
+    // RxQueue is still at its limit. A packet, which is posted after
+    // close() waited for the pending I/O, would refer to a dead connection.
+    std::scoped_lock lock(_resumeMutex);
+    if (_closed)
+        return;
+    acquireIo();
+    if (!PostQueuedCompletionStatus(_worker->getCompletionPort(),
+                                    0,
+                                    reinterpret_cast<ULONG_PTR>(this),
+                                    &_resumeOv))
+        releaseIo();
+}
+
+auto PipeConnection::handleCompletion(OVERLAPPED *pOv,
+                                      DWORD       numberOfBytesTransferred,
+                                      NativeError errNo) -> void
+{
+    if (pOv == &_rxOv) {
+        errNo = completeRead(numberOfBytesTransferred, errNo);
+    }
+    else if (pOv == &_resumeOv) {
+        // receiver made room in RxQueue, continue with the next message
+        errNo = ERROR_SUCCESS;
+        if (_rxPaused) {
+            auto resume = _rxPending ? pushRxMessage(std::move(_rxPending))
+                                     : !_rxThrottled.load();
+            if (resume) {
+                _rxPaused = false;
+                errNo     = startRead(0, _RxBuffer.size());
+            }
+        }
+    }
+    else if (pOv == &_txFeedOv) {
+        // lane writes were queued, clear the flag before looking at them
+        _txFeedPending.store(false);
+        errNo = feedTxLanes();
+    }
+    else {
+        // send operation completed. Writes of priority 0 and lane writes
+        // complete in the order, in which they were posted.
+        auto ppOd = _TxQueue.front();
+        if (ppOd && &(*ppOd)->overlapped == pOv) {
+            auto pOd   = popTxQueue();
+            pOd->error = errNo;
+            pOd->done.store(true);
+            pOd->done.notify_all();
+            completeWrite(std::move(pOd), errNo == ERROR_SUCCESS);
+        }
+        else {
+            auto pOd = std::move(_txLanePosted.front());
+            _txLanePosted.pop_front();
+            _txLaneInflight -= pOd->size;
+            pOd->error = errNo;
+            pOd->done.store(true);
+            pOd->done.notify_all();
+            completeWrite(std::move(pOd), errNo == ERROR_SUCCESS);
+            if (errNo == ERROR_SUCCESS)
+                errNo = feedTxLanes();
+        }
+    }
+
+    if (errNo != ERROR_SUCCESS && _ioErr == 0)
+        failIo(errNo);
+    releaseIo();
+}
+
+auto PipeConnection::completeRead(DWORD       numberOfBytesTransferred,
+                                  NativeError errNo) -> NativeError
+{
+    _rxBytesReceived += static_cast<size_t>(numberOfBytesTransferred);
+    switch (errNo) {
+        case ERROR_SUCCESS: {
+            // take a recycled vector, which will be saved in RxQueue
+            auto rxMessageOut =
+                _RxPool.acquire(nextRxBufferSize(_rxBytesReceived));
+            rxMessageOut->swap(_RxBuffer);
+            rxMessageOut->resize(_rxBytesReceived);
+            _rxBytesReceived = 0;
+
+            // push the new vector to the queue, stop reading if it is full
+            // or at its limit
+            if (!pushRxMessage(std::move(rxMessageOut))) {
+                _rxPaused = true;
+                return ERROR_SUCCESS;
+            }
+            return startRead(0, _RxBuffer.size());
+        }
+        case ERROR_MORE_DATA: {
+            _stats.rxMoreData.add();
+
+            // check how much data of the message is missing
+            DWORD bytesLeftThisMessage{0};
+            PeekNamedPipe(_handle,
+                          nullptr,
+                          0,
+                          nullptr,
+                          nullptr,
+                          &bytesLeftThisMessage);
+
+            // grow the buffer and read the rest of the message
+            _RxPool.resize(_RxBuffer,
+                           _rxBytesReceived +
+                               static_cast<size_t>(bytesLeftThisMessage));
+            return startRead(_rxBytesReceived, bytesLeftThisMessage);
+        }
+        default:
+            return errNo;
+    }
+}
+
+auto PipeConnection::failIo(NativeError errNo) -> void
+{
+    // reading stopped, pending writes still complete through the port, the
+    // lane writes, which were not posted yet, fail
+    _ioErr = errNo;
+    failTxLanes(errNo);
+    _TxSpaceEvent.set();
+    if (_readable)
+        _RxQueueEvent.set();
+    failRxRouter(errNo);
+}
+
+auto PipeConnection::cleanupAndThrowExc(NativeError errNo) -> void
+{
+    close();
+    Win32ErrorExit(errNo);
+}
@@ -0,0 +1,249 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeListener.h"
+#include <Windows.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+
+PipeListener::PipeListener(std::string           address,
+                           std::optional<size_t> backlog,
+                           size_t                bufferSize,
+                           bool                  adaptiveBuffer)
+    : _address(address),
+      _bufferSize(bufferSize),
+      _adaptiveBuffer(adaptiveBuffer)
+{
+    checkBufferSize(bufferSize);
+
+    auto count = backlog.value_or(DEFAULT_BACKLOG);
+    if (count == 0)
+        throw nanobind::value_error("backlog must be greater than 0");
+
+    // the instances never move, their OVERLAPPED structures are in use
+    _instances.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        auto errNo = postConnect(_instances[i], i == 0);
+        if (errNo != ERROR_SUCCESS)
+            cleanupAndThrowExc(errNo);
+    }
+}
+
+PipeListener::~PipeListener() { close(); }
+
+auto PipeListener::accept() -> PipeConnection *
+{
+    return acceptMany(1).front();
+}
+
+static auto releaseAll(std::vector<std::unique_ptr<PipeConnection>> &accepted)
+    -> std::vector<PipeConnection *>
+{
+    std::vector<PipeConnection *> connections;
+    connections.reserve(accepted.size()); // nothing throws after this
+    for (auto &connection : accepted)
+        connections.push_back(connection.release());
+    return connections;
+}
+
+auto PipeListener::acceptMany(const size_t                maxCount,
+                              const std::optional<double> timeout)
+    -> std::vector<PipeConnection *>
+{
+    if (maxCount == 0)
+        throw nanobind::value_error("max_count must be greater than 0");
+
+    auto deadline = getDeadline(timeout);
+
+    // the accepted connections are owned here, until they are returned
+    std::vector<std::unique_ptr<PipeConnection>> accepted;
+    while (true) {
+        if (_closed)
+            throw std::runtime_error("PipeListener was closed.");
+
+        {
+            std::unique_lock lock(_mutex);
+            auto             errNo = collectConnected();
+            if (errNo != ERROR_SUCCESS) {
+                lock.unlock();
+                cleanupAndThrowExc(errNo);
+            }
+            while (!_readyQueue.empty() && accepted.size() < maxCount) {
+                auto handle = _readyQueue.front();
+                _readyQueue.pop_front();
+                std::unique_ptr<PipeConnection> pc;
+                try {
+                    pc = std::make_unique<PipeConnection>(
+                        reinterpret_cast<size_t>(handle),
+                        true,
+                        true,
+                        _bufferSize,
+                        _adaptiveBuffer);
+                }
+                catch (...) {
+                    CloseHandle(handle); // not owned by a connection yet
+                    throw;
+                }
+                accepted.push_back(std::move(pc));
+            }
+            // let other accepting threads take the rest
+            if (!_readyQueue.empty())
+                _connectEvent.set();
+        }
+        if (!accepted.empty())
+            return releaseAll(accepted);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            return {};
+
+        DWORD waitMs{INFINITE};
+        if (deadline != std::chrono::steady_clock::time_point::max())
+            waitMs = static_cast<DWORD>(
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - now)
+                    .count());
+
+        HANDLE handles[2] = {_closeEvent.getNativeHandle(),
+                             _connectEvent.getNativeHandle()};
+        DWORD  waitRes;
+        {
+            // release global interpreter lock before waiting
+            auto nogil = nanobind::gil_scoped_release();
+            waitRes    = WaitForMultipleObjects(2, handles, FALSE, waitMs);
+        }
+        if (waitRes == WAIT_FAILED)
+            cleanupAndThrowExc();
+    }
+}
+
+auto PipeListener::collectConnected() -> NativeError
+{
+    // Called with _mutex held. The event is reset before looking at the
+    // instances, so a connect completing afterwards sets it again.
+    if (_closed)
+        return ERROR_SUCCESS;
+    _connectEvent.reset();
+    for (auto &instance : _instances) {
+        if (!instance.connected) {
+            DWORD numberOfBytesTransferred;
+            if (GetOverlappedResult(instance.handle,
+                                    &instance.overlapped,
+                                    &numberOfBytesTransferred,
+                                    FALSE)) {
+                instance.connected = true;
+            }
+            else if (GetLastError() == ERROR_IO_INCOMPLETE) {
+                continue;
+            }
+        }
+
+        // hand over a connected instance, replace a failed one
+        if (instance.connected)
+            _readyQueue.push_back(instance.handle);
+        else
+            CloseHandle(instance.handle);
+        instance.handle = INVALID_HANDLE_VALUE;
+
+        auto errNo = postConnect(instance);
+        if (errNo != ERROR_SUCCESS)
+            return errNo;
+    }
+    return ERROR_SUCCESS;
+}
+
+auto PipeListener::postConnect(PendingInstance &instance, bool first)
+    -> NativeError
+{
+    auto flags = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED;
+    if (first) {
+        flags |= FILE_FLAG_FIRST_PIPE_INSTANCE;
+    }
+    auto bufferSize =
+        static_cast<DWORD>(std::min<size_t>(_bufferSize, MAXDWORD));
+    instance.handle =
+        CreateNamedPipe(_address.c_str(),
+                        flags,
+                        PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT,
+                        PIPE_UNLIMITED_INSTANCES,
+                        bufferSize,
+                        bufferSize,
+                        NMPWAIT_WAIT_FOREVER,
+                        NULL);
+    if (instance.handle == INVALID_HANDLE_VALUE)
+        return GetLastError();
+
+    // all instances share the event of the listener
+    instance.connected         = false;
+    instance.overlapped        = OVERLAPPED{0};
+    instance.overlapped.hEvent = _connectEvent.getNativeHandle();
+    if (!ConnectNamedPipe(instance.handle, &instance.overlapped)) {
+        auto errNo = GetLastError();
+        switch (errNo) {
+            case ERROR_PIPE_CONNECTED:
+                // the client connected before ConnectNamedPipe()
+                instance.connected = true;
+                _connectEvent.set();
+                break;
+            case ERROR_IO_PENDING:
+                break;
+            default:
+                return errNo;
+        }
+    }
+    return ERROR_SUCCESS;
+}
+
+auto PipeListener::close() -> void
+{
+    if (_closed.exchange(true))
+        return;
+    _closeEvent.set();
+
+    // closing the handles aborts the pending connects
+    auto lock = std::scoped_lock(_mutex);
+    for (auto &instance : _instances) {
+        if (instance.handle != INVALID_HANDLE_VALUE)
+            CloseHandle(instance.handle);
+        instance.handle = INVALID_HANDLE_VALUE;
+    }
+    for (auto handle : _readyQueue)
+        CloseHandle(handle);
+    _readyQueue.clear();
+}
+
+auto PipeListener::getAddress() -> std::string { return std::string(_address); }
+
+auto PipeListener::getWaitHandles() const -> std::vector<size_t>
+{
+    // like on POSIX, where the socket is gone
+    if (_closed)
+        throw std::runtime_error("handle is closed");
+    return {reinterpret_cast<size_t>(_closeEvent.getNativeHandle()),
+            reinterpret_cast<size_t>(_connectEvent.getNativeHandle())};
+}
+
+auto PipeListener::isReady() -> bool
+{
+    if (_closed)
+        return true;
+
+    std::unique_lock lock(_mutex);
+    auto             errNo = collectConnected();
+    if (errNo != ERROR_SUCCESS) {
+        lock.unlock();
+        cleanupAndThrowExc(errNo);
+    }
+    // collectConnected() reset the event, keep it set for other waiters
+    if (!_readyQueue.empty())
+        _connectEvent.set();
+    return !_readyQueue.empty();
+}
+
+auto PipeListener::cleanupAndThrowExc(NativeError errNo) -> void
+{
+    close();
+    Win32ErrorExit(errNo);
+}
@@ -0,0 +1,65 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../PipeConnection.h"
+#include "../Reactor.h"
+#include "../util.h"
+
+ReactorWorker::ReactorWorker()
+    : _completionPort{CreateIoCompletionPort(INVALID_HANDLE_VALUE,
+                                             nullptr,
+                                             0,
+                                             1)}
+{
+    if (_completionPort == NULL)
+        Win32ErrorExit();
+
+    std::thread(&ReactorWorker::run, this).detach();
+}
+
+auto ReactorWorker::add(PipeConnection &connection) -> void
+{
+    _connections++;
+    connection.registerIo(*this);
+}
+
+auto ReactorWorker::remove(PipeConnection &connection) -> void
+{
+    // the connection waits for its outstanding completions itself
+    connection.unregisterIo();
+    _connections--;
+}
+
+auto ReactorWorker::getConnectionCount() const -> size_t
+{
+    return _connections;
+}
+
+auto ReactorWorker::getCompletionPort() const -> HANDLE
+{
+    return _completionPort;
+}
+
+auto ReactorWorker::run() -> void
+{
+    while (true) {
+        DWORD        numberOfBytesTransferred{0};
+        ULONG_PTR    completionKey{0};
+        LPOVERLAPPED pOv     = nullptr;
+        auto         gqcsRes = GetQueuedCompletionStatus(_completionPort,
+                                                 &numberOfBytesTransferred,
+                                                 &completionKey,
+                                                 &pOv,
+                                                 INFINITE);
+        if (pOv == nullptr)
+            continue; // GetQueuedCompletionStatus failed
+
+        // the completion key is the connection, which started the operation.
+        // A failed operation reports its error, e.g. ERROR_MORE_DATA.
+        auto connection = reinterpret_cast<PipeConnection *>(completionKey);
+        connection->handleCompletion(pOv,
+                                     numberOfBytesTransferred,
+                                     gqcsRes ? ERROR_SUCCESS : GetLastError());
+    }
+}
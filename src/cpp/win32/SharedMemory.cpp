@@ -0,0 +1,90 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../SharedMemory.h"
+#include "../util.h"
+
+SharedMemory::SharedMemory(size_t size)
+    : _handle{CreateFileMapping(INVALID_HANDLE_VALUE,
+                                nullptr,
+                                PAGE_READWRITE,
+                                static_cast<DWORD>(uint64_t(size) >> 32),
+                                static_cast<DWORD>(size),
+                                nullptr)}
+{
+    if (_handle == NULL)
+        Win32ErrorExit(0);
+    map(size);
+}
+
+SharedMemory::SharedMemory(NativeHandle handle)
+    : _handle{handle}
+{
+    // map the whole section, its size is rounded up to pages
+    map(0);
+}
+
+SharedMemory::~SharedMemory()
+{
+    UnmapViewOfFile(_data);
+    CloseHandle(_handle);
+}
+
+auto SharedMemory::map(size_t size) -> void
+{
+    auto data = MapViewOfFile(_handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (data == nullptr) {
+        auto errNo = GetLastError();
+        CloseHandle(_handle);
+        Win32ErrorExit(errNo);
+    }
+
+    if (size == 0) {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(data, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+    _data = static_cast<char *>(data);
+    _size = size;
+}
+
+FileMapping::FileMapping(size_t                  handle,
+                         uint64_t                offset,
+                         std::optional<uint64_t> size)
+{
+    auto          file = reinterpret_cast<HANDLE>(handle);
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+        Win32ErrorExit(0);
+    _size =
+        fileRegionSize(static_cast<uint64_t>(fileSize.QuadPart), offset, size);
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    auto start  = offset - offset % systemInfo.dwAllocationGranularity;
+    _mappedSize = _size + static_cast<size_t>(offset - start);
+
+    // the view keeps the section alive
+    auto section =
+        CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (section == NULL)
+        Win32ErrorExit(0);
+    _base = MapViewOfFile(section,
+                          FILE_MAP_READ,
+                          static_cast<DWORD>(start >> 32),
+                          static_cast<DWORD>(start),
+                          _mappedSize);
+    auto errNo = GetLastError();
+    CloseHandle(section);
+    if (_base == nullptr)
+        Win32ErrorExit(errNo);
+    _data = static_cast<const char *>(_base) + (offset - start);
+}
+
+FileMapping::~FileMapping() { UnmapViewOfFile(_base); }
+
+auto SharedMemory::getHandle() const -> size_t
+{
+    return reinterpret_cast<size_t>(_handle);
+}
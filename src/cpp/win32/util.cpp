@@ -0,0 +1,97 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include "../util.h"
+#include <Python.h>
+#include <Windows.h>
+#include <system_error>
+#include <vector>
+
+[[noreturn]] extern auto Win32ErrorExit(DWORD errNo) -> void
+{
+    DWORD _errNo = errNo == 0 ? GetLastError() : errNo;
+    auto  ec     = std::error_code(_errNo, std::system_category());
+    throw std::system_error(ec);
+}
+
+extern auto systemErrorToOsError(const std::exception_ptr &eptr, void *data)
+    -> void
+{
+    try {
+        std::rethrow_exception(eptr);
+    }
+    catch (const std::system_error &e) {
+        PyErr_SetFromWindowsErr(e.code().value());
+    }
+}
+
+Event::Event()
+    : _handle{CreateEvent(nullptr, TRUE, FALSE, nullptr)}
+{
+    if (_handle == NULL)
+        Win32ErrorExit();
+}
+
+Event::~Event() { CloseHandle(_handle); }
+
+auto Event::set() -> void { SetEvent(_handle); }
+
+auto Event::reset() -> void { ResetEvent(_handle); }
+
+auto Event::wait(uint32_t timeoutMs) -> bool
+{
+    return WaitForSingleObject(_handle, timeoutMs) == WAIT_OBJECT_0;
+}
+
+auto Event::getNativeHandle() const -> NativeHandle { return _handle; }
+
+static VOID CALLBACK signalEvent(PVOID context, BOOLEAN timedOut)
+{
+    SetEvent(static_cast<HANDLE>(context));
+}
+
+extern auto waitForAny(const std::vector<size_t> &handles, uint32_t timeoutMs)
+    -> void
+{
+    if (handles.size() <= MAXIMUM_WAIT_OBJECTS) {
+        std::vector<HANDLE> objects;
+        for (auto handle : handles)
+            objects.push_back(reinterpret_cast<HANDLE>(handle));
+        if (WaitForMultipleObjects(static_cast<DWORD>(objects.size()),
+                                   objects.data(),
+                                   FALSE,
+                                   timeoutMs) == WAIT_FAILED)
+            Win32ErrorExit();
+        return;
+    }
+
+    // The thread pool waits for up to 63 handles per thread and signals a
+    // common event, which is the only handle this thread waits for.
+    Event               signalled;
+    std::vector<HANDLE> waits;
+    DWORD               errNo{ERROR_SUCCESS};
+    waits.reserve(handles.size());
+    for (auto handle : handles) {
+        HANDLE wait;
+        if (!RegisterWaitForSingleObject(&wait,
+                                         reinterpret_cast<HANDLE>(handle),
+                                         signalEvent,
+                                         signalled.getNativeHandle(),
+                                         INFINITE,
+                                         WT_EXECUTEONLYONCE |
+                                             WT_EXECUTEINWAITTHREAD)) {
+            errNo = GetLastError();
+            break;
+        }
+        waits.push_back(wait);
+    }
+    if (errNo == ERROR_SUCCESS)
+        signalled.wait(timeoutMs);
+
+    // blocks until running callbacks returned, they use `signalled`
+    for (auto wait : waits)
+        UnregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    if (errNo != ERROR_SUCCESS)
+        Win32ErrorExit(errNo);
+}
@@ -2,43 +2,130 @@
 #
 # SPDX-License-Identifier: MIT
 
-import _winapi
+import sys
 import typing
 from multiprocessing import reduction
 
 from win32_pipes._ext import (
     Pipe,
+    PipeBroadcaster,
     PipeClient,
     PipeConnection,
+    PipeDispatcher,
     PipeListener,
+    RpcChannel,
     generate_pipe_address,
+    get_reactor_threads,
+    set_reactor_threads,
+    wait,
 )
 from win32_pipes._version import __version__
 
 __all__ = [
     "Pipe",
+    "PipeBroadcaster",
     "PipeClient",
     "PipeConnection",
+    "PipeDispatcher",
     "PipeListener",
+    "RpcChannel",
     "__version__",
     "generate_pipe_address",
+    "get_reactor_threads",
+    "set_reactor_threads",
+    "wait",
 ]
 
 
-def reduce_pipe_connection(conn: PipeConnection) -> typing.Any:
-    access = (_winapi.FILE_GENERIC_READ if conn.readable else 0) | (
-        _winapi.FILE_GENERIC_WRITE if conn.writable else 0
+def _reduce_shared_memory(
+    conn: PipeConnection, duplicate: typing.Callable[[int], typing.Any]
+) -> typing.Any:
+    # the shared memory rings travel with the connection
+    if conn.shared_memory is None:
+        return None
+    rx_handle, tx_handle, threshold = conn.shared_memory
+    return (
+        None if rx_handle is None else duplicate(rx_handle),
+        None if tx_handle is None else duplicate(tx_handle),
+        threshold,
     )
-    dh = reduction.DupHandle(conn.fileno(), access)
-    conn.close()
-    return rebuild_pipe_connection, (dh, conn.readable, conn.writable)
 
 
-def rebuild_pipe_connection(
-    dh: reduction.DupHandle, readable: bool, writable: bool
-) -> PipeConnection:
-    handle = dh.detach()
-    return PipeConnection(handle, readable, writable)
+def _rebuild_shared_memory(conn: PipeConnection, shared_memory: typing.Any) -> None:
+    if shared_memory is None:
+        return
+    rx, tx, threshold = shared_memory
+    conn._attach_shared_memory(
+        None if rx is None else rx.detach(),
+        None if tx is None else tx.detach(),
+        threshold,
+    )
+
+
+if sys.platform == "win32":
+    import _winapi
+
+    _FILE_MAP_ALL_ACCESS = 0x000F001F
+
+    def reduce_pipe_connection(conn: PipeConnection) -> typing.Any:
+        access = (_winapi.FILE_GENERIC_READ if conn.readable else 0) | (
+            _winapi.FILE_GENERIC_WRITE if conn.writable else 0
+        )
+        dh = reduction.DupHandle(conn.fileno(), access)
+        shared_memory = _reduce_shared_memory(
+            conn, lambda h: reduction.DupHandle(h, _FILE_MAP_ALL_ACCESS)
+        )
+        conn.close()
+        return rebuild_pipe_connection, (
+            dh,
+            conn.readable,
+            conn.writable,
+            shared_memory,
+            conn.buffer_size,
+            conn.adaptive_buffer,
+        )
+
+    def rebuild_pipe_connection(
+        dh: reduction.DupHandle,
+        readable: bool,
+        writable: bool,
+        shared_memory: typing.Any = None,
+        buffer_size: int = 8192,
+        adaptive_buffer: bool = False,
+    ) -> PipeConnection:
+        handle = dh.detach()
+        conn = PipeConnection(handle, readable, writable, buffer_size, adaptive_buffer)
+        _rebuild_shared_memory(conn, shared_memory)
+        return conn
+
+else:
+
+    def reduce_pipe_connection(conn: PipeConnection) -> typing.Any:
+        # the descriptor is duplicated when the child is launched, so it
+        # must stay open until then
+        df = reduction.DupFd(conn.fileno())
+        shared_memory = _reduce_shared_memory(conn, reduction.DupFd)
+        return rebuild_pipe_connection, (
+            df,
+            conn.readable,
+            conn.writable,
+            shared_memory,
+            conn.buffer_size,
+            conn.adaptive_buffer,
+        )
+
+    def rebuild_pipe_connection(
+        df: typing.Any,
+        readable: bool,
+        writable: bool,
+        shared_memory: typing.Any = None,
+        buffer_size: int = 8192,
+        adaptive_buffer: bool = False,
+    ) -> PipeConnection:
+        fd = df.detach()
+        conn = PipeConnection(fd, readable, writable, buffer_size, adaptive_buffer)
+        _rebuild_shared_memory(conn, shared_memory)
+        return conn
 
 
 reduction.register(PipeConnection, reduce_pipe_connection)
@@ -0,0 +1,205 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Coroutines behind the ``*_async`` methods.
+
+The I/O threads signal native events (an eventfd or socket on Linux, an event
+object on Windows), which the running event loop watches directly. The loop
+wakes up like for any other descriptor or overlapped operation, so no thread
+pool is involved and the futures complete on the loop's own thread.
+"""
+
+import asyncio
+import sys
+import typing
+import weakref
+
+if typing.TYPE_CHECKING:
+    from win32_pipes._ext import PipeConnection, PipeListener, RpcChannel
+
+_Buffer = typing.Any
+
+
+class _Readers:
+    """Futures waiting for descriptors of one selector event loop.
+
+    ``add_reader()`` keeps a single callback per descriptor, so all coroutines
+    waiting for the same descriptor share it. The reader is removed, when it
+    fired, the waiters look at the connection again and wait anew if needed.
+    """
+
+    def __init__(self) -> None:
+        # no reference to the loop, it is the key of the _readers entry
+        self._waiters: typing.Dict[int, typing.List[asyncio.Future]] = {}
+
+    def add(self, fut: asyncio.Future, fds: typing.Sequence[int]) -> None:
+        for fd in fds:
+            waiters = self._waiters.get(fd)
+            if waiters is None:
+                waiters = self._waiters[fd] = []
+                fut.get_loop().add_reader(fd, self._wake, fut.get_loop(), fd)
+            waiters.append(fut)
+
+    def remove(self, fut: asyncio.Future, fds: typing.Sequence[int]) -> None:
+        for fd in fds:
+            waiters = self._waiters.get(fd)
+            if waiters is None or fut not in waiters:
+                continue
+            waiters.remove(fut)
+            if not waiters:
+                del self._waiters[fd]
+                fut.get_loop().remove_reader(fd)
+
+    def _wake(self, loop: asyncio.AbstractEventLoop, fd: int) -> None:
+        loop.remove_reader(fd)
+        for fut in self._waiters.pop(fd, ()):
+            if not fut.done():
+                fut.set_result(None)
+
+
+_readers: "weakref.WeakKeyDictionary[asyncio.AbstractEventLoop, _Readers]" = (
+    weakref.WeakKeyDictionary()
+)
+
+
+async def _wait(handles: typing.Sequence[int]) -> None:
+    """Wait until one of the native handles is signalled."""
+    loop = asyncio.get_running_loop()
+    proactor = getattr(loop, "_proactor", None)
+    if proactor is not None:
+        # RegisterWaitForSingleObject(), completed through the loop's port
+        futures = [proactor.wait_for_handle(handle) for handle in handles]
+        try:
+            await asyncio.wait(futures, return_when=asyncio.FIRST_COMPLETED)
+        finally:
+            for fut in futures:
+                fut.cancel()
+        return
+
+    if sys.platform == "win32":
+        msg = "the *_async methods require the ProactorEventLoop on Windows"
+        raise NotImplementedError(msg)
+
+    readers = _readers.get(loop)
+    if readers is None:
+        readers = _readers[loop] = _Readers()
+    fut = loop.create_future()
+    readers.add(fut, handles)
+    try:
+        await fut
+    finally:
+        readers.remove(fut, handles)
+
+
+async def recv_bytes_async(conn: "PipeConnection") -> bytes:
+    handles = (conn._rx_event,)
+    while True:
+        data = conn.recv_bytes(blocking=False)
+        if data is not None:
+            return data
+        await _wait(handles)
+
+
+async def send_bytes_async(
+    conn: "PipeConnection",
+    buffer: _Buffer,
+    offset: int = 0,
+    size: typing.Optional[int] = None,
+) -> None:
+    handles = (conn._tx_event,)
+    while True:
+        ticket = conn._send_bytes_nowait(buffer, offset, size)
+        if ticket is not None:
+            break
+        await _wait(handles)  # TxQueue is full
+
+    while not conn._write_done(ticket):
+        await _wait(handles)
+
+
+async def accept_async(listener: "PipeListener") -> "PipeConnection":
+    while True:
+        connections = listener.accept_many(1, timeout=0)
+        if connections:
+            return connections[0]
+        await _wait(listener._wait_handles)
+
+
+class _RpcWaiters:
+    """Futures of the ``call_async()`` requests of one RpcChannel.
+
+    A single task per channel watches its completion event and resolves the
+    futures of the requests, which the I/O thread reported, so a reply only
+    wakes up its own caller, however many requests are in flight.
+    """
+
+    def __init__(self, loop: asyncio.AbstractEventLoop) -> None:
+        self.loop = loop
+        self.futures: typing.Dict[int, asyncio.Future] = {}
+        self.task: typing.Optional[asyncio.Task] = None
+
+
+# no reference to the channel in the values, it is the key
+_rpc_waiters: "weakref.WeakKeyDictionary[RpcChannel, _RpcWaiters]" = (
+    weakref.WeakKeyDictionary()
+)
+
+
+async def _dispatch_replies(channel: "RpcChannel", waiters: _RpcWaiters) -> None:
+    handles = (channel._completed_event,)
+    try:
+        while waiters.futures:
+            for request_id in channel._take_completed():
+                fut = waiters.futures.pop(request_id, None)
+                if fut is None or fut.done():
+                    continue  # cancelled
+                try:
+                    fut.set_result(channel._take_reply(request_id))
+                except Exception as exc:
+                    fut.set_exception(exc)
+            if waiters.futures:
+                await _wait(handles)
+    except Exception as exc:
+        for fut in waiters.futures.values():
+            if not fut.done():
+                fut.set_exception(exc)
+        waiters.futures.clear()
+        raise
+    finally:
+        # a cancelled dispatcher might have been replaced already
+        if waiters.task is asyncio.current_task():
+            waiters.task = None
+
+
+async def rpc_call_async(channel: "RpcChannel", buffer: _Buffer) -> bytes:
+    loop = asyncio.get_running_loop()
+    waiters = _rpc_waiters.get(channel)
+    if waiters is None or waiters.loop is not loop:
+        if waiters is not None and waiters.futures:
+            msg = "the RPC channel is in use by another event loop"
+            raise RuntimeError(msg)
+        waiters = _rpc_waiters[channel] = _RpcWaiters(loop)
+
+    handles = (channel.connection._tx_event,)
+    while True:
+        request_id = channel._submit(buffer)
+        if request_id is not None:
+            break
+        await _wait(handles)  # TxQueue is full
+
+    # registered before the next await, so the dispatcher cannot miss it
+    fut = loop.create_future()
+    waiters.futures[request_id] = fut
+    if waiters.task is None:
+        waiters.task = loop.create_task(_dispatch_replies(channel, waiters))
+    try:
+        return await fut
+    finally:
+        if fut.cancelled():
+            waiters.futures.pop(request_id, None)
+            channel._cancel(request_id)
+            if not waiters.futures and waiters.task is not None:
+                # nothing left to wait for
+                waiters.task.cancel()
+                waiters.task = None
@@ -2,9 +2,13 @@
 #
 # SPDX-License-Identifier: MIT
 
+import os
+from collections.abc import Buffer, Coroutine, Iterable
 from contextlib import AbstractContextManager
 from types import TracebackType
-from typing import Self
+from typing import Any, BinaryIO, Literal, Self
+
+from win32_pipes._stream import StreamReader
 
 class PipeConnection(AbstractContextManager[PipeConnection]):
     def __init__(
@@ -12,15 +16,53 @@ class PipeConnection(AbstractContextManager[PipeConnection]):
         handle: int,
         readable: bool = True,
         writable: bool = True,
+        buffer_size: int = 8192,
+        adaptive_buffer: bool = False,
     ) -> None: ...
-    def recv_bytes(self, blocking: bool = True) -> bytes | None: ...
+    def recv_bytes(
+        self, blocking: bool = True, busy_poll_us: int | None = None
+    ) -> bytes | None: ...
+    def recv_bytes_many(
+        self, max_count: int | None = None, timeout: float | None = None
+    ) -> list[bytes]: ...
+    def recv_bytes_view(self, blocking: bool = True) -> memoryview | None: ...
+    def recv_bytes_into(
+        self, buffer: Buffer, offset: int = 0, blocking: bool = True
+    ) -> int | None: ...
     def send_bytes(
         self,
-        buffer: bytes,
+        buffer: Buffer,
         offset: int = 0,
         size: int | None = None,
         blocking: bool = True,
+        priority: int = 0,
+    ) -> None: ...
+    def send_bytes_many(
+        self, buffers: Iterable[Buffer], blocking: bool = True
     ) -> None: ...
+    def poll(self, timeout: float | None = 0.0) -> bool: ...
+    def send(self, obj: Any) -> None: ...
+    def recv(self) -> Any: ...
+    def send_stream(
+        self,
+        source: Buffer | Iterable[Buffer] | BinaryIO,
+        chunk_size: int = 1048576,
+        window: int = 8388608,
+    ) -> int: ...
+    def recv_stream(self, window: int = 8388608) -> StreamReader: ...
+    def send_file(
+        self,
+        file: str | os.PathLike[str] | int,
+        offset: int = 0,
+        count: int | None = None,
+        chunk_size: int | None = None,
+        window: int = 8388608,
+        blocking: bool = True,
+    ) -> int: ...
+    def recv_bytes_async(self) -> Coroutine[None, None, bytes]: ...
+    def send_bytes_async(
+        self, buffer: Buffer, offset: int = 0, size: int | None = None
+    ) -> Coroutine[None, None, None]: ...
     def close(self) -> None: ...
     def fileno(self) -> int: ...
     @property
@@ -29,6 +71,61 @@ class PipeConnection(AbstractContextManager[PipeConnection]):
     def writable(self) -> bool: ...
     @property
     def closed(self) -> bool: ...
+    @property
+    def rx_buffer_allocations(self) -> int: ...
+    @property
+    def tx_write_allocations(self) -> int: ...
+    def set_pool_limits(
+        self,
+        tx_count: int | None = None,
+        rx_count: int | None = None,
+        rx_bytes: int | None = None,
+    ) -> None: ...
+    @property
+    def pool_limits(self) -> dict[str, int]: ...
+    @property
+    def buffer_size(self) -> int: ...
+    @property
+    def adaptive_buffer(self) -> bool: ...
+    @property
+    def rx_buffer_size(self) -> int: ...
+    @property
+    def busy_poll_us(self) -> int: ...
+    @busy_poll_us.setter
+    def busy_poll_us(self, value: int) -> None: ...
+    @property
+    def shared_memory(self) -> tuple[int | None, int | None, int] | None: ...
+    def stats(self) -> dict[str, int | list[int]]: ...
+    def reset_stats(self) -> None: ...
+    def set_tx_limit(
+        self, max_inflight_bytes: int | None, low_watermark: int | None = None
+    ) -> None: ...
+    def set_rx_limit(
+        self, max_queued_bytes: int | None, low_watermark: int | None = None
+    ) -> None: ...
+    @property
+    def max_tx_inflight_bytes(self) -> int | None: ...
+    @property
+    def max_rx_queued_bytes(self) -> int | None: ...
+    @property
+    def tx_inflight_bytes(self) -> int: ...
+    @property
+    def tx_queued(self) -> int: ...
+    @property
+    def rx_queued_bytes(self) -> int: ...
+    @property
+    def rx_queued(self) -> int: ...
+    def _send_bytes_nowait(
+        self, buffer: Buffer, offset: int = 0, size: int | None = None
+    ) -> int | None: ...
+    def _write_done(self, ticket: int) -> bool: ...
+    @property
+    def _rx_event(self) -> int: ...
+    @property
+    def _tx_event(self) -> int: ...
+    def _attach_shared_memory(
+        self, rx_handle: int | None, tx_handle: int | None, threshold: int
+    ) -> None: ...
     def __enter__(self) -> Self: ...
     def __exit__(
         self,
@@ -38,15 +135,40 @@ class PipeConnection(AbstractContextManager[PipeConnection]):
     ) -> bool | None: ...
 
 def generate_pipe_address() -> str: ...
-def Pipe(duplex: bool = True) -> tuple[PipeConnection, PipeConnection]: ...
+def Pipe(
+    duplex: bool = True,
+    shared_memory_size: int = 0,
+    shared_memory_threshold: int = 65536,
+    buffer_size: int = 8192,
+    adaptive_buffer: bool = False,
+) -> tuple[PipeConnection, PipeConnection]: ...
+
+class FileMapping(Buffer):
+    def __init__(
+        self, handle: int, offset: int = 0, size: int | None = None
+    ) -> None: ...
+    def __len__(self) -> int: ...
+    def __buffer__(self, flags: int, /) -> memoryview: ...
 
 class PipeListener(AbstractContextManager[PipeListener]):
-    def __init__(self, address: str, backlog: int | None = None) -> None: ...
+    def __init__(
+        self,
+        address: str,
+        backlog: int | None = None,
+        buffer_size: int = 8192,
+        adaptive_buffer: bool = False,
+    ) -> None: ...
     def accept(self) -> PipeConnection: ...
+    def accept_many(
+        self, max_count: int, timeout: float | None = None
+    ) -> list[PipeConnection]: ...
+    def accept_async(self) -> Coroutine[None, None, PipeConnection]: ...
     def close(self) -> None: ...
     @property
     def address(self) -> str: ...
     @property
+    def _wait_handles(self) -> list[int]: ...
+    @property
     def last_accepted(self) -> None: ...
     def __enter__(self) -> Self: ...
     def __exit__(
@@ -56,4 +178,87 @@ class PipeListener(AbstractContextManager[PipeListener]):
         traceback: TracebackType | None,
     ) -> bool | None: ...
 
-def PipeClient(address: str) -> PipeConnection: ...
+class PipeBroadcaster:
+    def __init__(
+        self,
+        connections: Iterable[PipeConnection],
+        max_queued: int = 64,
+        max_queued_bytes: int | None = None,
+        on_slow: Literal["drop", "remove"] = "drop",
+    ) -> None: ...
+    def add(self, connection: PipeConnection) -> None: ...
+    def remove(self, connection: PipeConnection) -> None: ...
+    def publish(
+        self, buffer: Buffer, offset: int = 0, size: int | None = None
+    ) -> int: ...
+    @property
+    def subscribers(self) -> list[PipeConnection]: ...
+    def stats(self) -> list[dict[str, Any]]: ...
+
+class RpcChannel(AbstractContextManager[RpcChannel]):
+    def __init__(self, connection: PipeConnection) -> None: ...
+    def call(self, buffer: Buffer, timeout: float | None = None) -> bytes: ...
+    def send_request(self, buffer: Buffer) -> int: ...
+    def wait_reply(self, request_id: int, timeout: float | None = None) -> bytes: ...
+    def call_async(self, buffer: Buffer) -> Coroutine[None, None, bytes]: ...
+    def recv_request(
+        self, timeout: float | None = None
+    ) -> tuple[int, bytes] | None: ...
+    def reply(self, request_id: int, buffer: Buffer) -> None: ...
+    def close(self) -> None: ...
+    @property
+    def connection(self) -> PipeConnection: ...
+    @property
+    def pending(self) -> int: ...
+    def _submit(self, buffer: Buffer) -> int | None: ...
+    def _take_completed(self) -> list[int]: ...
+    def _take_reply(self, request_id: int) -> bytes: ...
+    def _cancel(self, request_id: int) -> None: ...
+    @property
+    def _completed_event(self) -> int: ...
+    def __enter__(self) -> Self: ...
+    def __exit__(
+        self,
+        exc_type: type[BaseException] | None,
+        exc_value: BaseException | None,
+        traceback: TracebackType | None,
+    ) -> bool | None: ...
+
+class PipeDispatcher(AbstractContextManager[PipeDispatcher]):
+    def __init__(
+        self,
+        workers: Iterable[PipeConnection],
+        policy: Literal[
+            "round_robin", "least_outstanding", "least_bytes"
+        ] = "least_outstanding",
+    ) -> None: ...
+    def submit(self, buffer: Buffer) -> int: ...
+    def submit_many(self, buffers: Iterable[Buffer]) -> list[int]: ...
+    def recv_results(
+        self, max_count: int | None = None, timeout: float | None = None
+    ) -> list[tuple[int, bytes | None]]: ...
+    def close(self) -> None: ...
+    @property
+    def workers(self) -> list[PipeConnection]: ...
+    @property
+    def policy(self) -> str: ...
+    @property
+    def outstanding(self) -> int: ...
+    def stats(self) -> list[dict[str, Any]]: ...
+    def __enter__(self) -> Self: ...
+    def __exit__(
+        self,
+        exc_type: type[BaseException] | None,
+        exc_value: BaseException | None,
+        traceback: TracebackType | None,
+    ) -> bool | None: ...
+
+def PipeClient(
+    address: str, buffer_size: int = 8192, adaptive_buffer: bool = False
+) -> PipeConnection: ...
+def wait(
+    object_list: Iterable[PipeConnection | PipeListener],
+    timeout: float | None = None,
+) -> list[PipeConnection | PipeListener]: ...
+def set_reactor_threads(count: int) -> None: ...
+def get_reactor_threads() -> int: ...
@@ -0,0 +1,56 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Implementation of ``PipeConnection.send_file()``.
+
+The file region is memory-mapped read-only and the mapping is sent like any
+other buffer, so the data goes from the page cache to the pipe without being
+copied into Python objects. ``sendfile()`` and ``splice()`` would split a
+message into records at page boundaries, which does not work with the message
+framing of ``SOCK_SEQPACKET``, and named pipes have no such primitive either.
+"""
+
+import os
+import sys
+import typing
+
+from win32_pipes._ext import FileMapping
+from win32_pipes._stream import send_stream
+
+if typing.TYPE_CHECKING:
+    from win32_pipes._ext import PipeConnection
+
+
+def _map(fd: int, offset: int, count: typing.Optional[int]) -> FileMapping:
+    if sys.platform == "win32":
+        import msvcrt
+
+        return FileMapping(msvcrt.get_osfhandle(fd), offset, count)
+    return FileMapping(fd, offset, count)
+
+
+def send_file(
+    conn: "PipeConnection",
+    file: typing.Any,
+    offset: int,
+    count: typing.Optional[int],
+    chunk_size: typing.Optional[int],
+    window: int,
+    blocking: bool,
+) -> int:
+    if isinstance(file, int):
+        mapping = _map(file, offset, count)
+    else:
+        fd = os.open(file, os.O_RDONLY | getattr(os, "O_BINARY", 0))
+        try:
+            mapping = _map(fd, offset, count)
+        finally:
+            # the mapping does not need the descriptor
+            os.close(fd)
+
+    if chunk_size is None:
+        # one message, the mapping stays pinned until it was written
+        conn.send_bytes(mapping, blocking=blocking)
+        return len(mapping)
+    return send_stream(conn, mapping, chunk_size, window)
@@ -0,0 +1,96 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Implementation of ``PipeConnection.send()`` and ``PipeConnection.recv()``.
+
+Objects are pickled with protocol 5. Contiguous buffers of at least
+``_MIN_OUT_OF_BAND`` bytes (numpy arrays, bytearrays, ...) are taken out of the
+pickle stream through ``buffer_callback`` and sent as frames straight from
+their memory. A logical message with frames is sent as consecutive pipe
+messages with a single ``send_bytes_many()`` call:
+
+- a header: ``_MAGIC``, the frame count and the size of every frame
+- the pickle stream
+- one message per out-of-band buffer
+
+The receiver allocates a single bytearray for all frames, receives them into
+it and unpickles the object from views of it. Without out-of-band buffers only
+the pickle stream is sent, like ``multiprocessing.connection.Connection.send()``
+does, so both ends can be mixed with ``send_bytes()`` and ``recv_bytes()``.
+"""
+
+import io
+import pickle
+import struct
+import typing
+from multiprocessing.reduction import ForkingPickler
+
+if typing.TYPE_CHECKING:
+    from win32_pipes._ext import PipeConnection
+
+# pickle streams of protocol 2 and later start with the PROTO opcode b"\x80"
+_MAGIC = b"\x00WPF"
+_COUNT = struct.Struct("<4sQ")
+_SIZE = struct.Struct("<Q")
+
+# smaller buffers are cheaper to copy into the pickle stream than to send
+_MIN_OUT_OF_BAND = 4096
+
+
+def send(conn: "PipeConnection", obj: typing.Any) -> None:
+    frames: typing.List[memoryview] = []
+
+    def buffer_callback(buffer: pickle.PickleBuffer) -> bool:
+        raw = buffer.raw()
+        if raw.nbytes < _MIN_OUT_OF_BAND:
+            return True  # in-band
+        frames.append(raw)
+        return False
+
+    stream = io.BytesIO()
+    pickler = pickle.Pickler(stream, 5, buffer_callback=buffer_callback)
+    # ForkingPickler does not take a buffer_callback, but its reducers are
+    # needed for connections, sockets, ...
+    pickler.dispatch_table = ForkingPickler(stream).dispatch_table
+    pickler.dump(obj)
+    with stream.getbuffer() as data:
+        if not frames:
+            conn.send_bytes(data)
+            return
+        header = bytearray(_COUNT.pack(_MAGIC, len(frames) + 1))
+        header += _SIZE.pack(data.nbytes)
+        for frame in frames:
+            header += _SIZE.pack(frame.nbytes)
+        try:
+            # blocking, so the buffers are not modified while they are sent
+            conn.send_bytes_many([header, data, *frames])
+        finally:
+            for frame in frames:
+                frame.release()
+
+
+def recv(conn: "PipeConnection") -> typing.Any:
+    header = conn.recv_bytes()
+    if not header.startswith(_MAGIC):
+        return ForkingPickler.loads(header)
+
+    _, count = _COUNT.unpack_from(header)
+    sizes = [
+        _SIZE.unpack_from(header, _COUNT.size + i * _SIZE.size)[0]
+        for i in range(count)
+    ]
+    # one allocation for the pickle stream and all out-of-band buffers
+    data = memoryview(bytearray(sum(sizes)))
+    views = []
+    offset = 0
+    for size in sizes:
+        view = data[offset : offset + size]
+        received = conn.recv_bytes_into(view)
+        if received != size:
+            raise pickle.UnpicklingError(
+                f"frame of {received} bytes received, {size} bytes expected"
+            )
+        views.append(view)
+        offset += size
+    return pickle.loads(views[0], buffers=views[1:])
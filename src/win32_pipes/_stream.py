@@ -0,0 +1,226 @@
+# SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT
+
+"""Implementation of ``PipeConnection.send_stream()`` and ``recv_stream()``.
+
+A stream is a sequence of pipe messages, so neither side needs the whole
+payload in memory. Every chunk is preceded by a control message, which is sent
+with it in one ``send_bytes_many()`` call:
+
+- ``_MAGIC b"D" size``: a data chunk of ``size`` bytes follows
+- ``_MAGIC b"E" total``: the end of the stream, after ``total`` bytes
+- ``_MAGIC b"A" 0 reason``: the sender failed, the stream is incomplete
+
+The sender keeps at most ``window`` bytes of chunks in flight: a chunk, which
+would exceed it, is sent blocking and so waits for all earlier writes. The
+receiver sets an Rx limit of ``window`` bytes while the stream is read, unless
+the connection has an Rx limit already, so the I/O thread stops reading ahead.
+"""
+
+import io
+import struct
+import typing
+
+if typing.TYPE_CHECKING:
+    from win32_pipes._ext import PipeConnection
+
+_MAGIC = b"\x00WPS"
+_CONTROL = struct.Struct("<4scQ")
+_DATA = b"D"
+_END = b"E"
+_ABORT = b"A"
+
+CHUNK_SIZE = 1024 * 1024
+WINDOW = 8 * 1024 * 1024
+
+
+def _chunks(source: typing.Any, chunk_size: int) -> typing.Iterator[typing.Any]:
+    """Split the source into buffers of at most ``chunk_size`` bytes."""
+    if hasattr(source, "readinto"):
+        while True:
+            # a new buffer per chunk, the previous ones might still be in flight
+            buffer = bytearray(chunk_size)
+            size = source.readinto(buffer)
+            if not size:
+                return
+            yield memoryview(buffer)[:size]
+    elif hasattr(source, "read"):
+        while True:
+            data = source.read(chunk_size)
+            if not data:
+                return
+            yield data
+    else:
+        try:
+            buffers = [memoryview(source)]
+        except TypeError:
+            buffers = source  # an iterable of buffers
+        for data in buffers:
+            view = memoryview(data).cast("B")
+            for offset in range(0, view.nbytes, chunk_size):
+                yield view[offset : offset + chunk_size]
+
+
+def _send_chunk(
+    conn: "PipeConnection", chunk: typing.Any, size: int, window: int
+) -> None:
+    # writes complete in order, so a blocking write drains the window
+    blocking = conn.tx_inflight_bytes + size > window
+    messages = [_CONTROL.pack(_MAGIC, _DATA, size), chunk]
+    try:
+        conn.send_bytes_many(messages, blocking=blocking)
+    except BlockingIOError:
+        # the Tx limit of the connection was reached, nothing was sent
+        conn.send_bytes_many(messages)
+
+
+def send_stream(
+    conn: "PipeConnection",
+    source: typing.Any,
+    chunk_size: int = CHUNK_SIZE,
+    window: int = WINDOW,
+) -> int:
+    if chunk_size <= 0:
+        raise ValueError("chunk_size must be greater than 0")
+    total = 0
+    sending = False
+    try:
+        for chunk in _chunks(source, chunk_size):
+            size = chunk.nbytes if isinstance(chunk, memoryview) else len(chunk)
+            if size == 0:
+                continue
+            sending = True
+            _send_chunk(conn, chunk, size, window)
+            sending = False
+            total += size
+    except BaseException as exc:
+        if not (sending and isinstance(exc, OSError)):
+            # the connection still works, tell the receiver
+            reason = f"{type(exc).__name__}: {exc}".encode(errors="replace")
+            conn.send_bytes(_CONTROL.pack(_MAGIC, _ABORT, 0) + reason)
+        raise
+    conn.send_bytes(_CONTROL.pack(_MAGIC, _END, total))
+    return total
+
+
+class StreamReader(io.RawIOBase):
+    """Readable file object of a stream, which is received chunk by chunk.
+
+    Iterating over it yields the chunks as ``bytes``, as they arrive.
+    ``close()`` discards the rest of the stream, so the connection can be
+    used for further messages.
+    """
+
+    def __init__(self, conn: "PipeConnection", window: int) -> None:
+        super().__init__()
+        self._conn = conn
+        self._pending = memoryview(b"")
+        self._received = 0
+        self._done = False
+        self._limited = conn.max_rx_queued_bytes is None
+        if self._limited:
+            conn.set_rx_limit(window)
+
+    def readable(self) -> bool:
+        return True
+
+    def readinto(self, buffer: typing.Any) -> int:
+        self._checkClosed()
+        with memoryview(buffer) as view, view.cast("B") as target:
+            if target.nbytes == 0:
+                return 0
+            if not self._pending:
+                size = self._next_chunk_size()
+                if size is None:
+                    return 0
+                if size <= target.nbytes:
+                    # straight into the caller's buffer
+                    self._receive_into(target, size)
+                    return size
+                self._pending = memoryview(self._receive(size))
+            size = min(target.nbytes, self._pending.nbytes)
+            target[:size] = self._pending[:size]
+            self._pending = self._pending[size:]
+            return size
+
+    def __iter__(self) -> "StreamReader":
+        return self
+
+    def __next__(self) -> bytes:
+        self._checkClosed()
+        if self._pending:
+            chunk = self._pending.tobytes()
+            self._pending = memoryview(b"")
+            return chunk
+        size = self._next_chunk_size()
+        if size is None:
+            raise StopIteration
+        return self._receive(size)
+
+    def close(self) -> None:
+        if not self.closed:
+            try:
+                self._pending = memoryview(b"")
+                size = self._next_chunk_size()
+                while size is not None:
+                    self._receive(size)
+                    size = self._next_chunk_size()
+            except EOFError:
+                pass  # aborted by the sender, nothing left to discard
+            finally:
+                super().close()
+
+    def __del__(self) -> None:
+        # an abandoned reader must not block the garbage collector, the
+        # rest of the stream is left on the connection
+        self._done = True
+        self._finish()
+        super().__del__()
+
+    @property
+    def bytes_received(self) -> int:
+        return self._received
+
+    def _receive(self, size: int) -> bytes:
+        chunk = self._conn.recv_bytes()
+        if len(chunk) != size:
+            raise OSError(f"chunk of {len(chunk)} bytes received, {size} expected")
+        self._received += size
+        return chunk
+
+    def _receive_into(self, target: memoryview, size: int) -> None:
+        received = self._conn.recv_bytes_into(target)
+        if received != size:
+            raise OSError(f"chunk of {received} bytes received, {size} expected")
+        self._received += size
+
+    def _next_chunk_size(self) -> typing.Optional[int]:
+        """Receive the next control message, None at the end of the stream."""
+        if self._done:
+            return None
+        control = self._conn.recv_bytes()
+        if len(control) < _CONTROL.size or not control.startswith(_MAGIC):
+            raise OSError("message is not part of a stream")
+        _, kind, value = _CONTROL.unpack_from(control)
+        if kind == _DATA:
+            return value
+        self._done = True
+        self._finish()
+        if kind == _ABORT:
+            reason = control[_CONTROL.size :].decode(errors="replace")
+            raise EOFError(f"stream aborted by the sender: {reason}")
+        if value != self._received:
+            raise OSError(f"stream of {value} bytes, {self._received} received")
+        return None
+
+    def _finish(self) -> None:
+        if self._limited:
+            self._limited = False
+            self._conn.set_rx_limit(None)
+
+
+def recv_stream(conn: "PipeConnection", window: int = WINDOW) -> StreamReader:
+    if window <= 0:
+        raise ValueError("window must be greater than 0")
+    return StreamReader(conn, window)
@@ -0,0 +1,24 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Aborts the test with the failed expression, also in release builds
+#define CHECK(expr)                                                            \
+    do {                                                                       \
+        if (!(expr)) {                                                         \
+            std::fprintf(stderr,                                               \
+                         "%s:%d: CHECK(%s) failed\n",                          \
+                         __FILE__,                                             \
+                         __LINE__,                                             \
+                         #expr);                                               \
+            std::abort();                                                      \
+        }                                                                      \
+    } while (0)
+
+#endif
@@ -0,0 +1,83 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include <chrono>
+#include <cstdio>
+
+#include "BusyPoll.h"
+#include "check.h"
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+
+static auto testDisabled() -> void
+{
+    AdaptiveSpin spin;
+    CHECK(spin.budget(microseconds(0)) == nanoseconds(0));
+    spin.record(microseconds(10), microseconds(0));
+    CHECK(spin.getAverage() == nanoseconds(0));
+}
+
+static auto testFollowsWaits() -> void
+{
+    const auto   limit = microseconds(100);
+    AdaptiveSpin spin;
+
+    // without history the receiver spins for MIN_SPIN
+    CHECK(spin.budget(limit) == AdaptiveSpin::MIN_SPIN);
+
+    // short waits: twice the average, at least MIN_SPIN
+    for (int i = 0; i < 100; i++)
+        spin.record(microseconds(1), limit);
+    CHECK(spin.getAverage() <= microseconds(1));
+    CHECK(spin.budget(limit) == AdaptiveSpin::MIN_SPIN);
+
+    for (int i = 0; i < 100; i++)
+        spin.record(microseconds(20), limit);
+    CHECK(spin.getAverage() > microseconds(19));
+    CHECK(spin.budget(limit) > microseconds(38));
+    CHECK(spin.budget(limit) <= microseconds(40));
+
+    // never more than the limit
+    for (int i = 0; i < 100; i++)
+        spin.record(microseconds(90), limit);
+    CHECK(spin.budget(limit) == limit);
+}
+
+static auto testSlowPeer() -> void
+{
+    const auto   limit = microseconds(50);
+    AdaptiveSpin spin;
+
+    // waits beyond the limit stop the spinning
+    for (int i = 0; i < 100; i++)
+        spin.record(milliseconds(10), limit);
+    CHECK(spin.getAverage() <= 4 * limit);
+    CHECK(spin.budget(limit) == nanoseconds(0));
+
+    // fast messages bring it back after a few messages
+    int count = 0;
+    while (spin.budget(limit) == nanoseconds(0)) {
+        spin.record(microseconds(5), limit);
+        count++;
+    }
+    CHECK(count <= 16);
+
+    // a single idle period does not stop it
+    for (int i = 0; i < 100; i++)
+        spin.record(microseconds(5), limit);
+    spin.record(seconds(1), limit);
+    CHECK(spin.budget(limit) > nanoseconds(0));
+}
+
+auto main() -> int
+{
+    testDisabled();
+    testFollowsWaits();
+    testSlowPeer();
+    std::printf("OK\n");
+    return 0;
+}
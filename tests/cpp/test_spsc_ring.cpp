@@ -0,0 +1,103 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "SpscRing.h"
+#include "check.h"
+
+static auto testTransitions() -> void
+{
+    SpscRing<int> ring{3};
+    bool          wasEmpty{false};
+    bool          wasFull{false};
+    bool          isEmpty{false};
+    int           value{0};
+
+    CHECK(ring.empty());
+    CHECK(!ring.pop(value));
+    CHECK(ring.front() == nullptr);
+
+    CHECK(ring.push(1, &wasEmpty) && wasEmpty);
+    CHECK(ring.push(2, &wasEmpty) && !wasEmpty);
+    CHECK(ring.push(3, &wasEmpty) && !wasEmpty);
+    CHECK(ring.size() == 3);
+
+    // full ring leaves the value untouched
+    auto rejected = 4;
+    CHECK(!ring.push(std::move(rejected)));
+    CHECK(rejected == 4);
+
+    CHECK(*ring.front() == 1);
+    CHECK(ring.pop(value, &wasFull, &isEmpty));
+    CHECK(value == 1 && wasFull && !isEmpty);
+    CHECK(ring.pop(value, &wasFull, &isEmpty));
+    CHECK(value == 2 && !wasFull && !isEmpty);
+    CHECK(ring.pop(value, &wasFull, &isEmpty));
+    CHECK(value == 3 && !wasFull && isEmpty);
+    CHECK(ring.empty());
+}
+
+static auto testWrapAround() -> void
+{
+    SpscRing<int> ring{4};
+    int           next{0};
+    int           expected{0};
+    int           value{0};
+
+    // the indices wrap many times with varying fill levels
+    for (int round = 0; round < 1000; round++) {
+        for (int i = 0; i < round % 4 + 1; i++)
+            CHECK(ring.push(next++));
+        while (ring.pop(value))
+            CHECK(value == expected++);
+    }
+    CHECK(next == expected);
+}
+
+static auto testMoveOnly() -> void
+{
+    SpscRing<std::unique_ptr<int>> ring{2};
+    std::unique_ptr<int>           value;
+
+    CHECK(ring.push(std::make_unique<int>(42)));
+    CHECK(ring.pop(value));
+    CHECK(value && *value == 42);
+}
+
+static auto testThreads() -> void
+{
+    // a small capacity makes both sides hit the full and empty states often
+    const int                      count = 1000000;
+    SpscRing<std::shared_ptr<int>> ring{64};
+
+    std::thread producer([&] {
+        for (int i = 0; i < count; i++) {
+            auto value = std::make_shared<int>(i);
+            while (!ring.push(std::move(value)))
+                std::this_thread::yield();
+        }
+    });
+
+    std::shared_ptr<int> value;
+    for (int i = 0; i < count; i++) {
+        while (!ring.pop(value))
+            std::this_thread::yield();
+        CHECK(*value == i);
+    }
+    producer.join();
+    CHECK(ring.empty());
+}
+
+auto main() -> int
+{
+    testTransitions();
+    testWrapAround();
+    testMoveOnly();
+    testThreads();
+    std::printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+/* SPDX-FileCopyrightText: 2024-present Artur Drogunow <artur.drogunow@zf.com>
+#
+# SPDX-License-Identifier: MIT */
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "Stats.h"
+#include "check.h"
+
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+
+static auto testBuckets() -> void
+{
+    CHECK(LatencyHistogram::bucket(nanoseconds(-5)) == 0);
+    CHECK(LatencyHistogram::bucket(nanoseconds(999)) == 0);
+    CHECK(LatencyHistogram::bucket(microseconds(1)) == 1);
+    CHECK(LatencyHistogram::bucket(microseconds(2)) == 2);
+    CHECK(LatencyHistogram::bucket(microseconds(3)) == 2);
+    CHECK(LatencyHistogram::bucket(microseconds(4)) == 3);
+    CHECK(LatencyHistogram::bucket(microseconds(1023)) == 10);
+    CHECK(LatencyHistogram::bucket(microseconds(1024)) == 11);
+
+    // everything beyond the range lands in the last bucket
+    CHECK(LatencyHistogram::bucket(seconds(1000000)) ==
+          LatencyHistogram::BUCKETS - 1);
+}
+
+static auto testHistogram() -> void
+{
+    LatencyHistogram histogram;
+    histogram.record(nanoseconds(10));
+    histogram.record(microseconds(5));
+    histogram.record(microseconds(6));
+
+    auto counts = histogram.counts();
+    CHECK(counts.size() == LatencyHistogram::BUCKETS);
+    CHECK(counts[0] == 1 && counts[3] == 2);
+
+    histogram.reset();
+    for (auto count : histogram.counts())
+        CHECK(count == 0);
+}
+
+static auto testCounters() -> void
+{
+    ConnectionStats stats;
+    stats.txMessages.add();
+    stats.txBytes.add(100);
+    stats.txQueuePeak.observe(3);
+    stats.txQueuePeak.observe(1);
+    stats.rxQueuePeak.observe(7);
+    CHECK(stats.txMessages.get() == 1 && stats.txBytes.get() == 100);
+    CHECK(stats.txQueuePeak.get() == 3 && stats.rxQueuePeak.get() == 7);
+
+    // the peaks restart at the current queue depths
+    stats.reset(2, 0);
+    CHECK(stats.txMessages.get() == 0 && stats.txBytes.get() == 0);
+    CHECK(stats.txQueuePeak.get() == 2 && stats.rxQueuePeak.get() == 0);
+}
+
+static auto testThreads() -> void
+{
+    // the I/O thread and a caller update their counters concurrently,
+    // while a third thread reads them
+    const int       count = 1000000;
+    ConnectionStats stats;
+
+    std::thread io([&] {
+        for (int i = 0; i < count; i++) {
+            stats.rxMessages.add();
+            stats.rxQueuePeak.observe(static_cast<uint64_t>(i % 100));
+        }
+    });
+    std::thread caller([&] {
+        for (int i = 0; i < count; i++) {
+            stats.txMessages.add();
+            stats.rxResidency.record(nanoseconds(i));
+        }
+    });
+    while (stats.rxMessages.get() < count || stats.txMessages.get() < count)
+        stats.rxResidency.counts();
+    io.join();
+    caller.join();
+
+    uint64_t recorded{0};
+    for (auto value : stats.rxResidency.counts())
+        recorded += value;
+    CHECK(recorded == count);
+    CHECK(stats.rxQueuePeak.get() == 99);
+}
+
+auto main() -> int
+{
+    testBuckets();
+    testHistogram();
+    testCounters();
+    testThreads();
+    std::printf("OK\n");
+    return 0;
+}
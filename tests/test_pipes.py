@@ -1,7 +1,14 @@
+import array
+import asyncio
+import ctypes
+import io
 import multiprocessing
 import os
+import pickle
 import platform
 import re
+import sys
+import sysconfig
 import time
 from concurrent.futures import ThreadPoolExecutor
 from typing import List
@@ -20,6 +27,8 @@ def test_module():
     assert hasattr(win32_pipes, "PipeClient")
     assert hasattr(win32_pipes, "PipeListener")
     assert hasattr(win32_pipes, "generate_pipe_address")
+    assert hasattr(win32_pipes, "set_reactor_threads")
+    assert hasattr(win32_pipes, "wait")
 
 
 def test_duplex():
@@ -103,6 +112,964 @@ def test_non_duplex():
     assert c2.closed
 
 
+def test_send_bytes_buffer_protocol():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        data = bytearray(range(256)) * 4096
+        tx.send_bytes(data, blocking=False)
+        tx.send_bytes(memoryview(data)[16:32])
+        tx.send_bytes(array.array("I", [1, 2, 3]), 4, 4)
+        tx.send_bytes((ctypes.c_char * 5).from_buffer_copy(b"Hello"))
+        assert rx.recv_bytes() == data
+        assert rx.recv_bytes() == data[16:32]
+        assert rx.recv_bytes() == array.array("I", [2]).tobytes()
+        assert rx.recv_bytes() == b"Hello"
+
+        with pytest.raises(BufferError):
+            tx.send_bytes(memoryview(data)[::2])
+        with pytest.raises(TypeError):
+            tx.send_bytes("str")
+
+
+def test_send_bytes_many():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        # small messages are gathered, large ones span several writes
+        messages = [bytes([i]) * (i + 1) for i in range(200)]
+        messages.append(bytearray(range(256)) * 1024)
+        messages.append(memoryview(b"last"))
+        tx.send_bytes_many(messages, blocking=False)
+        for message in messages:
+            assert rx.recv_bytes() == message
+
+        tx.send_bytes_many(b"%d" % i for i in range(10))
+        assert [rx.recv_bytes() for _ in range(10)] == [
+            b"%d" % i for i in range(10)
+        ]
+
+        # invalid elements are rejected before anything is sent
+        with pytest.raises(ValueError, match="buffer is empty"):
+            tx.send_bytes_many([b"a", b""])
+        with pytest.raises(TypeError):
+            tx.send_bytes_many([b"a", "str"])
+        tx.send_bytes_many([])
+        assert rx.recv_bytes(blocking=False) is None
+
+
+def test_send_queue_full():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        # nobody receives, so the I/O threads stall and the send queue fills
+        message = b"x" * 1024
+        sent = 0
+        for _ in range(2):
+            with pytest.raises(BlockingIOError, match="send queue is full"):
+                while True:
+                    tx.send_bytes(message, blocking=False)
+                    sent += 1
+            time.sleep(0.1)  # the I/O threads settle, retry until full again
+        assert sent >= 4096
+        assert tx.tx_queued == 4096
+
+        # a non-blocking batch is sent as a whole or not at all
+        with pytest.raises(BlockingIOError):
+            tx.send_bytes_many([message, message], blocking=False)
+        with pytest.raises(ValueError, match="must fit into the send queue"):
+            tx.send_bytes_many([message] * 4097, blocking=False)
+
+        for _ in range(sent):
+            assert rx.recv_bytes() == message
+        tx.send_bytes_many([message, message], blocking=False)
+        assert [rx.recv_bytes(), rx.recv_bytes()] == [message, message]
+
+
+def test_recv_bytes_many():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        assert rx.recv_bytes_many(timeout=0) == []  # starts the I/O thread
+        tx.send_bytes_many([b"%d" % i for i in range(5)])
+        time.sleep(0.1)
+        assert rx.recv_bytes_many(max_count=3) == [b"0", b"1", b"2"]
+        assert rx.recv_bytes_many() == [b"3", b"4"]
+
+        t0 = time.perf_counter()
+        assert rx.recv_bytes_many(timeout=0.1) == []
+        assert time.perf_counter() - t0 >= 0.09
+
+        with pytest.raises(ValueError, match="max_count"):
+            rx.recv_bytes_many(max_count=0)
+
+
+def test_recv_bytes_into():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        buffer = bytearray(10)
+        tx.send_bytes(b"Hello", blocking=False)
+        assert rx.recv_bytes_into(buffer, 2) == 5
+        assert buffer == b"\0\0Hello\0\0\0"
+        assert rx.recv_bytes_into(buffer, blocking=False) is None
+
+        # any writable buffer is accepted
+        array = (ctypes.c_uint8 * 4)()
+        tx.send_bytes(b"\x01\x02\x03\x04")
+        assert rx.recv_bytes_into(memoryview(array)) == 4
+        assert list(array) == [1, 2, 3, 4]
+
+        # the message is consumed and attached to the exception
+        tx.send_bytes(b"x" * 20)
+        with pytest.raises(multiprocessing.BufferTooShort) as exc_info:
+            rx.recv_bytes_into(buffer)
+        assert exc_info.value.args[0] == b"x" * 20
+
+        with pytest.raises(ValueError):
+            rx.recv_bytes_into(buffer, 11)
+        with pytest.raises(BufferError):
+            rx.recv_bytes_into(b"read-only")
+
+
+def test_send_recv():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        # without out-of-band buffers like multiprocessing.Connection.send()
+        tx.send({"a": [1, 2.5, "three"]})
+        assert pickle.loads(rx.recv_bytes()) == {"a": [1, 2.5, "three"]}
+        tx.send_bytes(pickle.dumps((1, 2)))
+        assert rx.recv() == (1, 2)
+
+        # large PickleBuffers (numpy arrays, ...) are sent out-of-band
+        large = bytearray(range(256)) * 4096
+        tx.send(
+            {
+                "large": pickle.PickleBuffer(large),
+                "read-only": pickle.PickleBuffer(bytes(large[:8192])),
+                "small": pickle.PickleBuffer(b"in-band"),
+            }
+        )
+        obj = rx.recv()
+        assert obj["large"] == large
+        assert not obj["large"].readonly
+        assert obj["read-only"] == large[:8192]
+        assert obj["read-only"].readonly
+        assert obj["small"] == b"in-band"
+        # the frames share one allocation
+        assert obj["large"].obj is obj["read-only"].obj
+
+        with pytest.raises(pickle.PicklingError):
+            tx.send(lambda: None)
+
+
+def test_stream():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        data = os.urandom(1024 * 1024) * 16
+        chunk_size, window = 256 * 1024, 1024 * 1024
+        received = bytearray()
+        with ThreadPoolExecutor(1) as executor, rx.recv_stream(window) as reader:
+            assert rx.max_rx_queued_bytes == window
+            sent = executor.submit(
+                tx.send_stream, io.BytesIO(data), chunk_size, window
+            )
+            buffer = bytearray(100_000)
+            while size := reader.readinto(buffer):
+                # the I/O thread does not read far ahead
+                assert rx.rx_queued_bytes <= window + 2 * chunk_size
+                received += buffer[:size]
+            assert sent.result() == len(data)
+        assert received == data
+        assert rx.max_rx_queued_bytes is None
+
+        # iterables are split into chunks, which are yielded as they arrive
+        tx.send_stream([b"abc", memoryview(data)[:10]], chunk_size=4)
+        assert list(rx.recv_stream()) == [b"abc", data[:4], data[4:8], data[8:10]]
+
+        # close() discards the rest of the stream
+        tx.send_stream(data[:100], chunk_size=10)
+        tx.send_bytes(b"next")
+        with rx.recv_stream() as reader:
+            assert reader.read(5) == data[:5]
+        assert rx.recv_bytes() == b"next"
+
+        def failing():
+            yield b"partial"
+            raise KeyError("source failed")
+
+        with pytest.raises(KeyError):
+            tx.send_stream(failing())
+        with pytest.raises(EOFError, match="source failed"):
+            rx.recv_stream().read()
+
+
+def test_send_file(tmp_path):
+    path = tmp_path / "data.bin"
+    data = os.urandom(300_000)
+    path.write_bytes(data)
+
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        # the whole file as one message
+        assert tx.send_file(path) == len(data)
+        assert rx.recv_bytes() == data
+
+        # an unaligned region of an open file
+        with open(path, "rb") as file:
+            assert tx.send_file(file.fileno(), 5000, 100_000) == 100_000
+        assert rx.recv_bytes() == data[5000:105_000]
+
+        # a stream of chunks
+        assert tx.send_file(path, 1, chunk_size=65536) == len(data) - 1
+        assert b"".join(rx.recv_stream()) == data[1:]
+
+        with pytest.raises(ValueError):
+            tx.send_file(path, len(data))
+        with pytest.raises(ValueError):
+            tx.send_file(path, 1, len(data))
+        with pytest.raises(FileNotFoundError):
+            tx.send_file(tmp_path / "missing.bin")
+
+
+def test_rx_buffer_reuse():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        messages = [b"s" * 100, b"m" * 70_000, b"b" * (3 << 20)]
+        buffer = bytearray(3 << 20)
+
+        def roundtrip():
+            for msg in messages:
+                tx.send_bytes(msg)
+                assert rx.recv_bytes_into(buffer) == len(msg)
+                tx.send_bytes(msg)
+                assert rx.recv_bytes() == msg
+
+        for _ in range(5):
+            roundtrip()
+        allocations = rx.rx_buffer_allocations
+
+        # steady state receive must not allocate
+        for _ in range(100):
+            roundtrip()
+        assert rx.rx_buffer_allocations == allocations
+
+
+def test_pools():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        assert tx.pool_limits == {
+            "tx_count": 64,
+            "rx_count": 16,
+            "rx_bytes": 32 * 1024 * 1024,
+        }
+        messages = [b"s" * 100, b"m" * 70_000, b"l" * 300_000]
+
+        def roundtrip():
+            for msg in messages:
+                tx.send_bytes(msg, blocking=False)
+                tx.send_bytes(msg, blocking=False, priority=2)
+                tx.send_bytes_many([msg, msg], blocking=False)
+            # the priority 2 writes may be overtaken
+            received = [rx.recv_bytes() for _ in range(4 * len(messages))]
+            assert sorted(received) == sorted(messages * 4)
+
+        for _ in range(20):
+            roundtrip()
+        tx_allocations = tx.tx_write_allocations
+        rx_allocations = rx.rx_buffer_allocations
+
+        # Steady state sends and receives reuse the pooled objects. A few are
+        # allocated, when more writes than before are in flight.
+        for _ in range(100):
+            roundtrip()
+        count = 100 * 4 * len(messages)
+        assert tx.tx_write_allocations - tx_allocations < 0.02 * count
+        assert rx.rx_buffer_allocations - rx_allocations < 0.02 * count
+
+        # without a pool every write allocates
+        tx.set_pool_limits(tx_count=0)
+        tx_allocations = tx.tx_write_allocations
+        for _ in range(10):
+            tx.send_bytes(b"x")
+            assert rx.recv_bytes() == b"x"
+        assert tx.tx_write_allocations == tx_allocations + 10
+
+        rx.set_pool_limits(rx_count=64, rx_bytes=1 << 20)
+        assert rx.pool_limits == {
+            "tx_count": 64,
+            "rx_count": 64,
+            "rx_bytes": 1 << 20,
+        }
+
+
+def test_buffer_size():
+    with pytest.raises(ValueError):
+        win32_pipes.Pipe(buffer_size=0)
+
+    rx, tx = win32_pipes.Pipe(duplex=False, buffer_size=256 * 1024)
+    with rx, tx:
+        assert rx.buffer_size == rx.rx_buffer_size == 256 * 1024
+        assert not rx.adaptive_buffer
+        for size in (100, 200_000, 1 << 20):
+            tx.send_bytes(b"x" * size)
+            assert rx.recv_bytes() == b"x" * size
+        assert rx.rx_buffer_size == 256 * 1024
+
+    rx, tx = win32_pipes.Pipe(duplex=False, adaptive_buffer=True)
+    with rx, tx:
+        assert rx.adaptive_buffer
+        assert rx.rx_buffer_size == 8192
+
+        # the posted buffer grows to the size of the messages...
+        for _ in range(64):
+            tx.send_bytes(b"l" * 100_000)
+            assert rx.recv_bytes() == b"l" * 100_000
+        assert rx.rx_buffer_size == 128 * 1024
+
+        # ...and shrinks again, when they become small
+        for _ in range(256):
+            tx.send_bytes(b"s" * 100)
+            assert rx.recv_bytes() == b"s" * 100
+        assert rx.rx_buffer_size == 4096
+
+    address = win32_pipes.generate_pipe_address()
+    with win32_pipes.PipeListener(
+        address, buffer_size=65536, adaptive_buffer=True
+    ) as listener:
+        client = win32_pipes.PipeClient(address, buffer_size=16384)
+        server = listener.accept()
+        with client, server:
+            assert server.buffer_size == 65536 and server.adaptive_buffer
+            assert client.buffer_size == 16384 and not client.adaptive_buffer
+
+
+def test_busy_poll():
+    c1, c2 = win32_pipes.Pipe()
+    with c1, c2:
+        assert c1.busy_poll_us == 0
+        with pytest.raises(ValueError):
+            c1.busy_poll_us = 2_000_000
+        with pytest.raises(ValueError):
+            c1.recv_bytes(busy_poll_us=2_000_000)
+        c1.busy_poll_us = 100
+        assert c1.busy_poll_us == 100
+
+        def echo() -> None:
+            for _ in range(1000):
+                c2.send_bytes(c2.recv_bytes(busy_poll_us=50))
+
+        with ThreadPoolExecutor(1) as executor:
+            future = executor.submit(echo)
+            for i in range(1000):
+                c1.send_bytes(i.to_bytes(4, "little"))
+                assert c1.recv_bytes() == i.to_bytes(4, "little")
+            future.result()
+
+        # the spinning receiver still notices a closed peer
+        c1.busy_poll_us = 1_000_000
+        with ThreadPoolExecutor(1) as executor:
+            executor.submit(lambda: (time.sleep(0.1), c2.close()))
+            with pytest.raises(OSError):
+                c1.recv_bytes()
+
+
+def test_shared_memory():
+    rx, tx = win32_pipes.Pipe(
+        duplex=False, shared_memory_size=1 << 20, shared_memory_threshold=1024
+    )
+    with rx, tx:
+        rx_handle, tx_handle, threshold = rx.shared_memory
+        assert rx_handle is not None and tx_handle is None
+        assert threshold == 1024
+
+        # small messages, descriptor sized ones and ring payloads interleave
+        messages = [b"small", bytes(range(32)), b"a" * 4096, b"b" * 100_000]
+        for message in messages:
+            tx.send_bytes(message, blocking=False)
+        for message in messages:
+            assert rx.recv_bytes() == message
+
+        # the view keeps its part of the ring until it is released
+        tx.send_bytes(b"c" * 600_000)
+        view = rx.recv_bytes_view()
+        assert view.readonly
+        assert view == b"c" * 600_000
+        tx.send_bytes(b"d" * 600_000)  # does not fit, sent through the pipe
+        assert rx.recv_bytes_view() == b"d" * 600_000
+        view.release()
+
+        # larger than the whole ring
+        tx.send_bytes(b"e" * (2 << 20))
+        buffer = bytearray(2 << 20)
+        assert rx.recv_bytes_into(buffer) == 2 << 20
+        assert buffer == b"e" * (2 << 20)
+
+        for _ in range(100):
+            tx.send_bytes(b"f" * 300_000)
+            assert rx.recv_bytes() == b"f" * 300_000
+
+    with pytest.raises(ValueError):
+        win32_pipes.Pipe(shared_memory_size=16)
+
+
+def _echo_from_subprocess(c: win32_pipes.PipeConnection):
+    with c:
+        c.send_bytes(c.recv_bytes())
+        time.sleep(0.5)
+
+
+def test_shared_memory_multiprocessing():
+    c1, c2 = win32_pipes.Pipe(shared_memory_size=1 << 20)
+    with c1:
+        p = multiprocessing.Process(target=_echo_from_subprocess, args=(c2,))
+        p.start()
+        c1.send_bytes(b"x" * 500_000)
+        assert c1.recv_bytes() == b"x" * 500_000
+        p.join()
+        assert p.exitcode == 0
+
+
+def _thread_count() -> int:
+    with open("/proc/self/status") as f:
+        for line in f:
+            if line.startswith("Threads:"):
+                return int(line.split()[1])
+    raise RuntimeError("thread count not found")
+
+
+def test_reactor_threads():
+    default = win32_pipes.get_reactor_threads()
+    assert default >= 1
+    with pytest.raises(ValueError):
+        win32_pipes.set_reactor_threads(0)
+
+    win32_pipes.set_reactor_threads(2)
+    try:
+        assert win32_pipes.get_reactor_threads() == 2
+        pipes = [win32_pipes.Pipe() for _ in range(100)]
+        if sys.platform == "linux":
+            threads = _thread_count()
+        for c1, c2 in pipes:
+            c1.send_bytes(b"ping", blocking=False)
+        for c1, c2 in pipes:
+            assert c2.recv_bytes() == b"ping"
+            c2.send_bytes(b"pong", blocking=False)
+        for c1, c2 in pipes:
+            assert c1.recv_bytes() == b"pong"
+
+        # the connections share the threads of the reactor
+        if sys.platform == "linux":
+            assert _thread_count() - threads <= 2
+        for c1, c2 in pipes:
+            c1.close()
+            c2.close()
+    finally:
+        win32_pipes.set_reactor_threads(default)
+
+
+def test_asyncio():
+    async def main():
+        c1, c2 = win32_pipes.Pipe()
+        with c1, c2:
+            # receivers wait before anything was sent
+            receivers = [asyncio.ensure_future(c2.recv_bytes_async()) for _ in range(3)]
+            await asyncio.sleep(0.01)
+            await c1.send_bytes_async(b"abc")
+            await c1.send_bytes_async(bytearray(b"0123456789"), offset=2, size=3)
+            await c1.send_bytes_async(b"x" * 1_000_000)
+            assert await asyncio.gather(*receivers) == [
+                b"abc",
+                b"234",
+                b"x" * 1_000_000,
+            ]
+
+            # more messages than fit into the queues, while the loop serves both ends
+            messages = [b"%d" % i for i in range(10_000)]
+
+            async def send():
+                for message in messages:
+                    await c2.send_bytes_async(message)
+
+            async def recv():
+                return [await c1.recv_bytes_async() for _ in messages]
+
+            _, received = await asyncio.gather(send(), recv())
+            assert received == messages
+
+            # a waiting receiver can be cancelled and does not take a message
+            task = asyncio.ensure_future(c2.recv_bytes_async())
+            await asyncio.sleep(0.01)
+            task.cancel()
+            with pytest.raises(asyncio.CancelledError):
+                await task
+            c1.send_bytes(b"after cancel")
+            assert await asyncio.wait_for(c2.recv_bytes_async(), 5) == b"after cancel"
+
+            # closing the peer fails the waiting receiver
+            task = asyncio.ensure_future(c2.recv_bytes_async())
+            await asyncio.sleep(0.01)
+            c1.close()
+            with pytest.raises(OSError):
+                await asyncio.wait_for(task, 5)
+
+    asyncio.run(main())
+
+
+def test_backpressure():
+    rx, tx = win32_pipes.Pipe(False)
+    with rx, tx:
+        assert tx.max_tx_inflight_bytes is None
+        with pytest.raises(ValueError):
+            tx.set_tx_limit(0)
+        with pytest.raises(ValueError):
+            tx.set_tx_limit(10, low_watermark=20)
+        rx.set_rx_limit(64 * 1024)
+        tx.set_tx_limit(1024 * 1024, low_watermark=256 * 1024)
+        assert rx.max_rx_queued_bytes == 64 * 1024
+        assert tx.max_tx_inflight_bytes == 1024 * 1024
+
+        # the receiver stops reading, the sender runs into its limit
+        rx.poll()
+        message = b"x" * 8192
+        sent = 0
+        with pytest.raises(BlockingIOError):
+            while True:
+                tx.send_bytes(message, blocking=False)
+                sent += 1
+        time.sleep(0.1)
+        # the I/O thread keeps writing into the socket buffer, but the
+        # sender stays blocked until the low watermark
+        assert tx.tx_inflight_bytes > 256 * 1024
+        assert tx.tx_queued > 0
+        assert 64 * 1024 <= rx.rx_queued_bytes < 64 * 1024 + len(message)
+        assert rx.rx_queued == rx.rx_queued_bytes // len(message)
+
+        # a blocking send waits, until the receiver drained both queues
+        with ThreadPoolExecutor(1) as executor:
+            future = executor.submit(tx.send_bytes, message)
+            for _ in range(sent + 1):
+                assert rx.recv_bytes() == message
+            future.result()
+        assert tx.tx_inflight_bytes == 0
+        assert rx.rx_queued_bytes == rx.rx_queued == 0
+
+        # removing the limit lets the I/O thread read again
+        for _ in range(20):
+            tx.send_bytes(message, blocking=False)
+        time.sleep(0.05)
+        assert rx.rx_queued < 20
+        rx.set_rx_limit(None)
+        assert rx.max_rx_queued_bytes is None
+        received = 0
+        while received < 20:
+            received += len(rx.recv_bytes_many(timeout=5))
+        assert received == 20
+
+
+def test_close_while_resuming():
+    # receivers and set_rx_limit() resume the throttled I/O thread without
+    # the locks of close()
+    message = b"x" * 4096
+
+    for _ in range(50):
+        rx, tx = win32_pipes.Pipe(duplex=False)
+        rx.set_rx_limit(16 * 1024)
+
+        def send() -> None:
+            with pytest.raises((RuntimeError, OSError)):
+                while True:
+                    tx.send_bytes(message)
+
+        def receive() -> None:
+            with pytest.raises((EOFError, RuntimeError, OSError)):
+                while True:
+                    rx.recv_bytes()
+
+        def toggle_limit() -> None:
+            while not rx.closed:
+                rx.set_rx_limit(None)
+                rx.set_rx_limit(8 * 1024)
+
+        with ThreadPoolExecutor(3) as executor:
+            futures = [executor.submit(f) for f in (send, receive, toggle_limit)]
+            time.sleep(0.01)
+            rx.close()
+            for future in futures:
+                future.result()
+        tx.close()
+
+
+def test_priority_heartbeat():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        with pytest.raises(ValueError):
+            tx.send_bytes(b"x", priority=4)
+
+        # 64 MiB of bulk data are queued before the heartbeat
+        bulk = bytes(1024 * 1024)
+        for _ in range(64):
+            tx.send_bytes(bulk, blocking=False, priority=2)
+        tx.send_bytes(b"cancel", blocking=False, priority=1)
+        sent_at = time.perf_counter()
+        tx.send_bytes(b"heartbeat", blocking=False)
+        assert tx.tx_queued > 0
+
+        received: List[bytes] = []
+        while len(received) < 66:
+            message = rx.recv_bytes()
+            if message == b"heartbeat":
+                latency = time.perf_counter() - sent_at
+            received.append(message if len(message) < len(bulk) else b"bulk")
+        total = time.perf_counter() - sent_at
+
+        # only the window of bulk data was ahead of the heartbeat
+        assert received.index(b"heartbeat") < 8
+        assert received.index(b"cancel") < 10
+        assert received.count(b"bulk") == 64
+        assert latency < total / 2
+
+        # writes of the same priority stay in order
+        for i in range(100):
+            tx.send_bytes(b"%d" % i, blocking=False, priority=3)
+        tx.send_bytes(b"done", priority=3)
+        assert [rx.recv_bytes() for _ in range(101)] == [
+            b"%d" % i for i in range(100)
+        ] + [b"done"]
+
+        # nobody receives, so the I/O threads stall and the lanes fill
+        sent = 0
+        with pytest.raises(BlockingIOError, match="priority lanes are full"):
+            while True:
+                tx.send_bytes(b"x" * 1024, blocking=False, priority=1)
+                sent += 1
+        assert sent >= 4096
+        for _ in range(sent):
+            assert rx.recv_bytes() == b"x" * 1024
+
+
+def test_stats():
+    rx, tx = win32_pipes.Pipe(duplex=False)
+    with rx, tx:
+        for size in (10, 100_000) * 16:
+            tx.send_bytes(b"x" * size)
+            assert rx.recv_bytes() == b"x" * size
+        # queued writes are counted on completion
+        deadline = time.monotonic() + 5
+        while tx.stats()["tx_messages"] < 32:
+            assert time.monotonic() < deadline
+            time.sleep(0.001)
+
+        tx_stats = tx.stats()
+        assert tx_stats["tx_messages"] == 32
+        assert tx_stats["tx_bytes"] == 16 * 100_010
+        assert tx_stats["tx_queued"] == 0
+        assert len(tx_stats["tx_latency_us"]) == 32
+        assert sum(tx_stats["tx_latency_us"]) == 2  # every 16th is sampled
+
+        rx_stats = rx.stats()
+        assert rx_stats["rx_messages"] == 32
+        assert rx_stats["rx_bytes"] == 16 * 100_010
+        assert rx_stats["rx_more_data_reads"] == 16
+        assert rx_stats["rx_queued"] == 0
+        assert rx_stats["rx_queued_peak"] >= 1
+        assert sum(rx_stats["rx_residency_us"]) == 2
+
+        rx.reset_stats()
+        rx_stats = rx.stats()
+        assert rx_stats["rx_messages"] == rx_stats["rx_bytes"] == 0
+        assert rx_stats["rx_queued_peak"] == 0
+        assert sum(rx_stats["rx_residency_us"]) == 0
+
+
+def test_broadcaster():
+    pipes = [win32_pipes.Pipe(duplex=False) for _ in range(3)]
+    readers = [rx for rx, _ in pipes]
+    writers = [tx for _, tx in pipes]
+    broadcaster = win32_pipes.PipeBroadcaster(writers, max_queued=4)
+    assert broadcaster.subscribers == writers
+
+    def receive(rx: win32_pipes.PipeConnection) -> List[int]:
+        return [rx.recv_bytes()[0] for _ in range(32)]
+
+    # the last subscriber never reads
+    payload = bytearray(1024 * 1024)
+    with ThreadPoolExecutor(2) as executor:
+        received = [executor.submit(receive, rx) for rx in readers[:2]]
+        for i in range(32):
+            payload[0] = i  # the payload was copied
+            assert broadcaster.publish(payload) >= 2
+            while any(s["queued"] > 2 for s in broadcaster.stats()[:2]):
+                time.sleep(0.001)
+        assert [f.result() for f in received] == [list(range(32))] * 2
+
+    stats = broadcaster.stats()
+    assert [s["connection"] for s in stats] == writers
+    assert [s["sent"] for s in stats[:2]] == [32, 32]
+    assert stats[2]["state"] == "lagging"
+    assert stats[2]["dropped"] > 0
+    assert stats[2]["sent"] + stats[2]["dropped"] == 32
+    assert stats[2]["queued"] >= 4
+
+    # slow subscribers can be removed instead, failed ones are skipped
+    broadcaster = win32_pipes.PipeBroadcaster(writers, 4, on_slow="remove")
+    writers[0].close()
+    assert broadcaster.publish(b"x") == 1
+    assert [s["state"] for s in broadcaster.stats()] == [
+        "failed",
+        "active",
+        "removed",
+    ]
+    assert broadcaster.subscribers == [writers[1]]
+    assert readers[1].recv_bytes()[:1] == b"x"
+
+    with pytest.raises(ValueError):
+        win32_pipes.PipeBroadcaster(writers, on_slow="block")
+    with pytest.raises(TypeError):
+        broadcaster.add(b"not a connection")
+    for rx, tx in pipes:
+        rx.close()
+        tx.close()
+
+
+def test_rpc_channel():
+    c1, c2 = win32_pipes.Pipe()
+    client = win32_pipes.RpcChannel(c1)
+    server = win32_pipes.RpcChannel(c2)
+
+    def serve(count: int) -> None:
+        requests = [server.recv_request() for _ in range(count)]
+        for request_id, payload in reversed(requests):
+            server.reply(request_id, payload.upper())
+
+    # replies in reverse order reach their own requests
+    with ThreadPoolExecutor(4) as executor:
+        executor.submit(serve, 1003)
+        calls = [executor.submit(client.call, b"call %d" % i) for i in range(3)]
+        ids = [client.send_request(b"request %d" % i) for i in range(1000)]
+        assert [client.wait_reply(i, timeout=5) for i in ids] == [
+            b"REQUEST %d" % i for i in range(1000)
+        ]
+        assert sorted(f.result() for f in calls) == [b"CALL 0", b"CALL 1", b"CALL 2"]
+    assert client.pending == 0
+
+    async def main() -> None:
+        serving = asyncio.get_running_loop().run_in_executor(None, serve, 1000)
+        replies = await asyncio.gather(
+            *(client.call_async(b"async %d" % i) for i in range(1000))
+        )
+        assert replies == [b"ASYNC %d" % i for i in range(1000)]
+        await serving
+
+    asyncio.run(main())
+
+    # a late reply is dropped, plain messages are not replies
+    with pytest.raises(TimeoutError):
+        client.call(b"late", timeout=0.05)
+    assert client.pending == 0
+    request_id, payload = server.recv_request()
+    server.reply(request_id, payload)
+    c2.send_bytes(b"plain")
+    assert c1.recv_bytes() == b"plain"
+    assert server.recv_request(timeout=0) is None
+
+    # a timeout cancels the request and wakes up the other waiters
+    request_id = client.send_request(b"cancelled")
+    with ThreadPoolExecutor(1) as executor:
+        waiter = executor.submit(client.wait_reply, request_id)
+        time.sleep(0.05)
+        with pytest.raises(TimeoutError):
+            client.wait_reply(request_id, timeout=0.05)
+        with pytest.raises(ValueError, match="unknown request ID"):
+            waiter.result(timeout=5)
+    request_id, payload = server.recv_request()
+    server.reply(request_id, payload)
+
+    with pytest.raises(ValueError):
+        win32_pipes.RpcChannel(c1)  # one channel per connection
+
+    # closing fails the pending calls
+    request_id = client.send_request(b"never answered")
+    c2.close()
+    with pytest.raises(OSError):
+        client.wait_reply(request_id, timeout=5)
+    client.close()
+    with pytest.raises(RuntimeError):
+        client.call(b"closed")
+    c1.close()
+
+    # closing or dropping a channel releases its connection
+    c1, c2 = win32_pipes.Pipe()
+    with c1, c2:
+        win32_pipes.RpcChannel(c1).close()
+        channel = win32_pipes.RpcChannel(c1)
+        del channel
+        with win32_pipes.RpcChannel(c1):
+            pass
+        win32_pipes.RpcChannel(c2).reply(7, b"late")
+        assert c1.recv_bytes().endswith(b"late")
+
+    # calls and replies wait for the Tx limit instead of failing
+    c1, c2 = win32_pipes.Pipe()
+    with c1, c2:
+        c1.set_tx_limit(16 * 1024)
+        c2.set_tx_limit(16 * 1024)
+        c2.set_rx_limit(16 * 1024)
+        client = win32_pipes.RpcChannel(c1)
+        server = win32_pipes.RpcChannel(c2)
+        payload = b"x" * 65536
+        with ThreadPoolExecutor(16) as executor:
+            calls = [executor.submit(client.call, payload, 5) for _ in range(16)]
+            time.sleep(0.1)
+            assert c1.tx_inflight_bytes >= 16 * 1024
+            for _ in range(16):
+                server.reply(*server.recv_request(timeout=5))
+            assert [f.result() for f in calls] == [payload] * 16
+
+
+@pytest.mark.parametrize("policy", ["round_robin", "least_outstanding", "least_bytes"])
+def test_pipe_dispatcher(policy: str):
+    pairs = [win32_pipes.Pipe() for _ in range(4)]
+    dispatcher = win32_pipes.PipeDispatcher([m for m, _ in pairs], policy=policy)
+    assert dispatcher.policy == policy
+    assert len(dispatcher.workers) == 4
+
+    def serve(index: int) -> None:
+        worker = pairs[index][1]
+        try:
+            while True:
+                task = worker.recv_bytes()
+                if index == 0:
+                    time.sleep(0.001)  # the slow worker
+                worker.send_bytes(task.upper())
+        except (EOFError, OSError, RuntimeError):
+            pass
+
+    count = 2000
+    with ThreadPoolExecutor(4) as executor:
+        for i in range(4):
+            executor.submit(serve, i)
+        ids = [dispatcher.submit(b"task %d" % i) for i in range(count // 2)]
+        ids += dispatcher.submit_many(b"task %d" % i for i in range(count // 2, count))
+        results = {}
+        while len(results) < count:
+            for task_id, result in dispatcher.recv_results(max_count=100, timeout=5):
+                results[task_id] = result
+        assert dispatcher.outstanding == 0
+        assert results == {task_id: b"TASK %d" % i for i, task_id in enumerate(ids)}
+
+        stats = dispatcher.stats()
+        assert [s["state"] for s in stats] == ["active"] * 4
+        assert sum(s["completed"] for s in stats) == count
+        if policy == "round_robin":
+            assert [s["submitted"] for s in stats] == [count // 4] * 4
+        else:
+            assert stats[0]["submitted"] < stats[1]["submitted"]
+        assert dispatcher.recv_results(timeout=0) == []
+
+        # the tasks of a failed worker complete without a result
+        pairs[1][1].close()
+        while dispatcher.stats()[1]["state"] != "failed":
+            time.sleep(0.01)
+        ids = dispatcher.submit_many([b"after"] * 100)
+        results = []
+        while len(results) < 100:
+            results += dispatcher.recv_results(timeout=5)
+        assert sorted(results) == sorted((i, b"AFTER") for i in ids)
+        assert dispatcher.stats()[1]["submitted"] == stats[1]["submitted"]
+
+        with pytest.raises(ValueError):
+            win32_pipes.PipeDispatcher([pairs[0][0]])  # one router per connection
+
+        dispatcher.close()
+        with pytest.raises(RuntimeError):
+            dispatcher.submit(b"closed")
+        with pytest.raises(RuntimeError):
+            dispatcher.recv_results()
+
+        # the workers are released, their messages are received as usual
+        pairs[0][0].send_bytes(b"plain")
+        assert pairs[0][0].recv_bytes() == b"PLAIN"
+        win32_pipes.PipeDispatcher([pairs[0][0]]).close()
+        for manager, worker in pairs:
+            manager.close()
+            worker.close()
+
+    # a worker, which does not receive, becomes busy
+    manager, worker = win32_pipes.Pipe()
+    with manager, worker, win32_pipes.PipeDispatcher([manager]) as dispatcher:
+        manager.set_tx_limit(64 * 1024)
+        ids = dispatcher.submit_many([b"x" * 1024] * 1000)
+        assert 0 < len(ids) < 1000
+        with pytest.raises(BlockingIOError, match="all workers are busy"):
+            dispatcher.submit(b"x" * 1024)
+        assert dispatcher.outstanding == len(ids)
+
+    with pytest.raises(ValueError):
+        win32_pipes.PipeDispatcher([])
+    with pytest.raises(ValueError):
+        win32_pipes.PipeDispatcher([win32_pipes.Pipe()[0]], policy="random")
+
+
+def test_concurrent_send_recv():
+    if sysconfig.get_config_var("Py_GIL_DISABLED"):
+        # the extension does not enable the GIL of a free-threaded build
+        assert not sys._is_gil_enabled()
+
+    threads = 8
+    count = 500
+    c1, c2 = win32_pipes.Pipe()
+
+    def send(index: int) -> None:
+        for i in range(count):
+            message = b"%d %d" % (index, i)
+            if i % 4 == 0:
+                c1.send_bytes(message)
+            elif i % 4 == 1:
+                c1.send_bytes(message, blocking=False)
+            elif i % 4 == 2:
+                c1.send_bytes_many([message])
+            else:
+                c1.send_bytes(message, priority=1 + index % 3)
+
+    def receive() -> List[bytes]:
+        messages = []
+        while True:
+            message = c2.recv_bytes()
+            if message == b"stop":
+                return messages
+            messages.append(message)
+
+    # senders and receivers share the connection, no message is lost or
+    # received twice
+    with ThreadPoolExecutor(2 * threads) as executor:
+        receivers = [executor.submit(receive) for _ in range(threads)]
+        for future in [executor.submit(send, i) for i in range(threads)]:
+            future.result()
+        # the stop messages queue up behind all non-blocking writes
+        for _ in range(threads):
+            c1.send_bytes(b"stop")
+        received = [m for future in receivers for m in future.result()]
+    assert sorted(received) == sorted(
+        b"%d %d" % (index, i) for index in range(threads) for i in range(count)
+    )
+
+    def send_forever() -> None:
+        with pytest.raises((RuntimeError, OSError)):
+            while True:
+                c1.send_bytes(bytes(4096))
+
+    def receive_forever() -> None:
+        with pytest.raises((RuntimeError, OSError)):
+            while True:
+                c2.recv_bytes()
+
+    # closing releases the threads, which are sending or receiving
+    with ThreadPoolExecutor(2 * threads) as executor:
+        futures = [executor.submit(send_forever) for _ in range(threads)]
+        futures += [executor.submit(receive_forever) for _ in range(threads)]
+        time.sleep(0.05)
+        c2.close()
+        c1.close()
+        for future in futures:
+            future.result(timeout=10)
+
+
 def test_context_manager():
     rx, tx = win32_pipes.Pipe(False)
     with rx as rx, tx as tx:
@@ -142,21 +1109,26 @@ def test_broken_pipe_tx():
 
 def test_generate_pipe_address():
     address = win32_pipes.generate_pipe_address()
-    assert re.match(rf"\\\\.\\pipe\\win32_pipes-{os.getpid()}-\d+-", address)
+    if sys.platform == "win32":
+        assert re.match(rf"\\\\.\\pipe\\win32_pipes-{os.getpid()}-\d+-", address)
+    else:
+        assert re.match(rf".*/win32_pipes-{os.getpid()}-\d+-$", address)
 
 
 def test_pipe_listener():
     address = win32_pipes.generate_pipe_address()
 
-    def listen():
-        with win32_pipes.PipeListener(address) as listener:
-            server = listener.accept()
+    def listen(_listener: win32_pipes.PipeListener):
+        with _listener:
+            server = _listener.accept()
             server.send_bytes(b"Hello")
             server.close()
-            listener.close()
+            _listener.close()
 
+    # create the listener up front, so the client can not connect too early
+    listener = win32_pipes.PipeListener(address)
     with ThreadPoolExecutor(max_workers=1) as executor:
-        future = executor.submit(listen)
+        future = executor.submit(listen, listener)
 
         # connect to listener
         client = win32_pipes.PipeClient(address)
@@ -180,6 +1152,117 @@ def test_pipe_listener_close():
             future.result()
 
 
+def test_pipe_listener_close_concurrent():
+    address = win32_pipes.generate_pipe_address()
+    listener = win32_pipes.PipeListener(address)
+    with ThreadPoolExecutor(max_workers=4) as executor:
+        futures = [executor.submit(listener.accept) for _ in range(4)]
+        time.sleep(0.05)
+        listener.close()
+        for future in futures:
+            with pytest.raises(RuntimeError):
+                future.result(timeout=10)
+
+
+def test_pipe_listener_accept_many():
+    address = win32_pipes.generate_pipe_address()
+    with win32_pipes.PipeListener(address, backlog=8) as listener:
+        assert listener.accept_many(4, timeout=0) == []
+
+        # the clients connect without anybody waiting in accept()
+        clients = [win32_pipes.PipeClient(address) for _ in range(6)]
+        time.sleep(0.1)
+        servers = listener.accept_many(4)
+        assert len(servers) == 4
+        servers += listener.accept_many(4, timeout=1)
+        assert len(servers) == 6
+
+        for i, client in enumerate(clients):
+            client.send_bytes(b"%d" % i)
+        assert sorted(server.recv_bytes() for server in servers) == [
+            b"%d" % i for i in range(6)
+        ]
+
+        t0 = time.perf_counter()
+        assert listener.accept_many(1, timeout=0.1) == []
+        assert time.perf_counter() - t0 >= 0.09
+        with pytest.raises(ValueError, match="max_count"):
+            listener.accept_many(0)
+
+        for c in clients + servers:
+            c.close()
+
+
+def test_pipe_listener_accept_async():
+    async def main():
+        address = win32_pipes.generate_pipe_address()
+        with win32_pipes.PipeListener(address) as listener:
+            task = asyncio.ensure_future(listener.accept_async())
+            await asyncio.sleep(0.01)
+            assert not task.done()
+
+            with win32_pipes.PipeClient(address) as client:
+                server = await asyncio.wait_for(task, 5)
+                with server:
+                    await client.send_bytes_async(b"hello")
+                    assert await server.recv_bytes_async() == b"hello"
+
+            task = asyncio.ensure_future(listener.accept_async())
+            await asyncio.sleep(0.01)
+            listener.close()
+            with pytest.raises(RuntimeError, match="closed"):
+                await asyncio.wait_for(task, 5)
+
+    asyncio.run(main())
+
+
+def test_wait():
+    pipes = [win32_pipes.Pipe(False) for _ in range(100)]
+    readers = [rx for rx, tx in pipes]
+    assert win32_pipes.wait(readers, timeout=0) == []
+    assert not readers[0].poll()
+    t0 = time.perf_counter()
+    assert not readers[0].poll(0.05)
+    assert time.perf_counter() - t0 >= 0.04
+
+    pipes[3][1].send_bytes(b"3")
+    pipes[70][1].send_bytes(b"70")
+    ready = win32_pipes.wait(readers, timeout=5)
+    assert sorted(readers.index(c) for c in ready) == [3, 70]
+    assert readers[3].poll() and readers[3].poll(None)
+    assert readers[3].recv_bytes() == b"3"
+    assert readers[70].recv_bytes() == b"70"
+
+    # a message sent while waiting wakes up the waiter
+    with ThreadPoolExecutor(1) as executor:
+        executor.submit(lambda: (time.sleep(0.05), pipes[99][1].send_bytes(b"99")))
+        assert win32_pipes.wait(readers) == [readers[99]]
+    assert readers[99].recv_bytes() == b"99"
+
+    # a broken connection is ready, receiving raises
+    pipes[50][1].close()
+    assert win32_pipes.wait(readers, timeout=5) == [readers[50]]
+    with pytest.raises(OSError):
+        readers[50].recv_bytes()
+
+    address = win32_pipes.generate_pipe_address()
+    with win32_pipes.PipeListener(address) as listener:
+        assert win32_pipes.wait([listener, *readers[:10]], timeout=0) == []
+        client = win32_pipes.PipeClient(address)
+        assert win32_pipes.wait([listener, *readers[:10]], timeout=5) == [listener]
+        server = listener.accept()
+        server.close()
+        client.close()
+    with pytest.raises(RuntimeError, match="handle is closed"):
+        win32_pipes.wait([listener])
+
+    with pytest.raises(TypeError):
+        win32_pipes.wait([object()])
+    for rx, tx in pipes:
+        rx.close()
+        tx.close()
+
+
 def _send_from_subprocess(c: win32_pipes.PipeConnection, messages: List[bytes]):
     for msg in messages:
         c.send_bytes(msg)